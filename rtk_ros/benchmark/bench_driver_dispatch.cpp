@@ -0,0 +1,165 @@
+/****************************************************************************
+ *
+ *   Per-byte cost of the driver read path.
+ *
+ *   A stand-in for the driver's receive loop (compiled out of line, like the
+ *   GpsDrivers translation units) pulls bytes through the callback ABI:
+ *     untyped    void *user + switch + virtual Transport (the compatibility shim)
+ *     adapter    DriverAdapter<MemoryTransport, Sink>, transport devirtualized
+ *     direct     the sink fed from memory with no callback at all (floor)
+ *   each with an empty sink and with the node's UBX framing as the sink.
+ *
+ ****************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <rtk_ros/transport.hpp>
+#include <rtk_ros/driver_adapter.hpp>
+#include <rtk_ros/ubx_parser.hpp>
+
+namespace {
+
+/** Endless replay of a buffer, returning at most chunk bytes per read like a tty would */
+class MemoryTransport final : public rtk_ros::Transport
+{
+public:
+    MemoryTransport(const std::vector<uint8_t> &_data, size_t _chunk) : data(_data), chunk(_chunk) {}
+
+    bool open() override { return true; }
+    void close() override {}
+    bool isOpen() const override { return true; }
+    size_t available() override { return chunk; }
+    bool waitReadable(int) override { return true; }
+
+    int read(uint8_t *out, size_t len) override {
+        size_t n = len < chunk ? len : chunk;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = data[pos++];
+            if (pos == data.size()) pos = 0;
+        }
+        return (int)n;
+    }
+
+    int write(const uint8_t *, size_t len) override { return (int)len; }
+    bool setBaudrate(unsigned) override { return true; }
+    std::string name() const override { return "memory"; }
+
+private:
+    const std::vector<uint8_t> &data;
+    size_t chunk;
+    size_t pos = 0;
+};
+
+struct NullSink {
+    uint64_t result = 0;
+    void onDeviceData(const uint8_t *data, int len) { result += len + data[len - 1]; }
+    void gotRTCMData(uint8_t *, size_t) {}
+    void onSurveyInStatus(const SurveyInStatus &) {}
+    void onSetClock(const timespec &) {}
+};
+
+struct ParsingSink {
+    rtk_ros::UbxParser parser;
+    uint64_t result = 0;
+    void onDeviceData(const uint8_t *data, int len) { parser.parse(data, len, *this); }
+    void onUbxMessage(uint8_t, uint8_t, const uint8_t *payload, uint16_t) { result += payload[0] + 1; }
+    void gotRTCMData(uint8_t *, size_t) {}
+    void onSurveyInStatus(const SurveyInStatus &) {}
+    void onSetClock(const timespec &) {}
+};
+
+/** The compatibility shim: untyped user pointer and a virtual transport */
+template <typename Sink>
+struct UntypedCallback {
+    rtk_ros::Transport *transport;
+    Sink *sink;
+    static int callbackEntry(GPSCallbackType type, void *data1, int data2, void *user) {
+        UntypedCallback *self = (UntypedCallback *)user;
+        return rtk_ros::dispatchDriverCallback(*self->transport, *self->sink, type, data1, data2);
+    }
+};
+
+/** Stand-in for GPSHelper::read() called from the driver's receive loop */
+__attribute__((noinline)) uint64_t driverLoop(GPSCallbackPtr callback, void *user, uint64_t total)
+{
+    uint8_t buf[GPS_READ_BUFFER_SIZE];
+    uint64_t done = 0;
+    while (done < total) {
+        *((int *)buf) = 100;
+        int ret = callback(GPSCallbackType::readDeviceData, buf, sizeof(buf), user);
+        if (ret <= 0) break;
+        done += ret;
+    }
+    return done;
+}
+
+std::vector<uint8_t> makeStream()
+{
+    std::vector<uint8_t> stream;
+    uint8_t payload[92] = {0};
+    uint8_t frame[92 + rtk_ros::ubx::FRAME_OVERHEAD];
+    for (int i = 0; i < 1000; i++) {
+        payload[0] = i & 0xFF;
+        size_t n = rtk_ros::ubx::buildFrame(rtk_ros::ubx::CLASS_NAV, rtk_ros::ubx::ID_NAV_PVT, payload, sizeof(payload), frame);
+        stream.insert(stream.end(), frame, frame + n);
+    }
+    return stream;
+}
+
+template <typename Function>
+double nsPerByte(uint64_t total, Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t bytes = function();
+    auto end = std::chrono::steady_clock::now();
+    if (bytes < total) fprintf(stderr, "short run: %llu bytes\n", (unsigned long long)bytes);
+    return std::chrono::duration<double, std::nano>(end - start).count() / total;
+}
+
+template <typename Sink>
+void run(const char *label, const std::vector<uint8_t> &stream, size_t chunk, uint64_t total)
+{
+    Sink untypedSink, adapterSink, directSink;
+
+    MemoryTransport untypedTransport(stream, chunk);
+    UntypedCallback<Sink> untyped = {&untypedTransport, &untypedSink};
+    double untypedNs = nsPerByte(total, [&]() {
+        return driverLoop(&UntypedCallback<Sink>::callbackEntry, &untyped, total);
+    });
+
+    MemoryTransport adapterTransport(stream, chunk);
+    rtk_ros::DriverAdapter<MemoryTransport, Sink> adapter(adapterTransport, adapterSink);
+    double adapterNs = nsPerByte(total, [&]() {
+        return driverLoop(adapter.entry(), adapter.user(), total);
+    });
+
+    MemoryTransport directTransport(stream, chunk);
+    rtk_ros::DriverAdapter<MemoryTransport, Sink> direct(directTransport, directSink);
+    double directNs = nsPerByte(total, [&]() {
+        uint8_t buf[GPS_READ_BUFFER_SIZE];
+        uint64_t done = 0;
+        while (done < total) done += direct.pump(buf, sizeof(buf), 100);
+        return done;
+    });
+
+    // Also keeps the sinks from being optimized away
+    if (untypedSink.result == 0 || adapterSink.result == 0 || directSink.result == 0) fprintf(stderr, "empty sink\n");
+    printf("%-8s %6zu %12.3f %12.3f %12.3f\n", label, chunk, untypedNs, adapterNs, directNs);
+}
+
+} // namespace
+
+int main()
+{
+    const std::vector<uint8_t> stream = makeStream();
+    const uint64_t total = 200ull * 1000 * 1000;
+
+    printf("ns/byte over %llu bytes\n", (unsigned long long)total);
+    printf("%-8s %6s %12s %12s %12s\n", "sink", "read", "untyped", "adapter", "direct");
+    const size_t chunks[] = {1, 8, 64, 1024};
+    for (size_t chunk : chunks) run<NullSink>("null", stream, chunk, chunk < 8 ? total / 10 : total);
+    for (size_t chunk : chunks) run<ParsingSink>("ubx", stream, chunk, chunk < 8 ? total / 10 : total);
+    return 0;
+}
@@ -0,0 +1,345 @@
+/****************************************************************************
+ *
+ *   Sustained navigation rate of the node's receive path.
+ *
+ *   An emulator thread writes one epoch of receiver output per navigation
+ *   period into a socket pair: NAV-PVT, NAV-SAT, MON-HW/MON-RF and NAV-SVIN
+ *   once per second, and an RTCM MSM7 set (1005 and 1230 once per second)
+ *   per epoch. Alternatively a recorded capture is replayed, one NAV-PVT to
+ *   the next per period. The reader does what run() does with every read:
+ *   demultiplexing, UBX dispatch, satellite table, statistics, DOP and
+ *   interference updates, and a copy of every RTCM frame for publishing.
+ *
+ *   Reported: epochs that took longer than a period to be consumed, epoch
+ *   latency (written to fully processed), and the reader's CPU time as a
+ *   share of one core.
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rtk_ros/transport.hpp>
+#include <rtk_ros/stream_demux.hpp>
+#include <rtk_ros/ubx_dispatch.hpp>
+#include <rtk_ros/satellite_table.hpp>
+#include <rtk_ros/signal_statistics.hpp>
+#include <rtk_ros/sky_geometry.hpp>
+#include <rtk_ros/interference_monitor.hpp>
+#include <rtk_ros/survey_status.hpp>
+#include <rtk_ros/base_estimator.hpp>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Reading end of the socket pair */
+class FdTransport final : public rtk_ros::SocketTransport
+{
+public:
+    explicit FdTransport(int _fd) { fd = _fd; }
+    bool open() override { return fd >= 0; }
+    std::string name() const override { return "socketpair"; }
+};
+
+/** The per-read work of RTKNode::run() without the ROS publishing */
+struct Pipeline {
+    typedef rtk_ros::ubx::UbxDispatcher<Pipeline,
+            rtk_ros::ubx::NavPvt,
+            rtk_ros::ubx::NavSat,
+            rtk_ros::ubx::NavSvin,
+            rtk_ros::ubx::MonHw,
+            rtk_ros::ubx::MonRf> Dispatch;
+
+    rtk_ros::StreamDemux demux;
+    rtk_ros::SatelliteTable satTable;
+    rtk_ros::SignalStatistics signalStatistics;
+    rtk_ros::SignalStatistics::Result results[rtk_ros::SignalStatistics::SLOTS];
+    rtk_ros::SkyGeometry skyGeometry;
+    rtk_ros::InterferenceMonitor interferenceMonitor;
+    rtk_ros::SurveyIn surveyIn;
+    rtk_ros::EcefSample position;
+    std::vector<uint8_t> rtcmMessage;
+    uint64_t epochs = 0;
+    uint64_t rtcmBytes = 0;
+    float dopSum = 0.f;
+
+    void onUbxMessage(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len) {
+        Dispatch::dispatch(*this, msgClass, msgId, payload, len);
+    }
+
+    void onUbx(const rtk_ros::ubx::NavPvt &, const uint8_t *payload, uint16_t len) {
+        position.decodeNavPvt(payload, len);
+        dopSum += skyGeometry.combined().pdop;
+    }
+
+    void onUbx(const rtk_ros::ubx::NavSat &, const uint8_t *payload, uint16_t len) {
+        if (!satTable.decodeNavSat(payload, len)) return;
+        signalStatistics.update(satTable);
+        skyGeometry.update(satTable);
+        interferenceMonitor.update(satTable);
+        if (++epochs % 50 == 0) signalStatistics.compute(results);
+    }
+
+    void onUbx(const rtk_ros::ubx::NavSvin &, const uint8_t *payload, uint16_t len) { surveyIn.decodeNavSvin(payload, len); }
+    void onUbx(const rtk_ros::ubx::MonHw &, const uint8_t *payload, uint16_t len) { interferenceMonitor.decodeMonHw(payload, len); }
+    void onUbx(const rtk_ros::ubx::MonRf &, const uint8_t *payload, uint16_t len) { interferenceMonitor.decodeMonRf(payload, len); }
+
+    void onRtcmFrame(const uint8_t *frame, size_t len) {
+        // mavros_msgs::RTCM keeps the frame in a std::vector
+        rtcmMessage.assign(frame, frame + len);
+        rtcmBytes += len;
+    }
+
+    void onNmeaSentence(const char *, size_t) {}
+};
+
+void appendUbx(std::vector<uint8_t> &out, uint8_t msgClass, uint8_t msgId, const std::vector<uint8_t> &payload)
+{
+    const size_t offset = out.size();
+    out.resize(offset + payload.size() + rtk_ros::ubx::FRAME_OVERHEAD);
+    rtk_ros::ubx::buildFrame(msgClass, msgId, payload.data(), (uint16_t)payload.size(), out.data() + offset);
+}
+
+void appendRtcm(std::vector<uint8_t> &out, uint16_t number, size_t length, std::mt19937 &rng)
+{
+    const size_t offset = out.size();
+    out.resize(offset + length + rtk_ros::rtcm3::FRAME_OVERHEAD);
+    uint8_t *frame = out.data() + offset;
+    frame[0] = rtk_ros::rtcm3::PREAMBLE;
+    frame[1] = (uint8_t)(length >> 8);
+    frame[2] = (uint8_t)length;
+    for (size_t i = 0; i < length; i++) frame[3 + i] = (uint8_t)rng();
+    frame[3] = (uint8_t)(number >> 4);
+    frame[4] = (uint8_t)((number << 4) | (frame[4] & 0x0F));
+    const uint32_t crc = rtk_ros::rtcm3::crc24q(frame, length + 3);
+    frame[3 + length] = (uint8_t)(crc >> 16);
+    frame[4 + length] = (uint8_t)(crc >> 8);
+    frame[5 + length] = (uint8_t)crc;
+}
+
+/** Synthetic epochs at rate Hz with numSvs satellites over four constellations */
+std::vector<std::vector<uint8_t>> synthesize(double rate, size_t count, int numSvs)
+{
+    std::mt19937 rng(1);
+    const int perSecond = std::max(1, (int)(rate + 0.5));
+    std::vector<std::vector<uint8_t>> epochs(count);
+    for (size_t e = 0; e < count; e++) {
+        std::vector<uint8_t> &out = epochs[e];
+        const uint32_t itow = (uint32_t)(e * 1000 / rate);
+
+        std::vector<uint8_t> pvt(92, 0);
+        rtk_ros::ubx::writeU4(pvt.data(), itow);
+        pvt[20] = 3;
+        pvt[21] = 0x01;
+        rtk_ros::ubx::writeU4(pvt.data() + 24, (uint32_t)(int32_t)(6.56 * 1e7));
+        rtk_ros::ubx::writeU4(pvt.data() + 28, (uint32_t)(int32_t)(46.52 * 1e7));
+        rtk_ros::ubx::writeU4(pvt.data() + 32, 400000);
+        rtk_ros::ubx::writeU4(pvt.data() + 40, 1500);
+        rtk_ros::ubx::writeU4(pvt.data() + 44, 2500);
+        appendUbx(out, rtk_ros::ubx::CLASS_NAV, rtk_ros::ubx::ID_NAV_PVT, pvt);
+
+        std::vector<uint8_t> sat(8 + 12 * numSvs, 0);
+        rtk_ros::ubx::writeU4(sat.data(), itow);
+        sat[4] = 1;
+        sat[5] = (uint8_t)numSvs;
+        static const uint8_t gnss[4] = {rtk_ros::GNSS_GPS, rtk_ros::GNSS_GALILEO, rtk_ros::GNSS_BEIDOU, rtk_ros::GNSS_GLONASS};
+        for (int i = 0; i < numSvs; i++) {
+            uint8_t *sv = sat.data() + 8 + 12 * i;
+            sv[0] = gnss[i % 4];
+            sv[1] = (uint8_t)(1 + i / 4);
+            sv[2] = (uint8_t)(30 + (i * 7 + e) % 20);
+            sv[3] = (uint8_t)(int8_t)(10 + (i * 13) % 75);
+            rtk_ros::ubx::writeU2(sv + 4, (uint16_t)((i * 37) % 360));
+            rtk_ros::ubx::writeU4(sv + 8, 0x07 | 0x08);
+        }
+        appendUbx(out, rtk_ros::ubx::CLASS_NAV, rtk_ros::ubx::ID_NAV_SAT, sat);
+
+        if (e % perSecond == 0) {
+            appendUbx(out, rtk_ros::ubx::CLASS_MON, rtk_ros::ubx::ID_MON_HW, std::vector<uint8_t>(60, 0));
+            std::vector<uint8_t> rf(4 + 24, 0);
+            rf[1] = 1;
+            appendUbx(out, rtk_ros::ubx::CLASS_MON, rtk_ros::ubx::ID_MON_RF, rf);
+            appendUbx(out, rtk_ros::ubx::CLASS_NAV, rtk_ros::ubx::ID_NAV_SVIN, std::vector<uint8_t>(40, 0));
+            appendRtcm(out, 1005, 19, rng);
+            appendRtcm(out, 1230, 5, rng);
+        }
+        // MSM7: about 26 bytes per satellite with two signals, plus the header
+        const uint16_t msm7[4] = {1077, 1097, 1127, 1087};
+        for (int c = 0; c < 4; c++) appendRtcm(out, msm7[c], 22 + 26 * (numSvs / 4), rng);
+    }
+    return epochs;
+}
+
+/** Split a capture at every NAV-PVT frame */
+struct EpochSplitter {
+    const uint8_t *base;
+    std::vector<size_t> starts;
+    void onUbxMessage(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t) {
+        if (msgClass == rtk_ros::ubx::CLASS_NAV && msgId == rtk_ros::ubx::ID_NAV_PVT) {
+            starts.push_back(payload - rtk_ros::ubx::HEADER_LENGTH - base);
+        }
+    }
+    void onRtcmFrame(const uint8_t *, size_t) {}
+    void onNmeaSentence(const char *, size_t) {}
+};
+
+bool loadCapture(const char *path, std::vector<std::vector<uint8_t>> &epochs)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + n);
+    fclose(file);
+
+    EpochSplitter splitter;
+    splitter.base = data.data();
+    rtk_ros::StreamDemux demux;
+    demux.parse(data.data(), data.size(), splitter);
+    splitter.starts.push_back(data.size());
+    for (size_t i = 0; i + 1 < splitter.starts.size(); i++) {
+        epochs.emplace_back(data.begin() + splitter.starts[i], data.begin() + splitter.starts[i + 1]);
+    }
+    return !epochs.empty();
+}
+
+double threadCpuSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [capture.ubx]\n"
+        "  -r HZ      navigation rate (default: 10)\n"
+        "  -s SECONDS duration (default: 10)\n"
+        "  -n SVS     satellites in the synthetic NAV-SAT (default: 40)\n"
+        "  -b BAUD    serial baudrate to compare the data rate with (default: 115200)\n",
+        name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    double rate = 10.0;
+    double seconds = 10.0;
+    int numSvs = 40;
+    double baud = 115200.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:n:b:h")) != -1) {
+        switch (opt) {
+            case 'r': rate = atof(optarg); break;
+            case 's': seconds = atof(optarg); break;
+            case 'n': numSvs = std::max(1, std::min(255, atoi(optarg))); break;
+            case 'b': baud = atof(optarg); break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (rate <= 0.0 || seconds <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const size_t count = (size_t)(rate * seconds);
+    std::vector<std::vector<uint8_t>> epochs;
+    if (optind < argc) {
+        std::vector<std::vector<uint8_t>> recorded;
+        if (!loadCapture(argv[optind], recorded)) {
+            fprintf(stderr, "No NAV-PVT epochs in %s\n", argv[optind]);
+            return 1;
+        }
+        for (size_t i = 0; i < count; i++) epochs.push_back(recorded[i % recorded.size()]);
+    } else {
+        epochs = synthesize(rate, count, numSvs);
+    }
+
+    std::vector<size_t> epochEnd(count);
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) epochEnd[i] = total += epochs[i].size();
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        return 1;
+    }
+
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    std::vector<Clock::time_point> sent(count);
+    std::vector<double> latency(count);
+
+    const Clock::time_point start = Clock::now() + std::chrono::milliseconds(100);
+    std::thread emulator([&]() {
+        for (size_t i = 0; i < count; i++) {
+            std::this_thread::sleep_until(start + i * period);
+            sent[i] = Clock::now();
+            size_t written = 0;
+            while (written < epochs[i].size()) {
+                ssize_t ret = write(fds[1], epochs[i].data() + written, epochs[i].size() - written);
+                if (ret <= 0) return;
+                written += ret;
+            }
+        }
+    });
+
+    Pipeline *pipeline = new Pipeline;
+    double cpu = 0.0;
+    std::thread reader([&]() {
+        FdTransport transport(fds[0]);
+        uint8_t buffer[1024];
+        size_t consumed = 0;
+        size_t epoch = 0;
+        const double cpuStart = threadCpuSeconds();
+        while (epoch < count) {
+            if (transport.available() == 0 && !transport.waitReadable(100)) continue;
+            const int n = transport.read(buffer, sizeof(buffer));
+            if (n < 0) break;
+            pipeline->demux.parse(buffer, n, *pipeline);
+            consumed += n;
+            const Clock::time_point now = Clock::now();
+            for (; epoch < count && epochEnd[epoch] <= consumed; epoch++) {
+                latency[epoch] = std::chrono::duration<double, std::milli>(now - sent[epoch]).count();
+            }
+        }
+        cpu = threadCpuSeconds() - cpuStart;
+    });
+
+    emulator.join();
+    reader.join();
+    const double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> sorted = latency;
+    std::sort(sorted.begin(), sorted.end());
+    const double periodMs = 1000.0 / rate;
+    const size_t late = std::count_if(latency.begin(), latency.end(), [&](double l) { return l > periodMs; });
+    const rtk_ros::StreamDemux::Counters &c = pipeline->demux.counters();
+
+    printf("%.1f Hz for %.1f s: %zu epochs, %.1f kB/s (%llu UBX frames, %llu RTCM frames, %llu errors)\n",
+           rate, wall, count, total / wall / 1000.0, (unsigned long long)c.ubx.frames, (unsigned long long)c.rtcm.frames,
+           (unsigned long long)(c.ubx.errors + c.rtcm.errors));
+    printf("epoch latency: median %.3f ms, p99 %.3f ms, max %.3f ms, %zu epochs over the %.1f ms period\n",
+           sorted[count / 2], sorted[std::min(count - 1, count * 99 / 100)], sorted.back(), late, periodMs);
+    // 8N1: 10 bits on the line per byte
+    const double lineLoad = total / wall * 10.0 / baud;
+    printf("serial line at %.0f baud: %.0f %% used%s\n", baud, 100.0 * lineLoad, lineLoad > 1.0 ? ", too slow for this rate" : "");
+    printf("reader CPU: %.3f s, %.2f %% of one core, %.1f us per epoch\n", cpu, 100.0 * cpu / wall, 1e6 * cpu / count);
+
+    close(fds[1]);
+    delete pipeline;
+    return late == 0 ? 0 : 2;
+}
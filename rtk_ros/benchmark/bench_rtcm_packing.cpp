@@ -0,0 +1,178 @@
+/****************************************************************************
+ *
+ *   GPS_RTCM_DATA payload efficiency, one message per RTCM frame against
+ *   the epoch packing of RtcmPacker.
+ *
+ *   Synthetic epochs hold 1005 and 1230 followed by an MSM4 or MSM7 message
+ *   per constellation (GPS, GLONASS, Galileo, BeiDou), two signals per
+ *   satellite. Alternatively the RTCM frames of a recorded stream are used,
+ *   split in epochs by their MSM multiple message bit.
+ *
+ *   Reported per policy: MAVLink packets per epoch, RTCM bytes per byte of
+ *   fragment capacity, and the wire bytes per second at 1 Hz.
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include <rtk_ros/mavlink_rtcm.hpp>
+#include <rtk_ros/rtcm_packer.hpp>
+#include <rtk_ros/stream_demux.hpp>
+
+namespace {
+
+/** Counts what MavlinkRtcmOutput would put on the link */
+struct PacketCounter {
+    uint64_t messages = 0;
+    uint64_t packets = 0;
+    uint64_t rtcmBytes = 0;
+    uint64_t wireBytes = 0;
+
+    void send(const uint8_t *data, size_t len) {
+        uint8_t packet[rtk_ros::mavlink::MAX_PACKET_LENGTH];
+        ++messages;
+        rtcmBytes += len;
+        do {
+            const size_t n = std::min(len, rtk_ros::mavlink::RTCM_FRAGMENT_LENGTH);
+            wireBytes += rtk_ros::mavlink::packGpsRtcmData((uint8_t)packets, 255, 190, 0, data, (uint8_t)n, packet);
+            ++packets;
+            data += n;
+            len -= n;
+        } while (len > 0);
+    }
+};
+
+std::vector<uint8_t> rtcmFrame(uint16_t number, size_t length, bool multiple, std::mt19937 &rng)
+{
+    std::vector<uint8_t> frame(length + rtk_ros::rtcm3::FRAME_OVERHEAD);
+    frame[0] = rtk_ros::rtcm3::PREAMBLE;
+    frame[1] = (uint8_t)(length >> 8);
+    frame[2] = (uint8_t)length;
+    for (size_t i = 0; i < length; i++) frame[3 + i] = (uint8_t)rng();
+    frame[3] = (uint8_t)(number >> 4);
+    frame[4] = (uint8_t)((frame[4] & 0x0F) | ((number & 0x0F) << 4));
+    if (length >= 7) frame[9] = (uint8_t)((frame[9] & ~0x02) | (multiple ? 0x02 : 0x00));
+    const uint32_t crc = rtk_ros::rtcm3::crc24q(frame.data(), length + 3);
+    frame[length + 3] = (uint8_t)(crc >> 16);
+    frame[length + 4] = (uint8_t)(crc >> 8);
+    frame[length + 5] = (uint8_t)crc;
+    return frame;
+}
+
+typedef std::vector<std::vector<uint8_t>> Epoch;
+
+std::vector<Epoch> synthesize(size_t count, int numSvs, int msm)
+{
+    const uint16_t base[4] = {1070, 1080, 1090, 1120};
+    // Header with satellite and signal masks, then per satellite and per cell (2 signals) fields
+    const size_t satBits = msm == 7 ? 36 : 18;
+    const size_t cellBits = msm == 7 ? 80 : 48;
+    std::mt19937 rng(42);
+    std::vector<Epoch> epochs;
+    for (size_t e = 0; e < count; e++) {
+        Epoch epoch;
+        epoch.push_back(rtcmFrame(1005, 19, false, rng));
+        epoch.push_back(rtcmFrame(1230, 8, false, rng));
+        for (int c = 0; c < 4; c++) {
+            const size_t sats = numSvs / 4;
+            const size_t bits = 169 + 2 * sats + sats * satBits + 2 * sats * cellBits;
+            epoch.push_back(rtcmFrame(base[c] + msm, (bits + 7) / 8, c < 3, rng));
+        }
+        epochs.push_back(epoch);
+    }
+    return epochs;
+}
+
+/** RTCM frames of a capture, an epoch ends at an MSM without the multiple message bit */
+struct EpochSplitter {
+    std::vector<Epoch> epochs{Epoch()};
+
+    void onUbxMessage(uint8_t, uint8_t, const uint8_t *, uint16_t) {}
+    void onNmeaSentence(const char *, size_t) {}
+    void onRtcmFrame(const uint8_t *frame, size_t len) {
+        epochs.back().emplace_back(frame, frame + len);
+        if (rtk_ros::rtcm3::isMsm(rtk_ros::rtcm3::messageNumber(frame)) && !rtk_ros::rtcm3::msmMultipleMessage(frame)) {
+            epochs.emplace_back();
+        }
+    }
+};
+
+bool loadCapture(const char *path, std::vector<Epoch> &epochs)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    rtk_ros::StreamDemux demux;
+    EpochSplitter splitter;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) demux.parse(buffer, n, splitter);
+    fclose(f);
+    if (splitter.epochs.back().empty()) splitter.epochs.pop_back();
+    epochs.swap(splitter.epochs);
+    return !epochs.empty();
+}
+
+void report(const char *policy, const PacketCounter &c, size_t epochs)
+{
+    printf("%-10s %8.2f packets/epoch %6.1f %% fragment fill %8.0f B/s at 1 Hz\n", policy,
+           (double)c.packets / epochs, 100.0 * c.rtcmBytes / (c.packets * rtk_ros::mavlink::RTCM_FRAGMENT_LENGTH),
+           (double)c.wireBytes / epochs);
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-e epochs] [-n satellites] [-m 4|7] [capture.rtcm3]\n", name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t count = 1000;
+    int numSvs = 32;
+    int msm = 7;
+    int opt;
+    while ((opt = getopt(argc, argv, "e:n:m:h")) != -1) {
+        switch (opt) {
+            case 'e': count = (size_t)std::max(1, atoi(optarg)); break;
+            case 'n': numSvs = std::max(4, std::min(64, atoi(optarg))); break;
+            case 'm': msm = atoi(optarg) == 4 ? 4 : 7; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    std::vector<Epoch> epochs;
+    if (optind < argc) {
+        if (!loadCapture(argv[optind], epochs)) {
+            fprintf(stderr, "No RTCM frames in %s\n", argv[optind]);
+            return 1;
+        }
+    } else {
+        epochs = synthesize(count, numSvs, msm);
+    }
+
+    PacketCounter single, packed;
+    rtk_ros::RtcmPacker packer;
+    for (size_t e = 0; e < epochs.size(); e++) {
+        for (const std::vector<uint8_t> &frame : epochs[e]) {
+            if (frame.size() <= rtk_ros::mavlink::RTCM_MAX_MESSAGE_LENGTH) single.send(frame.data(), frame.size());
+            packer.add(frame.data(), frame.size(), (double)e, packed);
+        }
+        // Capture epochs without MSM end on the timeout in the node
+        packer.flush(packed);
+    }
+
+    size_t frames = 0;
+    for (const Epoch &epoch : epochs) frames += epoch.size();
+    printf("%zu epochs, %.1f frames and %.0f RTCM bytes per epoch\n", epochs.size(), (double)frames / epochs.size(),
+           (double)single.rtcmBytes / epochs.size());
+    report("per frame", single, epochs.size());
+    report("packed", packed, epochs.size());
+    return 0;
+}
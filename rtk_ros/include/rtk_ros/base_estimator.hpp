@@ -0,0 +1,256 @@
+/**
+ * @file base_estimator.hpp
+ * Host-side base position estimation from high-precision ECEF epochs.
+ *
+ * Samples are accumulated relative to the first accepted one (Welford mean and
+ * covariance), gross outliers are rejected once the spread is known, and the
+ * standard error accounts for the strong epoch-to-epoch correlation of a static
+ * receiver: it is the larger of an AR(1) effective-sample-size estimate and a
+ * batch-means estimate. The receiver's own survey-in treats every epoch as
+ * independent and therefore needs a much longer duration for the same accuracy
+ * guarantee, or gives an optimistic one.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+
+/** WGS84 geodetic (deg, deg, m above the ellipsoid) to ECEF [m] */
+inline void geodeticToEcef(double lat_deg, double lon_deg, double alt, double ecef[3])
+{
+    const double a = 6378137.0;
+    const double e2 = 6.69437999014e-3;
+    const double lat = lat_deg * M_PI / 180.0;
+    const double lon = lon_deg * M_PI / 180.0;
+    const double n = a / sqrt(1.0 - e2 * sin(lat) * sin(lat));
+    ecef[0] = (n + alt) * cos(lat) * cos(lon);
+    ecef[1] = (n + alt) * cos(lat) * sin(lon);
+    ecef[2] = (n * (1.0 - e2) + alt) * sin(lat);
+}
+
+struct EcefSample {
+    uint32_t itow = 0;
+    double ecef[3] = {0.0, 0.0, 0.0}; ///< [m]
+    float accuracy = 0.f;               ///< position accuracy estimate [m]
+    bool valid = false;
+
+    /** NAV-HPPOSECEF payload (28 bytes) */
+    bool decodeNavHpposecef(const uint8_t *payload, size_t len) {
+        if (len < 28) return false;
+        itow = ubx::readU4(payload + 4);
+        for (int i = 0; i < 3; i++) {
+            ecef[i] = ubx::readI4(payload + 8 + 4 * i) * 1e-2 + (int8_t)payload[20 + i] * 1e-4;
+        }
+        valid = (payload[23] & 0x01) == 0;
+        accuracy = ubx::readU4(payload + 24) * 1e-4f;
+        return true;
+    }
+
+    /** NAV-PVT payload (92 bytes), for receivers without NAV-HPPOSECEF */
+    bool decodeNavPvt(const uint8_t *payload, size_t len) {
+        if (len < 92) return false;
+        itow = ubx::readU4(payload);
+        const uint8_t fix_type = payload[20];
+        valid = (payload[21] & 0x01) && fix_type >= 3 && fix_type <= 4;
+        geodeticToEcef(ubx::readI4(payload + 28) * 1e-7, ubx::readI4(payload + 24) * 1e-7,
+                ubx::readI4(payload + 32) * 1e-3, ecef);
+        const float h_acc = ubx::readU4(payload + 40) * 1e-3f;
+        const float v_acc = ubx::readU4(payload + 44) * 1e-3f;
+        accuracy = sqrtf(h_acc * h_acc + v_acc * v_acc);
+        return true;
+    }
+};
+
+/** Receiver time of week to a time continuous across week rollovers, for BaseEstimator::add() */
+class TowClock
+{
+public:
+    static const uint32_t WEEK_MS = 604800000;
+
+    /** @param itow time of week [ms] @return [s] since the first week seen */
+    double seconds(uint32_t itow) {
+        if (started && itow + WEEK_MS / 2 < last) {
+            ++weeks;
+        } else if (started && itow > last + WEEK_MS / 2) {
+            // Late message of the week before the rollover
+            return (weeks - 1.0) * WEEK_MS * 1e-3 + itow * 1e-3;
+        }
+        started = true;
+        last = itow;
+        return weeks * (WEEK_MS * 1e-3) + itow * 1e-3;
+    }
+
+    void reset() {
+        started = false;
+        last = 0;
+        weeks = 0;
+    }
+
+private:
+    bool started = false;
+    uint32_t last = 0;
+    uint32_t weeks = 0;
+};
+
+class BaseEstimator
+{
+public:
+    struct Settings {
+        float target_accuracy = 1.0f;      ///< 3D standard error to reach [m]
+        float min_duration = 60.f;         ///< [s]
+        float max_sample_accuracy = 10.f;  ///< samples reporting a worse accuracy are ignored [m]
+        float outlier_sigma = 4.f;         ///< rejection threshold once warmed up
+        uint32_t warmup_samples = 30;
+        float batch_duration = 30.f;       ///< batch length of the batch-means estimator [s]
+        uint32_t min_batches = 5;
+    };
+
+    Settings settings;
+
+    BaseEstimator() { reset(); }
+
+    void reset() {
+        n = 0;
+        rejected = 0;
+        startTime = lastTime = 0.0;
+        for (int i = 0; i < 3; i++) {
+            reference[i] = mean[i] = previous[i] = lagSum[i] = 0.0;
+            batchSum[i] = batchMeanSum[i] = batchMeanSq[i] = 0.0;
+            for (int j = 0; j < 3; j++) m2[i][j] = 0.0;
+        }
+        batchCount = 0;
+        batchSamples = 0;
+        batchStart = 0.0;
+    }
+
+    /**
+     * Add an epoch.
+     * @param t time of the sample [s], only differences are used
+     * @return false if the sample was rejected
+     */
+    bool add(double t, const double ecef[3], float accuracy) {
+        if (accuracy <= 0.f || accuracy > settings.max_sample_accuracy) {
+            ++rejected;
+            return false;
+        }
+
+        double d[3];
+        if (n == 0) {
+            for (int i = 0; i < 3; i++) reference[i] = ecef[i];
+            startTime = batchStart = t;
+        }
+        for (int i = 0; i < 3; i++) d[i] = ecef[i] - reference[i];
+
+        if (n >= settings.warmup_samples) {
+            for (int i = 0; i < 3; i++) {
+                const double sigma = sqrt(m2[i][i] / (n - 1));
+                const double floor = accuracy;
+                if (fabs(d[i] - mean[i]) > settings.outlier_sigma * (sigma > floor ? sigma : floor)) {
+                    ++rejected;
+                    return false;
+                }
+            }
+        }
+
+        ++n;
+        double delta[3];
+        for (int i = 0; i < 3; i++) {
+            delta[i] = d[i] - mean[i];
+            mean[i] += delta[i] / n;
+        }
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) m2[i][j] += delta[i] * (d[j] - mean[j]);
+            if (n > 1) lagSum[i] += d[i] * previous[i];
+            previous[i] = d[i];
+        }
+        lastTime = t;
+
+        for (int i = 0; i < 3; i++) batchSum[i] += d[i];
+        ++batchSamples;
+        if (t - batchStart >= settings.batch_duration) {
+            for (int i = 0; i < 3; i++) {
+                const double bm = batchSum[i] / batchSamples;
+                batchMeanSum[i] += bm;
+                batchMeanSq[i] += bm * bm;
+                batchSum[i] = 0.0;
+            }
+            ++batchCount;
+            batchSamples = 0;
+            batchStart = t;
+        }
+        return true;
+    }
+
+    /** Current estimate [m] */
+    void position(double ecef[3]) const {
+        for (int i = 0; i < 3; i++) ecef[i] = reference[i] + mean[i];
+    }
+
+    /** Standard deviation of the samples, per axis [m] */
+    double sampleSigma(int axis) const {
+        return n > 1 ? sqrt(m2[axis][axis] / (n - 1)) : 0.0;
+    }
+
+    /** Lag-1 autocorrelation of an axis, clamped to [0, 0.999] */
+    double autocorrelation(int axis) const {
+        if (n < 3 || m2[axis][axis] <= 0.0) return 0.0;
+        // sum (x_t - m)(x_t-1 - m) ~ lagSum - (n-1) m^2 for large n
+        const double cov = lagSum[axis] / (n - 1) - mean[axis] * mean[axis];
+        double rho = cov / (m2[axis][axis] / (n - 1));
+        if (rho < 0.0) rho = 0.0;
+        if (rho > 0.999) rho = 0.999;
+        return rho;
+    }
+
+    /** 3D standard error of the mean accounting for time correlation [m] */
+    double standardError() const {
+        if (n < 2) return INFINITY;
+        double sum = 0.0;
+        for (int i = 0; i < 3; i++) {
+            const double rho = autocorrelation(i);
+            const double n_eff = n * (1.0 - rho) / (1.0 + rho);
+            double var = m2[i][i] / (n - 1) / (n_eff > 1.0 ? n_eff : 1.0);
+            if (batchCount >= settings.min_batches) {
+                const double bm = batchMeanSum[i] / batchCount;
+                const double batch_var = (batchMeanSq[i] / batchCount - bm * bm) * batchCount / (batchCount - 1);
+                const double batch_se2 = batch_var / batchCount;
+                if (batch_se2 > var) var = batch_se2;
+            }
+            sum += var;
+        }
+        return sqrt(sum);
+    }
+
+    double duration() const { return n > 0 ? lastTime - startTime : 0.0; }
+    uint32_t samples() const { return n; }
+    uint32_t rejectedSamples() const { return rejected; }
+
+    bool converged() const {
+        return n >= settings.warmup_samples && duration() >= settings.min_duration
+            && standardError() <= settings.target_accuracy;
+    }
+
+private:
+    uint32_t n;
+    uint32_t rejected;
+    double startTime, lastTime;
+    double reference[3];
+    double mean[3];
+    double m2[3][3];
+    double previous[3];
+    double lagSum[3];
+    double batchSum[3];
+    double batchMeanSum[3];
+    double batchMeanSq[3];
+    uint32_t batchCount;
+    uint32_t batchSamples;
+    double batchStart;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,294 @@
+/**
+ * @file base_failover.hpp
+ * RTCM source selection between a primary and a standby base.
+ *
+ * Frames of the active base are forwarded as they come. Those of the other
+ * base are held per epoch (up to its last MSM), so a switch always starts with
+ * a complete epoch: when the active base turns unhealthy, the last complete
+ * epoch of the other one is sent at once if it is newer than the last epoch
+ * forwarded, and the rover misses at most the epoch that was in flight.
+ *
+ * A base is healthy while it completes epochs within the timeout, its CRC
+ * error rate stays under the limit and its survey-in, if one is running, is
+ * valid. The node returns to the primary once it has been healthy for the
+ * revert delay, at an epoch boundary of the standby.
+ *
+ * Optionally every frame carrying a station id (1001-1012, 1005/1006, 1033,
+ * 1230, MSM) is rewritten to a fixed id, so rovers see one station across
+ * switches and keep their ambiguities, with the ARP of the base forwarded.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "rtcm3_protocol.hpp"
+
+namespace rtk_ros {
+
+enum BaseSource : uint8_t {
+    BASE_PRIMARY = 0,
+    BASE_STANDBY,
+    BASE_SOURCES
+};
+
+inline const char *baseSourceName(uint8_t source)
+{
+    return source == BASE_PRIMARY ? "primary" : "standby";
+}
+
+namespace rtcm3 {
+
+/** Messages with the reference station id (DF003) right after the message number */
+inline bool hasStationId(uint16_t number)
+{
+    return (number >= 1001 && number <= 1004)      // GPS observations
+        || number == 1005 || number == 1006         // ARP, the position rovers match to the observations by id
+        || number == 1007 || number == 1008         // antenna descriptor
+        || (number >= 1009 && number <= 1012)       // GLONASS observations
+        || number == 1033 || number == 1230 || isMsm(number);
+}
+
+/** Rewrite the station id of a complete frame and its CRC */
+inline void setStationId(uint8_t *frame, uint16_t id)
+{
+    frame[HEADER_LENGTH + 1] = (uint8_t)((frame[HEADER_LENGTH + 1] & 0xF0) | ((id >> 8) & 0x0F));
+    frame[HEADER_LENGTH + 2] = (uint8_t)id;
+    const size_t len = HEADER_LENGTH + payloadLength(frame);
+    const uint32_t crc = crc24q(frame, len);
+    frame[len] = (uint8_t)(crc >> 16);
+    frame[len + 1] = (uint8_t)(crc >> 8);
+    frame[len + 2] = (uint8_t)crc;
+}
+
+} // namespace rtcm3
+
+class BaseFailover
+{
+public:
+    struct Config {
+        double timeout = 1.5;           ///< longest wait for an epoch of the active base [s]
+        double max_crc_rate = 1.0;      ///< CRC errors/s above which a base is unhealthy
+        double revert_delay = 30.0;     ///< healthy time before returning to the primary [s], 0 never
+        int station_id = -1;            ///< rewritten station id, negative to forward ids unchanged
+    };
+
+    struct Health {
+        double last_epoch = -1.0;       ///< arrival of the last complete epoch [s], negative if none
+        double epoch_rate = 0.0;        ///< [1/s], smoothed
+        double crc_rate = 0.0;          ///< [1/s], smoothed
+        bool survey_active = false;
+        bool survey_valid = false;
+        bool healthy = false;
+        double healthy_since = -1.0;
+    };
+
+    struct Counters {
+        uint64_t frames[BASE_SOURCES] = {0, 0};
+        uint64_t epochs[BASE_SOURCES] = {0, 0};
+        uint64_t forwarded = 0;
+        uint64_t switches = 0;
+        uint64_t held_overflow = 0;     ///< epochs of the inactive base too large to hold
+    };
+
+    static const size_t MAX_FRAMES = 32;
+    static const size_t CAPACITY = 8 * (rtcm3::MAX_PAYLOAD_LENGTH + rtcm3::FRAME_OVERHEAD);
+
+    void configure(const Config &_config) { config = _config; }
+
+    uint8_t active() const { return activeSource; }
+    const Health &health(uint8_t source) const { return streams[source].health; }
+    const Counters &counters() const { return count; }
+
+    /** Survey-in state reported by a base (NAV-SVIN), a fixed base reports neither active nor valid */
+    void setSurvey(uint8_t source, bool active, bool valid) {
+        streams[source].health.survey_active = active;
+        streams[source].health.survey_valid = valid;
+    }
+
+    /** Cumulative CRC error count of a base's RTCM stream */
+    void setCrcErrors(uint8_t source, uint64_t errors, double now) {
+        Stream &s = streams[source];
+        if (s.crcTime > 0.0 && now > s.crcTime) {
+            const double dt = now - s.crcTime;
+            const double rate = (double)(errors - s.crcErrors) / dt;
+            const double alpha = dt / (dt + RATE_TIME_CONSTANT);
+            s.health.crc_rate += alpha * (rate - s.health.crc_rate);
+        }
+        s.crcErrors = errors;
+        s.crcTime = now;
+    }
+
+    /** A complete, CRC-checked frame of source, forwarded to sink (send(data, len)) if its base is active */
+    template <typename Sink>
+    void onFrame(uint8_t source, const uint8_t *frame, size_t len, double now, Sink &sink) {
+        if (len < rtcm3::FRAME_OVERHEAD + 2 || len > rtcm3::MAX_PAYLOAD_LENGTH + rtcm3::FRAME_OVERHEAD) return;
+        Stream &s = streams[source];
+        ++count.frames[source];
+        const bool msm = rtcm3::isMsm(rtcm3::messageNumber(frame)) && rtcm3::payloadLength(frame) >= 7;
+        const bool end = msm && !rtcm3::msmMultipleMessage(frame);
+
+        if (source == activeSource && s.joining) {
+            // Switched to in the middle of an epoch, start at the next one
+            if (end) s.joining = false;
+        } else if (source == activeSource) {
+            forward(frame, len, sink);
+            s.midEpoch = !end;
+            if (end) lastForwardedEpoch = rtcm3::msmEpochTime(frame);
+        } else {
+            s.building.add(frame, len);
+        }
+
+        if (end) {
+            s.epochComplete(now);
+            ++count.epochs[source];
+            if (source != activeSource) {
+                if (s.building.overflow) ++count.held_overflow;
+                s.building.epoch = rtcm3::msmEpochTime(frame);
+                s.building.arrival = now;
+                s.ready.assign(s.building);
+                s.building.clear();
+            }
+            update(now, sink);
+        }
+    }
+
+    /** Re-evaluate health and switch if needed, called at least every timeout */
+    template <typename Sink>
+    void update(double now, Sink &sink) {
+        for (uint8_t i = 0; i < BASE_SOURCES; i++) evaluate(streams[i], now);
+        const uint8_t other = activeSource == BASE_PRIMARY ? BASE_STANDBY : BASE_PRIMARY;
+        const Stream &a = streams[activeSource];
+        const Stream &o = streams[other];
+        if (!o.health.healthy) return;
+
+        const bool failover = !a.health.healthy;
+        // A planned switch waits until both bases are between epochs, so no epoch is skipped
+        const bool revert = other == BASE_PRIMARY && config.revert_delay > 0.0 && !a.midEpoch
+            && o.building.frames == 0 && now - o.health.healthy_since >= config.revert_delay;
+        if (!failover && !revert) return;
+        // Start from a held epoch boundary of the other base, or wait for its next one
+        if (!o.ready.valid() || now - o.ready.arrival > config.timeout) return;
+        switchTo(other, sink);
+    }
+
+private:
+    static constexpr double RATE_TIME_CONSTANT = 10.0;
+
+    /** Frames of one epoch of an inactive base */
+    struct HeldEpoch {
+        uint8_t data[CAPACITY];
+        uint16_t offsets[MAX_FRAMES + 1] = {0};
+        size_t frames = 0;
+        bool overflow = false;
+        bool partial = false;   ///< started while its base was active
+        uint32_t epoch = 0;
+        double arrival = -1.0;
+
+        bool valid() const { return frames > 0 && !overflow && !partial; }
+
+        void clear() {
+            frames = 0;
+            overflow = false;
+            partial = false;
+            arrival = -1.0;
+        }
+
+        void add(const uint8_t *frame, size_t len) {
+            if (overflow || frames == MAX_FRAMES || offsets[frames] + len > CAPACITY) {
+                overflow = true;
+                return;
+            }
+            memcpy(data + offsets[frames], frame, len);
+            offsets[frames + 1] = (uint16_t)(offsets[frames] + len);
+            ++frames;
+        }
+
+        /** Copied rather than swapped, epochs end only once a second or so */
+        void assign(const HeldEpoch &other) {
+            memcpy(data, other.data, other.offsets[other.frames]);
+            memcpy(offsets, other.offsets, sizeof(offsets));
+            frames = other.frames;
+            overflow = other.overflow;
+            partial = other.partial;
+            epoch = other.epoch;
+            arrival = other.arrival;
+        }
+    };
+
+    struct Stream {
+        Health health;
+        HeldEpoch building;
+        HeldEpoch ready;
+        bool midEpoch = false;      ///< active and part of the current epoch forwarded
+        bool joining = false;       ///< active, waiting for the start of an epoch
+        uint64_t crcErrors = 0;
+        double crcTime = 0.0;
+
+        void epochComplete(double now) {
+            if (health.last_epoch >= 0.0 && now > health.last_epoch) {
+                const double dt = now - health.last_epoch;
+                const double alpha = dt / (dt + RATE_TIME_CONSTANT);
+                health.epoch_rate += alpha * (1.0 / dt - health.epoch_rate);
+            }
+            health.last_epoch = now;
+        }
+    };
+
+    void evaluate(Stream &s, double now) {
+        Health &h = s.health;
+        h.healthy = h.last_epoch >= 0.0 && now - h.last_epoch <= config.timeout
+            && h.crc_rate <= config.max_crc_rate
+            && !(h.survey_active && !h.survey_valid);
+        if (!h.healthy) h.healthy_since = -1.0;
+        else if (h.healthy_since < 0.0) h.healthy_since = now;
+    }
+
+    template <typename Sink>
+    void switchTo(uint8_t source, Sink &sink) {
+        Stream &previous = streams[activeSource];
+        // The rest of an epoch the previous base was sending is held, never to be sent
+        previous.building.clear();
+        previous.building.partial = previous.midEpoch;
+        previous.midEpoch = false;
+        previous.joining = false;
+        activeSource = source;
+        ++count.switches;
+        HeldEpoch &held = streams[source].ready;
+        // The epoch may already have gone out from the other base
+        if (held.epoch != lastForwardedEpoch) {
+            for (size_t i = 0; i < held.frames; i++) {
+                forward(held.data + held.offsets[i], held.offsets[i + 1] - held.offsets[i], sink);
+            }
+            lastForwardedEpoch = held.epoch;
+        }
+        held.clear();
+        Stream &next = streams[source];
+        next.joining = next.building.frames > 0;
+        next.building.clear();
+        next.midEpoch = false;
+    }
+
+    template <typename Sink>
+    void forward(const uint8_t *frame, size_t len, Sink &sink) {
+        ++count.forwarded;
+        if (config.station_id < 0 || !rtcm3::hasStationId(rtcm3::messageNumber(frame))) {
+            sink.send(frame, len);
+            return;
+        }
+        memcpy(scratch, frame, len);
+        rtcm3::setStationId(scratch, (uint16_t)config.station_id);
+        sink.send(scratch, len);
+    }
+
+    Config config;
+    Stream streams[BASE_SOURCES];
+    uint8_t activeSource = BASE_PRIMARY;
+    uint32_t lastForwardedEpoch = UINT32_MAX;
+    uint8_t scratch[rtcm3::MAX_PAYLOAD_LENGTH + rtcm3::FRAME_OVERHEAD];
+    Counters count;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,187 @@
+/**
+ * @file byte_scan.hpp
+ * Wide helpers for scanning receiver byte streams: finding preamble bytes
+ * and updating a Fletcher-8 checksum 16 bytes at a time.
+ *
+ * SSE2 is used on x86-64 and NEON on ARM, both are part of the baseline of
+ * these targets so no runtime dispatch is needed. Other targets, or builds
+ * with RTK_ROS_NO_SIMD defined, use the scalar versions.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if !defined(RTK_ROS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define RTK_ROS_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif !defined(RTK_ROS_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define RTK_ROS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace rtk_ros {
+
+namespace detail {
+
+inline unsigned countTrailingZeros(uint64_t x)
+{
+    return (unsigned)__builtin_ctzll(x);
+}
+
+#if RTK_ROS_SIMD_NEON
+/** 4 bits per byte lane of a 0x00/0xFF comparison result */
+inline uint64_t neonMask(uint8x16_t cmp)
+{
+    const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+#endif
+
+} // namespace detail
+
+/**
+ * Find the first position i with data[i] == first and data[i + 1] == second.
+ * @return the position, or len if there is none. A trailing data[len - 1] ==
+ *         first is not reported, the caller has to carry it to the next buffer.
+ */
+inline size_t findPair(const uint8_t *data, size_t len, uint8_t first, uint8_t second)
+{
+    size_t i = 0;
+#if RTK_ROS_SIMD_SSE2
+    const __m128i a = _mm_set1_epi8((char)first);
+    const __m128i b = _mm_set1_epi8((char)second);
+    for (; i + 17 <= len; i += 16) {
+        const __m128i lo = _mm_loadu_si128((const __m128i *)(data + i));
+        const __m128i hi = _mm_loadu_si128((const __m128i *)(data + i + 1));
+        const int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(lo, a), _mm_cmpeq_epi8(hi, b)));
+        if (mask) return i + detail::countTrailingZeros((uint64_t)mask);
+    }
+#elif RTK_ROS_SIMD_NEON
+    const uint8x16_t a = vdupq_n_u8(first);
+    const uint8x16_t b = vdupq_n_u8(second);
+    for (; i + 17 <= len; i += 16) {
+        const uint8x16_t lo = vld1q_u8(data + i);
+        const uint8x16_t hi = vld1q_u8(data + i + 1);
+        const uint64_t mask = detail::neonMask(vandq_u8(vceqq_u8(lo, a), vceqq_u8(hi, b)));
+        if (mask) return i + detail::countTrailingZeros(mask) / 4;
+    }
+#endif
+    for (; i + 1 < len; i++) {
+        const uint8_t *p = (const uint8_t *)memchr(data + i, first, len - 1 - i);
+        if (!p) return len;
+        i = p - data;
+        if (data[i + 1] == second) return i;
+    }
+    return len;
+}
+
+/**
+ * Find the first byte equal to one of a, b or c.
+ * @return the position, or len if there is none
+ */
+inline size_t findAnyOf(const uint8_t *data, size_t len, uint8_t a, uint8_t b, uint8_t c)
+{
+    size_t i = 0;
+#if RTK_ROS_SIMD_SSE2
+    const __m128i va = _mm_set1_epi8((char)a);
+    const __m128i vb = _mm_set1_epi8((char)b);
+    const __m128i vc = _mm_set1_epi8((char)c);
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        const __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+        const int mask = _mm_movemask_epi8(hit);
+        if (mask) return i + detail::countTrailingZeros((uint64_t)mask);
+    }
+#elif RTK_ROS_SIMD_NEON
+    const uint8x16_t va = vdupq_n_u8(a);
+    const uint8x16_t vb = vdupq_n_u8(b);
+    const uint8x16_t vc = vdupq_n_u8(c);
+    for (; i + 16 <= len; i += 16) {
+        const uint8x16_t v = vld1q_u8(data + i);
+        const uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)), vceqq_u8(v, vc));
+        const uint64_t mask = detail::neonMask(hit);
+        if (mask) return i + detail::countTrailingZeros(mask) / 4;
+    }
+#endif
+    for (; i < len; i++) {
+        if (data[i] == a || data[i] == b || data[i] == c) return i;
+    }
+    return len;
+}
+
+/**
+ * Continue a Fletcher-8 checksum (as used by UBX) over len bytes.
+ *
+ * For a block of n bytes, ck_b grows by n * ck_a plus the bytes weighted
+ * n .. 1, which makes the checksum separable into 16-byte blocks. All sums
+ * are kept modulo 2^32, only the low 8 bits are used in the end.
+ */
+inline void fletcher8Update(const uint8_t *data, size_t len, uint8_t &ck_a, uint8_t &ck_b)
+{
+    uint32_t a = ck_a;
+    uint32_t b = ck_b;
+    size_t i = 0;
+#if RTK_ROS_SIMD_SSE2
+    if (len >= 16) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i weights_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+        const __m128i weights_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+        __m128i sum = zero;         // byte sums
+        __m128i sum_before = zero;  // sum of the byte sums before each block
+        __m128i weighted = zero;
+        const size_t blocks = len / 16;
+        for (size_t k = 0; k < blocks; k++, i += 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            sum_before = _mm_add_epi32(sum_before, sum);
+            sum = _mm_add_epi32(sum, _mm_sad_epu8(v, zero));
+            weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights_lo));
+            weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights_hi));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, sum);
+        const uint32_t s = lanes[0] + lanes[2];
+        _mm_storeu_si128((__m128i *)lanes, sum_before);
+        const uint32_t sb = lanes[0] + lanes[2];
+        _mm_storeu_si128((__m128i *)lanes, weighted);
+        const uint32_t w = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        b += (uint32_t)(16 * blocks) * a + 16 * sb + w;
+        a += s;
+    }
+#elif RTK_ROS_SIMD_NEON
+    if (len >= 16) {
+        static const uint8_t weight_bytes[16] = {16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+        const uint8x8_t weights_lo = vld1_u8(weight_bytes);
+        const uint8x8_t weights_hi = vld1_u8(weight_bytes + 8);
+        uint32x4_t sum = vdupq_n_u32(0);
+        uint32x4_t sum_before = vdupq_n_u32(0);
+        uint32x4_t weighted = vdupq_n_u32(0);
+        const size_t blocks = len / 16;
+        for (size_t k = 0; k < blocks; k++, i += 16) {
+            const uint8x16_t v = vld1q_u8(data + i);
+            sum_before = vaddq_u32(sum_before, sum);
+            sum = vpadalq_u16(sum, vpaddlq_u8(v));
+            uint16x8_t products = vmull_u8(vget_low_u8(v), weights_lo);
+            products = vmlal_u8(products, vget_high_u8(v), weights_hi);
+            weighted = vpadalq_u16(weighted, products);
+        }
+        const uint32_t s = vgetq_lane_u32(sum, 0) + vgetq_lane_u32(sum, 1) + vgetq_lane_u32(sum, 2) + vgetq_lane_u32(sum, 3);
+        const uint32_t sb = vgetq_lane_u32(sum_before, 0) + vgetq_lane_u32(sum_before, 1)
+                          + vgetq_lane_u32(sum_before, 2) + vgetq_lane_u32(sum_before, 3);
+        const uint32_t w = vgetq_lane_u32(weighted, 0) + vgetq_lane_u32(weighted, 1)
+                         + vgetq_lane_u32(weighted, 2) + vgetq_lane_u32(weighted, 3);
+        b += (uint32_t)(16 * blocks) * a + 16 * sb + w;
+        a += s;
+    }
+#endif
+    for (; i < len; i++) {
+        a += data[i];
+        b += a;
+    }
+    ck_a = (uint8_t)a;
+    ck_b = (uint8_t)b;
+}
+
+} // namespace rtk_ros
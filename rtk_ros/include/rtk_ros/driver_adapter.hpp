@@ -0,0 +1,107 @@
+/**
+ * @file driver_adapter.hpp
+ * Compile-time binding of a GpsDrivers driver to a transport and a sink.
+ *
+ * The drivers only know the C callback ABI (GPSCallbackPtr + void *user).
+ * DriverAdapter<TransportT, SinkT> provides that entry point, but everything
+ * behind it is resolved at compile time: with a final transport class the
+ * read/write calls are devirtualized and inlined together with the sink's
+ * byte tap into the callback the driver's parse loop calls.
+ *
+ * A sink provides:
+ *   void onDeviceData(const uint8_t *data, int len);   bytes read from the receiver
+ *   void gotRTCMData(uint8_t *data, size_t len);
+ *   void onSurveyInStatus(const SurveyInStatus &status);
+ *   void onSetClock(const timespec &time);
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <rtk_ros/GpsDrivers/src/gps_helper.h>
+
+namespace rtk_ros {
+
+/** Type-erased owner, only used to delete an adapter */
+class DriverAdapterBase
+{
+public:
+    virtual ~DriverAdapterBase() = default;
+};
+
+/**
+ * Handle one driver callback. Shared by the adapters and by callers that
+ * still go through the untyped callback (TransportT = Transport).
+ */
+template <typename TransportT, typename SinkT>
+inline int dispatchDriverCallback(TransportT &transport, SinkT &sink, GPSCallbackType type, void *data1, int data2)
+{
+    switch (type) {
+        case GPSCallbackType::readDeviceData: {
+            // The driver passes its timeout [ms] in the first bytes of the buffer
+            if (transport.available() == 0) {
+                int timeout = *((int *) data1);
+                if (!transport.waitReadable(timeout))
+                    return 0; // no new data
+            }
+            int bytes_read = transport.read((uint8_t *) data1, data2);
+            if (bytes_read > 0) {
+                sink.onDeviceData((const uint8_t *) data1, bytes_read);
+            }
+            return bytes_read;
+        }
+        case GPSCallbackType::writeDeviceData: {
+            int bytes_written = transport.write((const uint8_t *) data1, data2);
+            return bytes_written == data2 ? data2 : -1;
+        }
+        case GPSCallbackType::setBaudrate:
+            return transport.setBaudrate(data2);
+        case GPSCallbackType::gotRTCMMessage:
+            sink.gotRTCMData((uint8_t *) data1, data2);
+            return 0;
+        case GPSCallbackType::surveyInStatus:
+            sink.onSurveyInStatus(*(const SurveyInStatus *) data1);
+            return 0;
+        case GPSCallbackType::setClock:
+            sink.onSetClock(*(const timespec *) data1);
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+template <typename TransportT, typename SinkT>
+class DriverAdapter final : public DriverAdapterBase
+{
+public:
+    DriverAdapter(TransportT &_transport, SinkT &_sink) : transport(_transport), sink(_sink) {}
+
+    /** Pass entry() and user() to the driver constructor */
+    static GPSCallbackPtr entry() { return &callbackEntry; }
+    void *user() { return this; }
+
+    static int callbackEntry(GPSCallbackType type, void *data1, int data2, void *user) {
+        DriverAdapter *self = static_cast<DriverAdapter *>(user);
+        return dispatchDriverCallback(self->transport, self->sink, type, data1, data2);
+    }
+
+    /**
+     * Read whatever is available and hand it to the sink without a driver in
+     * between, e.g. for sniffing or replay.
+     * @return bytes read, negative on error
+     */
+    int pump(uint8_t *buffer, int len, int timeout_ms) {
+        if (transport.available() == 0 && !transport.waitReadable(timeout_ms)) return 0;
+        int bytes_read = transport.read(buffer, len);
+        if (bytes_read > 0) sink.onDeviceData(buffer, bytes_read);
+        return bytes_read;
+    }
+
+private:
+    TransportT &transport;
+    SinkT &sink;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,161 @@
+/**
+ * @file driver_plugin.hpp
+ * GPSHelper drivers loaded on demand from plugins.
+ *
+ * Each driver is built as a module, librtk_ros_driver_<name>.so (ubx,
+ * ashtech, mtk), exporting a C factory defined with RTK_ROS_DRIVER_PLUGIN.
+ * DriverLoader opens the one module a process needs, so rtk_node neither links
+ * nor maps the other drivers. Modules are looked up in the driver_path
+ * directory if set, otherwise in the library path (LD_LIBRARY_PATH, which the
+ * catkin setup scripts point at the devel and install lib directories).
+ *
+ * Building with -DRTK_ROS_STATIC_DRIVERS links the drivers into the node
+ * instead, with the same DriverLoader interface. This is the default build
+ * (CMake option RTK_ROS_DRIVER_PLUGINS OFF).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include <rtk_ros/GpsDrivers/src/gps_helper.h>
+
+#ifdef RTK_ROS_STATIC_DRIVERS
+#include <rtk_ros/GpsDrivers/src/ubx.h>
+#include <rtk_ros/GpsDrivers/src/ashtech.h>
+#include <rtk_ros/GpsDrivers/src/mtk.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace rtk_ros {
+
+/** Bumped whenever DriverArgs or the exported functions change */
+static const uint32_t DRIVER_PLUGIN_ABI = 1;
+
+/** Constructor arguments shared by the drivers, each one uses what it needs */
+struct DriverArgs {
+    GPSCallbackPtr callback;
+    void *user;
+    vehicle_gps_position_s *gps_position;
+    satellite_info_s *satellite_info;
+    uint8_t dynamic_model;
+};
+
+} // namespace rtk_ros
+
+/** Define the exported functions of a driver module, driver is built from const DriverArgs *args */
+#define RTK_ROS_DRIVER_PLUGIN(driver)                                                                  \
+    extern "C" __attribute__((visibility("default"))) uint32_t rtk_ros_driver_abi()                   \
+    {                                                                                                  \
+        return rtk_ros::DRIVER_PLUGIN_ABI;                                                             \
+    }                                                                                                  \
+    extern "C" __attribute__((visibility("default"))) GPSHelper *rtk_ros_create_driver(const rtk_ros::DriverArgs *args) \
+    {                                                                                                  \
+        return driver;                                                                                 \
+    }                                                                                                  \
+    extern "C" __attribute__((visibility("default"))) void rtk_ros_destroy_driver(GPSHelper *helper)  \
+    {                                                                                                  \
+        delete helper;                                                                                 \
+    }
+
+namespace rtk_ros {
+
+class DriverLoader
+{
+public:
+    DriverLoader() = default;
+    DriverLoader(const DriverLoader &) = delete;
+    DriverLoader &operator=(const DriverLoader &) = delete;
+
+    /** Drivers must be destroyed before the loader */
+    ~DriverLoader() { unload(); }
+
+    void setPath(const std::string &_path) { path = _path; }
+
+    /**
+     * Create the driver called name ("ubx", "ashtech", "mtk").
+     * @return nullptr on failure, see error()
+     */
+    GPSHelper *create(const std::string &name, const DriverArgs &args) {
+#ifdef RTK_ROS_STATIC_DRIVERS
+        if (name == "ubx") {
+            return new GPSDriverUBX(GPSDriverUBX::Interface::UART, args.callback, args.user,
+                    args.gps_position, args.satellite_info, args.dynamic_model);
+        }
+        if (name == "ashtech") return new GPSDriverAshtech(args.callback, args.user, args.gps_position, args.satellite_info);
+        if (name == "mtk") return new GPSDriverMTK(args.callback, args.user, args.gps_position);
+        lastError = "no " + name + " driver in this build";
+        return nullptr;
+#else
+        if (!load(name)) return nullptr;
+        return createFn(&args);
+#endif
+    }
+
+    void destroy(GPSHelper *driver) {
+        if (!driver) return;
+#ifdef RTK_ROS_STATIC_DRIVERS
+        delete driver;
+#else
+        // Deleted by the module that allocated it, with its own vtable and allocator
+        destroyFn(driver);
+#endif
+    }
+
+    const std::string &error() const { return lastError; }
+
+private:
+#ifndef RTK_ROS_STATIC_DRIVERS
+    typedef uint32_t (*AbiFn)();
+    typedef GPSHelper *(*CreateFn)(const DriverArgs *);
+    typedef void (*DestroyFn)(GPSHelper *);
+
+    bool load(const std::string &name) {
+        unload();
+        std::string file = "librtk_ros_driver_" + name + ".so";
+        if (!path.empty()) file = path + "/" + file;
+        handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            lastError = dlerror();
+            return false;
+        }
+        AbiFn abiFn = (AbiFn)dlsym(handle, "rtk_ros_driver_abi");
+        createFn = (CreateFn)dlsym(handle, "rtk_ros_create_driver");
+        destroyFn = (DestroyFn)dlsym(handle, "rtk_ros_destroy_driver");
+        if (!abiFn || !createFn || !destroyFn) {
+            lastError = file + " is not an rtk_ros driver";
+            unload();
+            return false;
+        }
+        if (abiFn() != DRIVER_PLUGIN_ABI) {
+            lastError = file + " was built for another rtk_ros version";
+            unload();
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    void unload() {
+#ifndef RTK_ROS_STATIC_DRIVERS
+        if (handle) {
+            dlclose(handle);
+            handle = nullptr;
+        }
+        createFn = nullptr;
+        destroyFn = nullptr;
+#endif
+    }
+
+    std::string path;
+    std::string lastError;
+#ifndef RTK_ROS_STATIC_DRIVERS
+    void *handle = nullptr;
+    CreateFn createFn = nullptr;
+    DestroyFn destroyFn = nullptr;
+#endif
+};
+
+} // namespace rtk_ros
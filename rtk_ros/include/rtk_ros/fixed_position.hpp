@@ -0,0 +1,67 @@
+/**
+ * @file fixed_position.hpp
+ * Fixed base position file written by rtk_base_refine and loaded by rtk_node
+ * (base/fixed_position_file). It is a flat "key: value" YAML file:
+ *
+ *   ecef_x: 4019006.3462   # [m]
+ *   ecef_y: 331395.9122
+ *   ecef_z: 4924219.7881
+ *   accuracy: 0.0123       # 3D standard error [m]
+ *   samples: 86400
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+
+namespace rtk_ros {
+
+struct FixedPosition {
+    double ecef[3] = {0.0, 0.0, 0.0}; ///< [m]
+    float accuracy = 0.f;               ///< [m]
+    uint64_t samples = 0;
+
+    bool save(const std::string &path, const char *comment = nullptr) const {
+        FILE *f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        if (comment) fprintf(f, "# %s\n", comment);
+        fprintf(f, "ecef_x: %.4f\n", ecef[0]);
+        fprintf(f, "ecef_y: %.4f\n", ecef[1]);
+        fprintf(f, "ecef_z: %.4f\n", ecef[2]);
+        fprintf(f, "accuracy: %.4f\n", accuracy);
+        fprintf(f, "samples: %llu\n", (unsigned long long)samples);
+        return fclose(f) == 0;
+    }
+
+    /** @return false if the file cannot be read, misses a coordinate or holds a value that is not finite */
+    bool load(const std::string &path) {
+        FILE *f = fopen(path.c_str(), "r");
+        if (!f) return false;
+        char line[256];
+        int found = 0;
+        while (fgets(line, sizeof(line), f)) {
+            char *colon = strchr(line, ':');
+            if (line[0] == '#' || !colon) continue;
+            *colon = '\0';
+            const double value = strtod(colon + 1, nullptr);
+            if (!isfinite(value)) {
+                fclose(f);
+                return false;
+            }
+            if (!strcmp(line, "ecef_x")) { ecef[0] = value; found |= 1; }
+            else if (!strcmp(line, "ecef_y")) { ecef[1] = value; found |= 2; }
+            else if (!strcmp(line, "ecef_z")) { ecef[2] = value; found |= 4; }
+            else if (!strcmp(line, "accuracy")) { accuracy = (float)value; }
+            else if (!strcmp(line, "samples")) { samples = (uint64_t)value; }
+        }
+        fclose(f);
+        return found == 7 && accuracy >= 0.f;
+    }
+};
+
+} // namespace rtk_ros
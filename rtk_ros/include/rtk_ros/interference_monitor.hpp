@@ -0,0 +1,169 @@
+/**
+ * @file interference_monitor.hpp
+ * Jamming and spoofing detection from the receiver's RF monitoring
+ * (MON-HW / MON-RF, noise_per_ms, jamming_indicator) and the spread of
+ * C/N0 across satellites.
+ *
+ * Genuine signals show a C/N0 spread of several dBHz that grows with
+ * elevation. A single spoofing transmitter produces nearly uniform C/N0
+ * with no elevation dependency, which is what the uniformity test looks for.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "satellite_table.hpp"
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+
+class InterferenceMonitor
+{
+public:
+    enum JammingState : uint8_t {
+        JAMMING_UNKNOWN = 0,
+        JAMMING_OK = 1,
+        JAMMING_WARNING = 2,
+        JAMMING_CRITICAL = 3
+    };
+
+    struct Thresholds {
+        uint8_t min_satellites = 6;          ///< satellites needed for the C/N0 test
+        float min_elevation = 10.f;          ///< [deg] satellites below are ignored
+        float max_uniform_stddev = 2.0f;     ///< [dBHz] spread below this is suspicious
+        float min_elevation_correlation = 0.2f; ///< C/N0 vs elevation correlation of genuine signals
+        float max_mean_cno = 52.f;           ///< [dBHz] mean above this is suspicious
+        uint8_t jam_indicator_warning = 100; ///< MON-HW jamInd (0..255)
+        float noise_ratio_warning = 1.5f;    ///< noise_per_ms relative to its baseline
+        uint16_t clear_epochs = 30;          ///< clean epochs before a detection is cleared
+    };
+
+    struct State {
+        uint8_t jamming_state = JAMMING_UNKNOWN; ///< as reported by the receiver
+        uint8_t jam_indicator = 0;
+        uint16_t noise_per_ms = 0;
+        uint16_t agc_count = 0;
+        float noise_baseline = 0.f;
+        uint16_t num_sv = 0;
+        float cno_mean = 0.f;
+        float cno_stddev = 0.f;
+        float cno_elevation_correlation = 0.f;
+        bool jamming_suspected = false;
+        bool spoofing_suspected = false;
+    };
+
+    Thresholds thresholds;
+
+    /** MON-HW payload (60 bytes) */
+    bool decodeMonHw(const uint8_t *payload, size_t len) {
+        if (len < 60) return false;
+        rfReceived = true;
+        updateRf(ubx::readU2(payload + 16), ubx::readU2(payload + 18), (payload[22] >> 2) & 0x03, payload[45]);
+        return true;
+    }
+
+    /** MON-RF payload, the worst RF block is kept */
+    bool decodeMonRf(const uint8_t *payload, size_t len) {
+        if (len < 4) return false;
+        const uint8_t blocks = payload[1];
+        if (len < 4 + 24 * (size_t)blocks || blocks == 0) return false;
+
+        const uint8_t *worst = payload + 4;
+        for (uint8_t b = 1; b < blocks; b++) {
+            const uint8_t *block = payload + 4 + 24 * b;
+            if (block[16] > worst[16]) worst = block;
+        }
+        rfReceived = true;
+        updateRf(ubx::readU2(worst + 12), ubx::readU2(worst + 14), worst[1] & 0x03, worst[16]);
+        return true;
+    }
+
+    /** noise_per_ms / jamming_indicator as reported in vehicle_gps_position_s */
+    void updatePosition(int32_t noise_per_ms, int32_t jamming_indicator) {
+        if (rfReceived) return; // MON-HW/MON-RF carry the same values and more
+        updateRf((uint16_t)noise_per_ms, state.agc_count, state.jamming_state, (uint8_t)jamming_indicator);
+    }
+
+    /** Run the C/N0 uniformity test over a satellite epoch and update the verdicts */
+    template <typename Table>
+    void update(const Table &table) {
+        // Masked accumulations in one pass, no branches on the data
+        float n = 0.f, sum_c = 0.f, sum_cc = 0.f, sum_e = 0.f, sum_ee = 0.f, sum_ce = 0.f;
+        for (uint16_t i = 0; i < table.count; i++) {
+            const float c = table.cno[i];
+            const float e = table.elevation[i];
+            const float m = (c > 0.f && e >= thresholds.min_elevation) ? 1.f : 0.f;
+            n += m;
+            sum_c += m * c;
+            sum_cc += m * c * c;
+            sum_e += m * e;
+            sum_ee += m * e * e;
+            sum_ce += m * c * e;
+        }
+
+        state.num_sv = (uint16_t)n;
+        bool spoofing = false;
+        if (n >= thresholds.min_satellites) {
+            const float mean_c = sum_c / n;
+            const float mean_e = sum_e / n;
+            const float var_c = fmaxf(sum_cc / n - mean_c * mean_c, 0.f);
+            const float var_e = fmaxf(sum_ee / n - mean_e * mean_e, 0.f);
+            const float cov = sum_ce / n - mean_c * mean_e;
+            state.cno_mean = mean_c;
+            state.cno_stddev = sqrtf(var_c);
+            state.cno_elevation_correlation = (var_c > 0.f && var_e > 0.f) ? cov / sqrtf(var_c * var_e) : 0.f;
+
+            const bool uniform = state.cno_stddev < thresholds.max_uniform_stddev;
+            const bool uncorrelated = state.cno_elevation_correlation < thresholds.min_elevation_correlation;
+            spoofing = (uniform && uncorrelated) || state.cno_mean > thresholds.max_mean_cno;
+        } else {
+            state.cno_mean = n > 0.f ? sum_c / n : 0.f;
+            state.cno_stddev = 0.f;
+            state.cno_elevation_correlation = 0.f;
+        }
+
+        const bool jamming = state.jamming_state >= JAMMING_WARNING
+            || state.jam_indicator >= thresholds.jam_indicator_warning
+            || (state.noise_baseline > 0.f && state.noise_per_ms > thresholds.noise_ratio_warning * state.noise_baseline);
+
+        latch(spoofing, state.spoofing_suspected, spoofingClean);
+        latch(jamming, state.jamming_suspected, jammingClean);
+    }
+
+    const State &status() const { return state; }
+
+private:
+    void updateRf(uint16_t noise, uint16_t agc, uint8_t jamming_state, uint8_t jam_indicator) {
+        state.noise_per_ms = noise;
+        state.agc_count = agc;
+        state.jamming_state = jamming_state;
+        state.jam_indicator = jam_indicator;
+
+        // Slow baseline, frozen while jamming is suspected so it does not learn the jammer
+        if (state.noise_baseline <= 0.f) {
+            state.noise_baseline = noise;
+        } else if (!state.jamming_suspected) {
+            state.noise_baseline += 0.01f * ((float)noise - state.noise_baseline);
+        }
+    }
+
+    /** Raise immediately, clear only after clear_epochs clean epochs */
+    void latch(bool detected, bool &suspected, uint16_t &clean) {
+        if (detected) {
+            suspected = true;
+            clean = 0;
+        } else if (suspected && ++clean >= thresholds.clear_epochs) {
+            suspected = false;
+        }
+    }
+
+    State state;
+    bool rfReceived = false;
+    uint16_t spoofingClean = 0;
+    uint16_t jammingClean = 0;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,255 @@
+/**
+ * @file mavlink_rtcm.hpp
+ * RTCM corrections sent as MAVLink GPS_RTCM_DATA over UDP, without mavros.
+ *
+ * A message is fragmented the way the mavros gps_rtk plugin does it: up to
+ * 180 bytes go in one unfragmented packet, longer messages (up to 4 x 180
+ * bytes) are split in fragments sharing a 5-bit sequence id:
+ *
+ *   flags  bit 0     fragmented
+ *          bits 1-2  fragment id
+ *          bits 3-7  sequence id
+ *
+ * Packets are MAVLink 2 with the trailing zeros of the payload truncated.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace rtk_ros {
+namespace mavlink {
+
+static const uint8_t STX_V2 = 0xFD;
+/** STX, length, incompat/compat flags, sequence, system, component, 24-bit message id */
+static const size_t HEADER_LENGTH = 10;
+static const size_t CHECKSUM_LENGTH = 2;
+
+static const uint32_t MSG_ID_GPS_RTCM_DATA = 233;
+static const uint8_t GPS_RTCM_DATA_CRC_EXTRA = 35;
+/** flags, len, data[180] */
+static const size_t GPS_RTCM_DATA_LENGTH = 182;
+static const size_t MAX_PACKET_LENGTH = HEADER_LENGTH + GPS_RTCM_DATA_LENGTH + CHECKSUM_LENGTH;
+
+static const size_t RTCM_FRAGMENT_LENGTH = 180;
+static const size_t RTCM_MAX_FRAGMENTS = 4;
+static const size_t RTCM_MAX_MESSAGE_LENGTH = RTCM_FRAGMENT_LENGTH * RTCM_MAX_FRAGMENTS;
+
+/** CRC-16/MCRF4XX step, the MAVLink (X.25) checksum */
+inline uint16_t crcAccumulate(uint8_t b, uint16_t crc)
+{
+    uint8_t tmp = b ^ (uint8_t)(crc & 0xFF);
+    tmp ^= (uint8_t)(tmp << 4);
+    return (uint16_t)((crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4));
+}
+
+/** Bytes of the GPS_RTCM_DATA packets carrying an RTCM message of len bytes, at most (trailing zeros are truncated) */
+inline size_t gpsRtcmDataLength(size_t len)
+{
+    const size_t packets = len > RTCM_FRAGMENT_LENGTH ? (len + RTCM_FRAGMENT_LENGTH - 1) / RTCM_FRAGMENT_LENGTH : 1;
+    return len + packets * (HEADER_LENGTH + CHECKSUM_LENGTH + 2);
+}
+
+inline uint8_t rtcmFlags(bool fragmented, uint8_t fragment, uint8_t sequence)
+{
+    return (uint8_t)((fragmented ? 1 : 0) | ((fragment & 0x03) << 1) | ((sequence & 0x1F) << 3));
+}
+
+/**
+ * Serialize a GPS_RTCM_DATA packet.
+ * @param seq MAVLink packet sequence
+ * @return packet length
+ */
+inline size_t packGpsRtcmData(uint8_t seq, uint8_t sysid, uint8_t compid, uint8_t flags,
+        const uint8_t *data, uint8_t len, uint8_t out[MAX_PACKET_LENGTH])
+{
+    uint8_t *payload = out + HEADER_LENGTH;
+    payload[0] = flags;
+    payload[1] = len;
+    memcpy(payload + 2, data, len);
+    memset(payload + 2 + len, 0, RTCM_FRAGMENT_LENGTH - len);
+
+    // MAVLink 2 drops the trailing zeros, at least one payload byte is kept
+    size_t length = GPS_RTCM_DATA_LENGTH;
+    while (length > 1 && payload[length - 1] == 0) --length;
+
+    out[0] = STX_V2;
+    out[1] = (uint8_t)length;
+    out[2] = 0; // incompat flags, not signed
+    out[3] = 0; // compat flags
+    out[4] = seq;
+    out[5] = sysid;
+    out[6] = compid;
+    out[7] = (uint8_t)(MSG_ID_GPS_RTCM_DATA & 0xFF);
+    out[8] = (uint8_t)((MSG_ID_GPS_RTCM_DATA >> 8) & 0xFF);
+    out[9] = (uint8_t)(MSG_ID_GPS_RTCM_DATA >> 16);
+
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 1; i < HEADER_LENGTH + length; i++) {
+        crc = crcAccumulate(out[i], crc);
+    }
+    crc = crcAccumulate(GPS_RTCM_DATA_CRC_EXTRA, crc);
+    out[HEADER_LENGTH + length] = (uint8_t)(crc & 0xFF);
+    out[HEADER_LENGTH + length + 1] = (uint8_t)(crc >> 8);
+    return HEADER_LENGTH + length + CHECKSUM_LENGTH;
+}
+
+} // namespace mavlink
+
+/** GPS_RTCM_DATA sender to a UDP MAVLink endpoint */
+class MavlinkRtcmOutput
+{
+public:
+    struct Counters {
+        uint64_t messages = 0;
+        uint64_t packets = 0;
+        uint64_t bytes = 0;           ///< UDP payload bytes sent
+        uint64_t rtcm_bytes = 0;      ///< RTCM bytes carried
+        uint64_t too_long = 0;        ///< messages over RTCM_MAX_MESSAGE_LENGTH, dropped
+        uint64_t would_block = 0;     ///< messages refused whole on a full socket buffer
+        uint64_t send_errors = 0;
+
+        /** RTCM bytes per byte of fragment capacity */
+        double efficiency() const {
+            return packets > 0 ? (double)rtcm_bytes / (packets * mavlink::RTCM_FRAGMENT_LENGTH) : 0.0;
+        }
+    };
+
+    /** Default ids of a ground station, as mavros uses to inject corrections */
+    static const uint8_t DEFAULT_SYSTEM_ID = 255;
+    static const uint8_t DEFAULT_COMPONENT_ID = 190;
+
+    MavlinkRtcmOutput() = default;
+    MavlinkRtcmOutput(const MavlinkRtcmOutput &) = delete;
+    MavlinkRtcmOutput &operator=(const MavlinkRtcmOutput &) = delete;
+    ~MavlinkRtcmOutput() { close(); }
+
+    /**
+     * Resolve the endpoint, udp://host:port.
+     * @return false if the URI is invalid or the host unknown
+     */
+    bool open(const std::string &uri, uint8_t _sysid = DEFAULT_SYSTEM_ID, uint8_t _compid = DEFAULT_COMPONENT_ID) {
+        close();
+        sysid = _sysid;
+        compid = _compid;
+        if (uri.compare(0, 6, "udp://") != 0) return false;
+        const std::string rest = uri.substr(6);
+        const std::string::size_type colon = rest.rfind(':');
+        if (colon == std::string::npos || colon + 1 >= rest.size()) return false;
+        std::string host = rest.substr(0, colon);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        struct addrinfo *result = nullptr;
+        if (getaddrinfo(host.c_str(), rest.substr(colon + 1).c_str(), &hints, &result) != 0) return false;
+        for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd < 0) continue;
+            memcpy(&destination, ai->ai_addr, ai->ai_addrlen);
+            destinationLength = ai->ai_addrlen;
+            break;
+        }
+        freeaddrinfo(result);
+        return fd >= 0;
+    }
+
+    void close() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool isOpen() const { return fd >= 0; }
+
+    /**
+     * Send one RTCM message, in fragments if it is longer than 180 bytes.
+     * @return false if it was dropped or a packet could not be sent, see wouldBlock()
+     */
+    bool send(const uint8_t *data, size_t len) {
+        blocked = false;
+        if (fd < 0) return false;
+        if (len > mavlink::RTCM_MAX_MESSAGE_LENGTH) {
+            ++count.too_long;
+            return false;
+        }
+        const bool fragmented = len > mavlink::RTCM_FRAGMENT_LENGTH;
+        const uint8_t sequence = rtcmSequence;
+        bool ok = true;
+        for (uint8_t fragment = 0; len > 0; fragment++) {
+            const size_t n = len < mavlink::RTCM_FRAGMENT_LENGTH ? len : mavlink::RTCM_FRAGMENT_LENGTH;
+            if (!sendPacket(mavlink::rtcmFlags(fragmented, fragment, sequence), data, (uint8_t)n)) {
+                if (fragment == 0 && blocked) {
+                    // Nothing went out, the message can be sent again as it is
+                    ++count.would_block;
+                    return false;
+                }
+                ++count.send_errors;
+                blocked = false;
+                ok = false;
+            }
+            data += n;
+            len -= n;
+        }
+        ++count.messages;
+        ++rtcmSequence;
+        return ok;
+    }
+
+    /** The last send() failed on a full socket buffer before sending anything */
+    bool wouldBlock() const { return blocked; }
+
+    /** Wait until a packet can be sent, at most timeout [s] */
+    bool waitWritable(double timeout) {
+        if (fd < 0) return false;
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        int ret;
+        do {
+            ret = poll(&pfd, 1, (int)(timeout * 1000.0 + 0.5));
+        } while (ret < 0 && errno == EINTR);
+        return ret > 0 && (pfd.revents & POLLOUT);
+    }
+
+    const Counters &counters() const { return count; }
+
+private:
+    bool sendPacket(uint8_t flags, const uint8_t *data, uint8_t len) {
+        uint8_t packet[mavlink::MAX_PACKET_LENGTH];
+        const size_t n = mavlink::packGpsRtcmData(packetSequence++, sysid, compid, flags, data, len, packet);
+        ssize_t ret;
+        do {
+            ret = sendto(fd, packet, n, MSG_DONTWAIT | MSG_NOSIGNAL, (const struct sockaddr *)&destination, destinationLength);
+        } while (ret < 0 && errno == EINTR);
+        if (ret != (ssize_t)n) {
+            blocked = ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS);
+            return false;
+        }
+        ++count.packets;
+        count.bytes += n;
+        count.rtcm_bytes += len;
+        return true;
+    }
+
+    int fd = -1;
+    struct sockaddr_storage destination;
+    socklen_t destinationLength = 0;
+    uint8_t sysid = DEFAULT_SYSTEM_ID;
+    uint8_t compid = DEFAULT_COMPONENT_ID;
+    uint8_t packetSequence = 0;
+    uint8_t rtcmSequence = 0;
+    bool blocked = false;
+    Counters count;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,259 @@
+/**
+ * @file protocol_detect.hpp
+ * Detection of the receiver protocol among the drivers built into rtk_ros_lib.
+ *
+ * The port is sniffed at each candidate baudrate for valid frames of:
+ *
+ *   UBX      sync pair, length and Fletcher checksum     -> GPSDriverUBX
+ *   MTK      binary packets, 0xD0/0xD1 0xDD + 35 bytes    -> GPSDriverMTK
+ *   NMEA     checksummed sentences                        -> GPSDriverAshtech
+ *
+ * A UBX MON-VER poll is sent at each baudrate, so a u-blox receiver that only
+ * outputs NMEA (its factory configuration) is still recognized as UBX.
+ *
+ * The result is cached per port in a text file of "protocol baud port" lines,
+ * the next start only confirms the cached entry instead of sweeping.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "stream_demux.hpp"
+#include "transport.hpp"
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+
+enum class GpsProtocol : uint8_t {
+    Unknown = 0,
+    UBX,
+    Ashtech,
+    MTK
+};
+
+inline const char *protocolName(GpsProtocol protocol)
+{
+    switch (protocol) {
+        case GpsProtocol::UBX: return "ubx";
+        case GpsProtocol::Ashtech: return "ashtech";
+        case GpsProtocol::MTK: return "mtk";
+        default: return "unknown";
+    }
+}
+
+/** @return Unknown for any other name, e.g. "auto" */
+inline GpsProtocol protocolFromName(const std::string &name)
+{
+    if (name == "ubx") return GpsProtocol::UBX;
+    if (name == "ashtech") return GpsProtocol::Ashtech;
+    if (name == "mtk") return GpsProtocol::MTK;
+    return GpsProtocol::Unknown;
+}
+
+/** Counts valid frames of each protocol in a byte stream */
+class ProtocolSniffer
+{
+public:
+    /** A UBX frame is already sync + length + a 16-bit checksum, the others need two */
+    static const uint64_t MIN_UBX_FRAMES = 1;
+    static const uint64_t MIN_FRAMES = 2;
+
+    static const uint8_t MTK_SYNC1_V16 = 0xD0;
+    static const uint8_t MTK_SYNC1_V19 = 0xD1;
+    static const uint8_t MTK_SYNC2 = 0xDD;
+    /** Packet after the sync pair: payload size, 32 bytes of solution and the checksum */
+    static const size_t MTK_PACKET_LENGTH = 35;
+
+    void reset() {
+        demux = StreamDemux();
+        mtkState = 0;
+        mtkFrames = 0;
+    }
+
+    void feed(const uint8_t *data, size_t len) {
+        demux.parse(data, len, *this);
+        for (size_t i = 0; i < len; i++) {
+            feedMtk(data[i]);
+        }
+    }
+
+    /** Best match so far, UBX first as an NMEA stream may come from a u-blox receiver */
+    GpsProtocol result() const {
+        const StreamDemux::Counters &c = demux.counters();
+        if (c.ubx.frames >= MIN_UBX_FRAMES) return GpsProtocol::UBX;
+        if (mtkFrames >= MIN_FRAMES) return GpsProtocol::MTK;
+        if (c.nmea.frames >= MIN_FRAMES) return GpsProtocol::Ashtech;
+        return GpsProtocol::Unknown;
+    }
+
+    const StreamDemux::Counters &counters() const { return demux.counters(); }
+    uint64_t mtkPackets() const { return mtkFrames; }
+
+    // StreamDemux handler, only its counters are used
+    void onUbxMessage(uint8_t, uint8_t, const uint8_t *, uint16_t) {}
+    void onRtcmFrame(const uint8_t *, size_t) {}
+    void onNmeaSentence(const char *, size_t) {}
+
+private:
+    void feedMtk(uint8_t b) {
+        if (mtkState == 0) {
+            if (b == MTK_SYNC1_V16 || b == MTK_SYNC1_V19) mtkState = 1;
+            return;
+        }
+        if (mtkState == 1) {
+            if (b == MTK_SYNC2) {
+                mtkState = 2;
+                mtkCount = 0;
+                ck_a = ck_b = 0;
+            } else {
+                mtkState = 0;
+                feedMtk(b);
+            }
+            return;
+        }
+        if (mtkCount < MTK_PACKET_LENGTH - 2) {
+            ck_a += b;
+            ck_b += ck_a;
+        } else if (mtkCount == MTK_PACKET_LENGTH - 2) {
+            rx_ck_a = b;
+        } else {
+            if (rx_ck_a == ck_a && b == ck_b) ++mtkFrames;
+            // A checksum error may hide a sync pair inside the packet, rare enough while sniffing
+            mtkState = 0;
+        }
+        ++mtkCount;
+    }
+
+    StreamDemux demux;
+    int mtkState = 0;
+    size_t mtkCount = 0;
+    uint8_t ck_a = 0, ck_b = 0, rx_ck_a = 0;
+    uint64_t mtkFrames = 0;
+};
+
+struct ProtocolDetection {
+    GpsProtocol protocol = GpsProtocol::Unknown;
+    unsigned baud = 0;
+};
+
+/** Baudrates swept when the port has no cached protocol, most common first */
+static const unsigned DETECT_BAUDRATES[] = {115200, 9600, 38400, 57600, 230400, 460800, 921600};
+
+/**
+ * Sniff the transport at each baudrate for window_ms or until a UBX frame is seen.
+ * Remote transports keep their own baudrate, pass a single entry for them.
+ * @return Unknown if no protocol was recognized, the transport is left at the last baudrate
+ */
+inline ProtocolDetection detectProtocol(Transport &transport, const std::vector<unsigned> &bauds, int window_ms)
+{
+    // UBX-MON-VER poll, answered whatever the enabled output protocols
+    static const uint8_t MON_VER_POLL[] = {ubx::SYNC1, ubx::SYNC2, ubx::CLASS_MON, ubx::ID_MON_VER, 0x00, 0x00, 0x0E, 0x34};
+
+    ProtocolDetection detection;
+    ProtocolSniffer sniffer;
+    uint8_t buffer[1024];
+    for (unsigned baud : bauds) {
+        transport.setBaudrate(baud);
+        // Bytes received at the previous baudrate
+        while (transport.available() > 0 && transport.read(buffer, sizeof(buffer)) > 0) {}
+        sniffer.reset();
+        transport.write(MON_VER_POLL, sizeof(MON_VER_POLL));
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(window_ms);
+        while (sniffer.result() != GpsProtocol::UBX) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0 || !transport.waitReadable((int)remaining.count())) break;
+            const int n = transport.read(buffer, sizeof(buffer));
+            if (n < 0) return detection;
+            sniffer.feed(buffer, (size_t)n);
+        }
+
+        if (sniffer.result() != GpsProtocol::Unknown) {
+            detection.protocol = sniffer.result();
+            detection.baud = baud;
+            return detection;
+        }
+    }
+    return detection;
+}
+
+/** Last detected protocol of each port */
+class ProtocolCache
+{
+public:
+    explicit ProtocolCache(const std::string &_path) : path(_path) {}
+
+    bool lookup(const std::string &port, ProtocolDetection &detection) const {
+        std::vector<Entry> entries;
+        if (!load(entries)) return false;
+        for (const Entry &e : entries) {
+            if (e.port == port) {
+                detection = e.detection;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Add or replace the entry of port, @return false if the file cannot be written */
+    bool store(const std::string &port, const ProtocolDetection &detection) const {
+        std::vector<Entry> entries;
+        load(entries);
+        bool found = false;
+        for (Entry &e : entries) {
+            if (e.port == port) {
+                e.detection = detection;
+                found = true;
+            }
+        }
+        if (!found) entries.push_back(Entry{port, detection});
+
+        FILE *f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        fprintf(f, "# rtk_ros protocol detection cache: protocol baud port\n");
+        for (const Entry &e : entries) {
+            fprintf(f, "%s %u %s\n", protocolName(e.detection.protocol), e.detection.baud, e.port.c_str());
+        }
+        return fclose(f) == 0;
+    }
+
+private:
+    struct Entry {
+        std::string port;
+        ProtocolDetection detection;
+    };
+
+    bool load(std::vector<Entry> &entries) const {
+        if (path.empty()) return false;
+        FILE *f = fopen(path.c_str(), "r");
+        if (!f) return false;
+        char line[512];
+        while (fgets(line, sizeof(line), f)) {
+            char name[16];
+            unsigned baud;
+            int consumed = 0;
+            if (line[0] == '#' || sscanf(line, "%15s %u %n", name, &baud, &consumed) != 2) continue;
+            std::string port(line + consumed);
+            while (!port.empty() && (port.back() == '\n' || port.back() == '\r' || port.back() == ' ')) port.pop_back();
+            const GpsProtocol protocol = protocolFromName(name);
+            if (port.empty() || protocol == GpsProtocol::Unknown) continue;
+            Entry e;
+            e.port = port;
+            e.detection.protocol = protocol;
+            e.detection.baud = baud;
+            entries.push_back(e);
+        }
+        fclose(f);
+        return true;
+    }
+
+    std::string path;
+};
+
+} // namespace rtk_ros
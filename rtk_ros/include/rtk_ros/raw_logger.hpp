@@ -0,0 +1,180 @@
+/**
+ * @file raw_logger.hpp
+ * Binary log of raw measurements and navigation subframes for post-processing.
+ *
+ * Records are copied into a ring buffer allocated once in open() and written
+ * to the file by a separate thread, so the receive path never waits on the
+ * disk. When the buffer is full, records are dropped and counted rather than
+ * delaying the caller.
+ *
+ * File layout (little endian): the 8-byte magic "RTKRAW01", then records of
+ *   RecordHeader { uint32 sync 0x52574152 ("RAWR"), uint16 type, uint16 length, uint64 host time [ns] }
+ *   followed by length bytes:
+ *     RECORD_RAWX   RawEpochHeader + count * RawMeasurement
+ *     RECORD_SFRBX  NavSubframe, only its first size() bytes
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "raw_observations.hpp"
+
+namespace rtk_ros {
+
+class RawLogger
+{
+public:
+    static const uint32_t RECORD_SYNC = 0x52574152;
+    static const uint16_t RECORD_RAWX = 1;
+    static const uint16_t RECORD_SFRBX = 2;
+
+    struct RecordHeader {
+        uint32_t sync;
+        uint16_t type;
+        uint16_t length;
+        uint64_t time;
+    };
+    static_assert(sizeof(RecordHeader) == 16, "RecordHeader must not be padded");
+
+    ~RawLogger() { close(); }
+
+    /**
+     * Create the file and start the writer thread.
+     * @param capacity ring buffer size [bytes]
+     */
+    bool open(const std::string &path, size_t capacity) {
+        close();
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        if (::write(fd, "RTKRAW01", 8) != 8) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        buffer.assign(capacity, 0);
+        head = tail = 0;
+        dropped = 0;
+        writeFailed = false;
+        running = true;
+        writer = std::thread(&RawLogger::writerLoop, this);
+        return true;
+    }
+
+    /** Flush what is buffered and close the file */
+    void close() {
+        if (!writer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        writer.join();
+        ::close(fd);
+        fd = -1;
+    }
+
+    bool isOpen() const { return fd >= 0; }
+
+    /** @return false if the record was dropped */
+    bool logEpoch(const RawEpoch &epoch, uint64_t time_ns) {
+        return push(RECORD_RAWX, time_ns, &epoch.header, sizeof(epoch.header),
+                epoch.meas, epoch.header.count * sizeof(RawMeasurement));
+    }
+
+    bool logSubframe(const NavSubframe &subframe, uint64_t time_ns) {
+        return push(RECORD_SFRBX, time_ns, &subframe, subframe.size(), nullptr, 0);
+    }
+
+    uint64_t droppedRecords() const { return dropped; }
+    uint64_t writtenBytes() const { return written; }
+    bool failed() const { return writeFailed; }
+
+private:
+    /** Single producer: only the receive thread may call this */
+    bool push(uint16_t type, uint64_t time, const void *a, size_t a_len, const void *b, size_t b_len) {
+        const size_t length = a_len + b_len;
+        const size_t total = sizeof(RecordHeader) + length;
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t used = h - tail.load(std::memory_order_acquire);
+        if (!isOpen() || writeFailed || length > 0xFFFF || used + total > buffer.size()) {
+            ++dropped;
+            return false;
+        }
+
+        RecordHeader record = {RECORD_SYNC, type, (uint16_t)length, time};
+        size_t pos = h;
+        pos = copyIn(pos, &record, sizeof(record));
+        pos = copyIn(pos, a, a_len);
+        pos = copyIn(pos, b, b_len);
+        head.store(pos, std::memory_order_release);
+
+        // The writer polls, only wake it early when the buffer fills up
+        if (used + total > buffer.size() / 2) wake.notify_one();
+        return true;
+    }
+
+    size_t copyIn(size_t pos, const void *data, size_t len) {
+        if (len == 0) return pos;
+        const size_t offset = pos % buffer.size();
+        const size_t first = len < buffer.size() - offset ? len : buffer.size() - offset;
+        memcpy(&buffer[offset], data, first);
+        memcpy(&buffer[0], (const uint8_t *)data + first, len - first);
+        return pos + len;
+    }
+
+    void writerLoop() {
+        bool stop = false;
+        while (!stop) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_for(lock, std::chrono::milliseconds(200));
+                stop = !running;
+            }
+            const size_t h = head.load(std::memory_order_acquire);
+            size_t t = tail.load(std::memory_order_relaxed);
+            while (t < h && !writeFailed) {
+                const size_t offset = t % buffer.size();
+                size_t len = h - t;
+                if (len > buffer.size() - offset) len = buffer.size() - offset;
+                const ssize_t ret = ::write(fd, &buffer[offset], len);
+                if (ret < 0) {
+                    if (errno == EINTR) continue;
+                    writeFailed = true;
+                    break;
+                }
+                t += ret;
+                written += ret;
+                tail.store(t, std::memory_order_release);
+            }
+        }
+    }
+
+    int fd = -1;
+    std::vector<uint8_t> buffer;
+    std::atomic<size_t> head{0};    ///< bytes pushed, only advanced by the producer
+    std::atomic<size_t> tail{0};    ///< bytes written, only advanced by the writer
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<bool> writeFailed{false};
+    bool running = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+};
+
+} // namespace rtk_ros
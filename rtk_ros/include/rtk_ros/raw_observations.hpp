@@ -0,0 +1,141 @@
+/**
+ * @file raw_observations.hpp
+ * Raw GNSS measurements (UBX-RXM-RAWX) and navigation subframes (UBX-RXM-SFRBX).
+ *
+ * The structures have a fixed layout so that they can be logged as they are,
+ * see raw_logger.hpp.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ubx_protocol.hpp"
+
+#ifndef RTK_RAW_MAX_MEASUREMENTS
+#define RTK_RAW_MAX_MEASUREMENTS 128
+#endif
+
+namespace rtk_ros {
+
+/** One RXM-RAWX measurement block */
+struct RawMeasurement {
+    double pseudorange;     ///< [m]
+    double carrier_phase;   ///< [cycles]
+    float doppler;          ///< [Hz]
+    uint8_t gnss_id;
+    uint8_t sv_id;
+    uint8_t sig_id;
+    uint8_t freq_id;        ///< GLONASS frequency slot + 7
+    uint16_t lock_time;     ///< carrier phase lock time [ms], capped at 64500
+    uint8_t cno;            ///< [dBHz]
+    uint8_t pr_stdev;       ///< 0.01 m * 2^n
+    uint8_t cp_stdev;       ///< 0.004 cycles * n
+    uint8_t do_stdev;       ///< 0.002 Hz * 2^n
+    uint8_t trk_stat;       ///< bit 0 pseudorange valid, 1 carrier phase valid, 2 half cycle valid, 3 half cycle subtracted
+    uint8_t reserved;
+
+    float pseudorangeStdev() const { return 0.01f * (float)(1u << pr_stdev); }
+    float carrierPhaseStdev() const { return 0.004f * cp_stdev; }
+    float dopplerStdev() const { return 0.002f * (float)(1u << do_stdev); }
+};
+
+static_assert(sizeof(RawMeasurement) == 32, "RawMeasurement is logged as a fixed 32-byte record");
+
+/** Epoch header of RXM-RAWX */
+struct RawEpochHeader {
+    double rcv_tow;         ///< receiver time of week [s]
+    uint16_t week;
+    int8_t leap_seconds;
+    uint8_t num_meas;       ///< measurements reported, may exceed the stored count
+    uint8_t rec_stat;       ///< bit 0 leap seconds known, bit 1 clock reset
+    uint8_t count;          ///< measurements stored
+    uint8_t reserved[2];
+};
+
+static_assert(sizeof(RawEpochHeader) == 16, "RawEpochHeader is logged as a fixed 16-byte record");
+
+struct RawEpoch {
+    static const size_t CAPACITY = RTK_RAW_MAX_MEASUREMENTS;
+    static const size_t HEADER = 16;
+    static const size_t BLOCK = 32;
+    static_assert(CAPACITY > 0 && CAPACITY <= 255, "RXM-RAWX has at most 255 measurements");
+
+    RawEpochHeader header;
+    RawMeasurement meas[CAPACITY];
+    uint32_t truncated = 0;
+
+    /** @return false if the payload is malformed */
+    bool decodeRxmRawx(const uint8_t *payload, size_t len) {
+        if (len < HEADER) return false;
+        const uint8_t n = payload[11];
+        if (len < HEADER + BLOCK * n) return false;
+
+        header.rcv_tow = ubx::readR8(payload);
+        header.week = ubx::readU2(payload + 8);
+        header.leap_seconds = (int8_t)payload[10];
+        header.num_meas = n;
+        header.rec_stat = payload[12];
+        header.count = n < CAPACITY ? n : (uint8_t)CAPACITY;
+        header.reserved[0] = header.reserved[1] = 0;
+        if (n > CAPACITY) ++truncated;
+
+        const uint8_t *block = payload + HEADER;
+        for (uint8_t i = 0; i < header.count; i++, block += BLOCK) {
+            RawMeasurement &m = meas[i];
+            m.pseudorange = ubx::readR8(block);
+            m.carrier_phase = ubx::readR8(block + 8);
+            m.doppler = ubx::readR4(block + 16);
+            m.gnss_id = block[20];
+            m.sv_id = block[21];
+            m.sig_id = block[22];
+            m.freq_id = block[23];
+            m.lock_time = ubx::readU2(block + 24);
+            m.cno = block[26];
+            m.pr_stdev = block[27] & 0x0F;
+            m.cp_stdev = block[28] & 0x0F;
+            m.do_stdev = block[29] & 0x0F;
+            m.trk_stat = block[30];
+            m.reserved = 0;
+        }
+        return true;
+    }
+};
+
+/** RXM-SFRBX: one navigation data subframe as broadcast */
+struct NavSubframe {
+    static const size_t MAX_WORDS = 16;
+    static const size_t HEADER = 8;
+
+    uint8_t gnss_id;
+    uint8_t sv_id;
+    uint8_t sig_id;
+    uint8_t freq_id;
+    uint8_t num_words;
+    uint8_t channel;
+    uint8_t reserved[2];
+    uint32_t words[MAX_WORDS];
+
+    /** Bytes of the record actually used */
+    size_t size() const { return HEADER + 4 * num_words; }
+
+    bool decodeRxmSfrbx(const uint8_t *payload, size_t len) {
+        if (len < HEADER) return false;
+        const uint8_t n = payload[4];
+        if (n > MAX_WORDS || len < HEADER + 4 * (size_t)n) return false;
+        gnss_id = payload[0];
+        sv_id = payload[1];
+        sig_id = payload[2];
+        freq_id = payload[3];
+        num_words = n;
+        channel = payload[5];
+        reserved[0] = reserved[1] = 0;
+        for (uint8_t i = 0; i < n; i++) words[i] = ubx::readU4(payload + HEADER + 4 * i);
+        return true;
+    }
+};
+
+static_assert(sizeof(NavSubframe) == NavSubframe::HEADER + 4 * NavSubframe::MAX_WORDS, "NavSubframe must not be padded");
+
+} // namespace rtk_ros
@@ -0,0 +1,76 @@
+/**
+ * @file receiver_config.hpp
+ * Configuration the node writes after the driver's configure(), as compile-time blobs.
+ *
+ * Only the base position (TMODE3) and the navigation rate depend on
+ * parameters, they are appended at run time with the same serializer.
+ */
+
+#pragma once
+
+#include "ubx_config.hpp"
+
+namespace rtk_ros {
+namespace config {
+
+/** Messages the node always decodes, and the RTCM set it forwards */
+constexpr auto BASE_MESSAGES = ubx::configBlob(
+    // The driver only enables NAV-SVINFO, which is capped by satellite_info_s
+    ubx::cfgMsg(ubx::CLASS_NAV, ubx::ID_NAV_SAT, 1),
+    // RF monitoring, MON-RF is only known to newer firmware and NAK'ed otherwise
+    ubx::cfgMsg(ubx::CLASS_MON, ubx::ID_MON_HW, 1),
+    ubx::cfgMsg(ubx::CLASS_MON, ubx::ID_MON_RF, 1),
+    // Station position every 5 solutions, MSM7 of every constellation each solution.
+    // The receiver only outputs them in time mode, enabling them early is harmless
+    // and keeps the set independent of the driver version.
+    ubx::cfgMsg(ubx::CLASS_RTCM3, ubx::ID_RTCM3_1005, 5),
+    ubx::cfgMsg(ubx::CLASS_RTCM3, ubx::ID_RTCM3_1077, 1),
+    ubx::cfgMsg(ubx::CLASS_RTCM3, ubx::ID_RTCM3_1087, 1),
+    ubx::cfgMsg(ubx::CLASS_RTCM3, ubx::ID_RTCM3_1097, 1),
+    ubx::cfgMsg(ubx::CLASS_RTCM3, ubx::ID_RTCM3_1127, 1),
+    ubx::cfgMsg(ubx::CLASS_RTCM3, ubx::ID_RTCM3_1230, 5));
+
+/** High precision position for the host-side base estimate */
+constexpr auto HOST_ESTIMATION_MESSAGES = ubx::configBlob(
+    ubx::cfgMsg(ubx::CLASS_NAV, ubx::ID_NAV_HPPOSECEF, 1));
+
+/** Raw measurements and navigation data */
+constexpr auto RAW_MESSAGES = ubx::configBlob(
+    ubx::cfgMsg(ubx::CLASS_RXM, ubx::ID_RXM_RAWX, 1),
+    ubx::cfgMsg(ubx::CLASS_RXM, ubx::ID_RXM_SFRBX, 1));
+
+/** Survey-in status of a standby base, which runs without a driver */
+constexpr auto STANDBY_MESSAGES = ubx::configBlob(
+    ubx::cfgMsg(ubx::CLASS_NAV, ubx::ID_NAV_SVIN, 1));
+
+/** Largest configuration: every blob, a TMODE3 and a CFG-RATE */
+static const size_t MAX_CONFIG_LENGTH = sizeof(BASE_MESSAGES) + sizeof(HOST_ESTIMATION_MESSAGES) + sizeof(RAW_MESSAGES)
+        + ubx::CFG_TMODE3_LENGTH + ubx::CFG_RATE_LENGTH + 2 * ubx::FRAME_OVERHEAD;
+
+/** Standby base: the base and standby messages, a survey-in TMODE3 and a CFG-RATE */
+static const size_t STANDBY_CONFIG_LENGTH = sizeof(BASE_MESSAGES) + sizeof(STANDBY_MESSAGES)
+        + ubx::CFG_TMODE3_LENGTH + ubx::CFG_RATE_LENGTH + 2 * ubx::FRAME_OVERHEAD;
+
+static_assert(sizeof(BASE_MESSAGES) == 9 * (ubx::CFG_MSG_LENGTH + ubx::FRAME_OVERHEAD), "BASE_MESSAGES size");
+static_assert(ubx::blobMatches(BASE_MESSAGES, 0,
+        {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x35, 0x01, 0x41, 0xAD,      // NAV-SAT
+         0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x0A, 0x09, 0x01, 0x1E, 0x70,      // MON-HW
+         0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x0A, 0x38, 0x01, 0x4D, 0xCE,      // MON-RF
+         0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF5, 0x05, 0x05, 0x09, 0x2D}),    // 1005
+        "BASE_MESSAGES bytes");
+static_assert(ubx::blobMatches(BASE_MESSAGES, sizeof(BASE_MESSAGES) - 11,
+        {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0xF5, 0xE6, 0x05, 0xEA, 0xEF}),    // 1230
+        "BASE_MESSAGES bytes");
+static_assert(ubx::blobMatches(HOST_ESTIMATION_MESSAGES, 0,
+        {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x13, 0x01, 0x1F, 0x69}),    // NAV-HPPOSECEF
+        "HOST_ESTIMATION_MESSAGES bytes");
+static_assert(ubx::blobMatches(STANDBY_MESSAGES, 0,
+        {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x3B, 0x01, 0x47, 0xB9}),    // NAV-SVIN
+        "STANDBY_MESSAGES bytes");
+static_assert(ubx::blobMatches(RAW_MESSAGES, 0,
+        {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x02, 0x15, 0x01, 0x22, 0x70,      // RXM-RAWX
+         0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x02, 0x13, 0x01, 0x20, 0x6C}),    // RXM-SFRBX
+        "RAW_MESSAGES bytes");
+
+} // namespace config
+} // namespace rtk_ros
@@ -0,0 +1,401 @@
+/**
+ * @file rtcm3_msm.hpp
+ * RTCM 3 Multiple Signal Messages, MSM4 to MSM7: bit fields, decoding into a
+ * fixed-size Msm and encoding back to any of the four types.
+ *
+ * Fields are held at the MSM6/7 resolution (fine pseudorange 2^-29 ms, fine
+ * phase range 2^-31 ms, CNR 2^-4 dB-Hz, lock time in ms), so an MSM7 frame
+ * re-encoded as MSM4 keeps its header, epoch and multiple message bit, and
+ * loses the extended resolution and the range rates:
+ *
+ *   pseudorange  DF405 / 32 -> DF400
+ *   phase range  DF406 / 4  -> DF401
+ *   lock time    DF407 -> ms -> DF402, rounded down
+ *   CNR          DF408 / 16 -> DF403
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtcm3_protocol.hpp"
+
+namespace rtk_ros {
+namespace rtcm3 {
+
+/** Reads big-endian bit fields, reads past the end return 0 and set overrun() */
+class BitReader
+{
+public:
+    BitReader(const uint8_t *_data, size_t bytes) : data(_data), bits(bytes * 8) {}
+
+    uint32_t u(unsigned n) {
+        if (pos + n > bits) {
+            overrun_ = true;
+            pos = bits;
+            return 0;
+        }
+        uint32_t v = 0;
+        for (unsigned i = 0; i < n; i++, pos++) {
+            v = (v << 1) | ((data[pos >> 3] >> (7 - (pos & 7))) & 1);
+        }
+        return v;
+    }
+
+    uint64_t u64(unsigned n) {
+        const uint64_t high = n > 32 ? (uint64_t)u(n - 32) << 32 : 0;
+        return high | u(n > 32 ? 32 : n);
+    }
+
+    /** Two's complement */
+    int32_t s(unsigned n) {
+        const uint32_t v = u(n);
+        return n < 32 && (v >> (n - 1)) ? (int32_t)(v - (1u << n)) : (int32_t)v;
+    }
+
+    int64_t s64(unsigned n) {
+        const uint64_t v = u64(n);
+        return n < 64 && (v >> (n - 1)) ? (int64_t)(v - ((uint64_t)1 << n)) : (int64_t)v;
+    }
+
+    void skip(unsigned n) { pos = pos + n > bits ? bits : pos + n; }
+    size_t position() const { return pos; }
+    bool overrun() const { return overrun_; }
+
+private:
+    const uint8_t *data;
+    size_t bits;
+    size_t pos = 0;
+    bool overrun_ = false;
+};
+
+/** Writes big-endian bit fields into a zeroed buffer */
+class BitWriter
+{
+public:
+    BitWriter(uint8_t *_data, size_t bytes) : data(_data), bits(bytes * 8) {
+        for (size_t i = 0; i < bytes; i++) data[i] = 0;
+    }
+
+    void u(uint32_t v, unsigned n) {
+        if (pos + n > bits) {
+            overrun_ = true;
+            return;
+        }
+        for (unsigned i = n; i-- > 0; pos++) {
+            if ((v >> i) & 1) data[pos >> 3] |= (uint8_t)(0x80 >> (pos & 7));
+        }
+    }
+
+    void u64(uint64_t v, unsigned n) {
+        if (n > 32) u((uint32_t)(v >> 32), n - 32);
+        u((uint32_t)v, n > 32 ? 32 : n);
+    }
+
+    void s(int32_t v, unsigned n) { u((uint32_t)v & (n < 32 ? (1u << n) - 1 : 0xFFFFFFFFu), n); }
+
+    size_t position() const { return pos; }
+    bool overrun() const { return overrun_; }
+
+private:
+    uint8_t *data;
+    size_t bits;
+    size_t pos = 0;
+    bool overrun_ = false;
+};
+
+static const size_t MSM_MAX_SATELLITES = 64;
+static const size_t MSM_MAX_SIGNALS = 32;
+/** The cell mask is at most 64 bits */
+static const size_t MSM_MAX_CELLS = 64;
+/** Message number up to the signal mask: 73 bits of fields, then the 64-bit satellite and 32-bit signal masks */
+static const unsigned MSM_HEADER_BITS = 73 + 64 + 32;
+
+struct MsmSatellite {
+    uint8_t rough_range_ms = 0;     ///< DF397, 255 invalid
+    uint8_t info = 0;               ///< extended satellite information, MSM5/7
+    uint16_t rough_range_mod = 0;   ///< DF398, 2^-10 ms
+    int16_t rough_rate = 0;         ///< DF399, m/s, MSM5/7
+};
+
+struct MsmCell {
+    int32_t fine_pr = 0;            ///< 2^-29 ms
+    int32_t fine_cp = 0;            ///< 2^-31 ms
+    uint32_t lock_ms = 0;           ///< minimum lock time
+    bool pr_valid = false;
+    bool cp_valid = false;
+    bool half_cycle = false;        ///< DF420
+    uint16_t cnr = 0;               ///< 2^-4 dB-Hz, 0 not computed
+    int16_t fine_rate = 0;          ///< 0.0001 m/s, MSM5/7
+    bool rate_valid = false;
+};
+
+struct Msm {
+    uint16_t number = 0;
+    uint16_t station_id = 0;
+    uint32_t epoch = 0;             ///< 30 bits, GLONASS day of week and time of day
+    bool multiple = false;          ///< more MSM of the same epoch follow
+    uint8_t iods = 0;
+    uint8_t reserved = 0;
+    uint8_t clock_steering = 0;
+    uint8_t external_clock = 0;
+    bool smoothing = false;
+    uint8_t smoothing_interval = 0;
+    uint64_t satellite_mask = 0;    ///< bit 63 satellite 1
+    uint32_t signal_mask = 0;       ///< bit 31 signal 1
+    uint64_t cell_mask = 0;         ///< num_satellites * num_signals bits, right aligned
+    uint8_t num_satellites = 0;
+    uint8_t num_signals = 0;
+    uint8_t num_cells = 0;
+    MsmSatellite satellites[MSM_MAX_SATELLITES];
+    MsmCell cells[MSM_MAX_CELLS];
+
+    /** MSM type 1-7 */
+    uint8_t type() const { return (uint8_t)(number % 10); }
+};
+
+inline unsigned popcount64(uint64_t v)
+{
+    unsigned n = 0;
+    for (; v; v &= v - 1) n++;
+    return n;
+}
+
+/** DF407, 10-bit extended lock time indicator, to the minimum lock time [ms] */
+inline uint32_t lockTimeMsExtended(uint16_t indicator)
+{
+    if (indicator < 64) return indicator;
+    if (indicator > 704) indicator = 704;
+    const unsigned k = indicator / 32 - 1;
+    return (uint32_t)(indicator - 32 * k) << k;
+}
+
+/** Inverse of lockTimeMsExtended, rounded down */
+inline uint16_t lockTimeIndicatorExtended(uint32_t ms)
+{
+    if (ms < 64) return (uint16_t)ms;
+    unsigned k = 0;
+    while (k < 21 && (ms >> (k + 6)) != 0) k++;
+    if (k >= 21) return 704;
+    return (uint16_t)((ms >> k) + 32 * k);
+}
+
+/** DF402, 4-bit lock time indicator, to the minimum lock time [ms] */
+inline uint32_t lockTimeMs(uint8_t indicator)
+{
+    return indicator == 0 ? 0 : (uint32_t)1 << (indicator + 4);
+}
+
+inline uint8_t lockTimeIndicator(uint32_t ms)
+{
+    uint8_t i = 0;
+    while (i < 15 && ms >= lockTimeMs((uint8_t)(i + 1))) i++;
+    return i;
+}
+
+/** Divide by 2^shift rounding to nearest, then clamp to a signed field of bits, keeping its invalid value free */
+inline int32_t scaleDown(int32_t v, unsigned shift, unsigned bits)
+{
+    const int32_t max = (1 << (bits - 1)) - 1;
+    int32_t r = (int32_t)(((int64_t)v + (1 << (shift - 1))) >> shift);
+    return r > max ? max : (r < -max ? -max : r);
+}
+
+/** DF408 (2^-4 dB-Hz) to DF403 (1 dB-Hz), a computed CNR stays non-zero */
+inline uint8_t cnrDbHz(uint16_t cnr)
+{
+    if (cnr == 0) return 0;
+    const unsigned v = (cnr + 8u) / 16u;
+    return (uint8_t)(v < 1 ? 1 : (v > 63 ? 63 : v));
+}
+
+/**
+ * Decode an MSM4, 5, 6 or 7 frame.
+ * @return false if it is not one, or the masks and length disagree
+ */
+inline bool decodeMsm(const uint8_t *frame, size_t len, Msm &msm)
+{
+    if (len < FRAME_OVERHEAD || !validHeader(frame) || payloadLength(frame) + FRAME_OVERHEAD > len) return false;
+    BitReader r(frame + HEADER_LENGTH, payloadLength(frame));
+    msm.number = (uint16_t)r.u(12);
+    if (!isMsm(msm.number) || msm.type() < 4) return false;
+    const bool extended = msm.type() >= 6;
+    const bool rates = msm.type() == 5 || msm.type() == 7;
+
+    msm.station_id = (uint16_t)r.u(12);
+    msm.epoch = r.u(30);
+    msm.multiple = r.u(1);
+    msm.iods = (uint8_t)r.u(3);
+    msm.reserved = (uint8_t)r.u(7);
+    msm.clock_steering = (uint8_t)r.u(2);
+    msm.external_clock = (uint8_t)r.u(2);
+    msm.smoothing = r.u(1);
+    msm.smoothing_interval = (uint8_t)r.u(3);
+    msm.satellite_mask = r.u64(64);
+    msm.signal_mask = r.u(32);
+    msm.num_satellites = (uint8_t)popcount64(msm.satellite_mask);
+    msm.num_signals = (uint8_t)popcount64(msm.signal_mask);
+    const unsigned cellBits = msm.num_satellites * msm.num_signals;
+    if (cellBits > MSM_MAX_CELLS) return false;
+    msm.cell_mask = r.u64(cellBits);
+    msm.num_cells = (uint8_t)popcount64(msm.cell_mask);
+
+    const unsigned ns = msm.num_satellites, nc = msm.num_cells;
+    for (unsigned i = 0; i < ns; i++) msm.satellites[i].rough_range_ms = (uint8_t)r.u(8);
+    for (unsigned i = 0; i < ns; i++) msm.satellites[i].info = rates ? (uint8_t)r.u(4) : 0;
+    for (unsigned i = 0; i < ns; i++) msm.satellites[i].rough_range_mod = (uint16_t)r.u(10);
+    for (unsigned i = 0; i < ns; i++) msm.satellites[i].rough_rate = rates ? (int16_t)r.s(14) : 0;
+
+    for (unsigned i = 0; i < nc; i++) {
+        MsmCell &c = msm.cells[i];
+        const int32_t v = r.s(extended ? 20 : 15);
+        c.pr_valid = v != -(1 << (extended ? 19 : 14));
+        c.fine_pr = extended ? v : v * 32;
+    }
+    for (unsigned i = 0; i < nc; i++) {
+        MsmCell &c = msm.cells[i];
+        const int32_t v = r.s(extended ? 24 : 22);
+        c.cp_valid = v != -(1 << (extended ? 23 : 21));
+        c.fine_cp = extended ? v : v * 4;
+    }
+    for (unsigned i = 0; i < nc; i++) {
+        msm.cells[i].lock_ms = extended ? lockTimeMsExtended((uint16_t)r.u(10)) : lockTimeMs((uint8_t)r.u(4));
+    }
+    for (unsigned i = 0; i < nc; i++) msm.cells[i].half_cycle = r.u(1);
+    for (unsigned i = 0; i < nc; i++) msm.cells[i].cnr = extended ? (uint16_t)r.u(10) : (uint16_t)(r.u(6) * 16);
+    for (unsigned i = 0; i < nc; i++) {
+        MsmCell &c = msm.cells[i];
+        c.fine_rate = rates ? (int16_t)r.s(15) : 0;
+        c.rate_valid = rates && c.fine_rate != -16384;
+    }
+    return !r.overrun();
+}
+
+/** Payload bits of msm encoded as MSM type */
+inline size_t msmPayloadBits(const Msm &msm, uint8_t type)
+{
+    const bool extended = type >= 6;
+    const bool rates = type == 5 || type == 7;
+    const size_t satBits = 18 + (rates ? 18 : 0);
+    const size_t cellBits = (extended ? 20 + 24 + 10 + 1 + 10 : 15 + 22 + 4 + 1 + 6) + (rates ? 15 : 0);
+    return MSM_HEADER_BITS + (size_t)msm.num_satellites * msm.num_signals
+        + msm.num_satellites * satBits + msm.num_cells * cellBits;
+}
+
+/**
+ * Encode msm as a complete MSM frame of type 4-7 (message number adjusted).
+ * @param out at least MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD bytes
+ * @return frame length, 0 if it does not fit a frame
+ */
+inline size_t encodeMsm(const Msm &msm, uint8_t type, uint8_t *out)
+{
+    if (type < 4 || type > 7) return 0;
+    const size_t payload = (msmPayloadBits(msm, type) + 7) / 8;
+    if (payload > MAX_PAYLOAD_LENGTH) return 0;
+    const bool extended = type >= 6;
+    const bool rates = type == 5 || type == 7;
+
+    out[0] = PREAMBLE;
+    out[1] = (uint8_t)(payload >> 8);
+    out[2] = (uint8_t)payload;
+    BitWriter w(out + HEADER_LENGTH, payload);
+    w.u(msm.number - msm.type() + type, 12);
+    w.u(msm.station_id, 12);
+    w.u(msm.epoch, 30);
+    w.u(msm.multiple, 1);
+    w.u(msm.iods, 3);
+    w.u(msm.reserved, 7);
+    w.u(msm.clock_steering, 2);
+    w.u(msm.external_clock, 2);
+    w.u(msm.smoothing, 1);
+    w.u(msm.smoothing_interval, 3);
+    w.u64(msm.satellite_mask, 64);
+    w.u(msm.signal_mask, 32);
+    w.u64(msm.cell_mask, msm.num_satellites * msm.num_signals);
+
+    const unsigned ns = msm.num_satellites, nc = msm.num_cells;
+    for (unsigned i = 0; i < ns; i++) w.u(msm.satellites[i].rough_range_ms, 8);
+    if (rates) for (unsigned i = 0; i < ns; i++) w.u(msm.satellites[i].info, 4);
+    for (unsigned i = 0; i < ns; i++) w.u(msm.satellites[i].rough_range_mod, 10);
+    if (rates) for (unsigned i = 0; i < ns; i++) w.s(msm.satellites[i].rough_rate, 14);
+
+    for (unsigned i = 0; i < nc; i++) {
+        const MsmCell &c = msm.cells[i];
+        if (extended) w.s(c.pr_valid ? c.fine_pr : -(1 << 19), 20);
+        else w.s(c.pr_valid ? scaleDown(c.fine_pr, 5, 15) : -(1 << 14), 15);
+    }
+    for (unsigned i = 0; i < nc; i++) {
+        const MsmCell &c = msm.cells[i];
+        if (extended) w.s(c.cp_valid ? c.fine_cp : -(1 << 23), 24);
+        else w.s(c.cp_valid ? scaleDown(c.fine_cp, 2, 22) : -(1 << 21), 22);
+    }
+    for (unsigned i = 0; i < nc; i++) {
+        if (extended) w.u(lockTimeIndicatorExtended(msm.cells[i].lock_ms), 10);
+        else w.u(lockTimeIndicator(msm.cells[i].lock_ms), 4);
+    }
+    for (unsigned i = 0; i < nc; i++) w.u(msm.cells[i].half_cycle, 1);
+    for (unsigned i = 0; i < nc; i++) {
+        if (extended) w.u(msm.cells[i].cnr, 10);
+        else w.u(cnrDbHz(msm.cells[i].cnr), 6);
+    }
+    if (rates) {
+        for (unsigned i = 0; i < nc; i++) w.s(msm.cells[i].rate_valid ? msm.cells[i].fine_rate : -16384, 15);
+    }
+    if (w.overrun()) return 0;
+
+    const uint32_t crc = crc24q(out, HEADER_LENGTH + payload);
+    out[HEADER_LENGTH + payload] = (uint8_t)(crc >> 16);
+    out[HEADER_LENGTH + payload + 1] = (uint8_t)(crc >> 8);
+    out[HEADER_LENGTH + payload + 2] = (uint8_t)crc;
+    return payload + FRAME_OVERHEAD;
+}
+
+} // namespace rtcm3
+} // namespace rtk_ros
+
+namespace rtk_ros {
+
+/** Re-encodes MSM7 frames as MSM4 on the way out, other frames pass through */
+class Msm4Downgrade
+{
+public:
+    struct Counters {
+        uint64_t frames = 0;        ///< MSM7 frames seen
+        uint64_t converted = 0;
+        uint64_t bytes_in = 0;      ///< of the converted frames
+        uint64_t bytes_out = 0;
+        uint64_t errors = 0;        ///< undecodable, passed through unchanged
+    };
+
+    /**
+     * @param len in: frame length, out: length of the frame returned
+     * @return frame itself, or the MSM4 frame, valid until the next call
+     */
+    const uint8_t *apply(const uint8_t *frame, size_t &len) {
+        if (len < rtcm3::FRAME_OVERHEAD + 2) return frame;
+        const uint16_t number = rtcm3::messageNumber(frame);
+        if (!rtcm3::isMsm(number) || number % 10 != 7) return frame;
+        ++count.frames;
+        size_t n = 0;
+        if (rtcm3::decodeMsm(frame, len, msm)) n = rtcm3::encodeMsm(msm, 4, buffer);
+        if (n == 0) {
+            ++count.errors;
+            return frame;
+        }
+        ++count.converted;
+        count.bytes_in += len;
+        count.bytes_out += n;
+        len = n;
+        return buffer;
+    }
+
+    const Counters &counters() const { return count; }
+
+private:
+    rtcm3::Msm msm;
+    uint8_t buffer[rtcm3::MAX_PAYLOAD_LENGTH + rtcm3::FRAME_OVERHEAD];
+    Counters count;
+};
+
+} // namespace rtk_ros
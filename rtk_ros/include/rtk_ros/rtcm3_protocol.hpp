@@ -0,0 +1,98 @@
+/**
+ * @file rtcm3_protocol.hpp
+ * RTCM 3 transport layer: preamble, frame length and CRC-24Q.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace rtk_ros {
+namespace rtcm3 {
+
+static const uint8_t PREAMBLE = 0xD3;
+static const size_t HEADER_LENGTH = 3;
+static const size_t CRC_LENGTH = 3;
+static const size_t FRAME_OVERHEAD = HEADER_LENGTH + CRC_LENGTH;
+static const uint16_t MAX_PAYLOAD_LENGTH = 1023;
+
+/** False if the 6 reserved bits after the preamble are set */
+inline bool validHeader(const uint8_t *frame)
+{
+    return frame[0] == PREAMBLE && (frame[1] & 0xFC) == 0;
+}
+
+inline uint16_t payloadLength(const uint8_t *frame)
+{
+    return (uint16_t)(((frame[1] & 0x03) << 8) | frame[2]);
+}
+
+/** 12-bit message number at the start of the payload */
+inline uint16_t messageNumber(const uint8_t *frame)
+{
+    return (uint16_t)((frame[3] << 4) | (frame[4] >> 4));
+}
+
+/** Multiple Signal Messages 1071-1137, MSM1 to MSM7 of each constellation */
+inline bool isMsm(uint16_t number)
+{
+    return number >= 1071 && number <= 1137 && number % 10 >= 1 && number % 10 <= 7;
+}
+
+/**
+ * Multiple message bit of an MSM frame, after the message number, station id
+ * and epoch time. 0 marks the last MSM of an epoch.
+ */
+inline bool msmMultipleMessage(const uint8_t *frame)
+{
+    return payloadLength(frame) >= 7 && ((frame[HEADER_LENGTH + 6] >> 1) & 1);
+}
+
+/** 30-bit epoch time of an MSM frame of at least 7 payload bytes, bits 24-53 of the payload */
+inline uint32_t msmEpochTime(const uint8_t *frame)
+{
+    const uint8_t *p = frame + HEADER_LENGTH;
+    return ((uint32_t)p[3] << 22) | ((uint32_t)p[4] << 14) | ((uint32_t)p[5] << 6) | (p[6] >> 2);
+}
+
+class Crc24qTable
+{
+public:
+    Crc24qTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i << 16;
+            for (int bit = 0; bit < 8; bit++) {
+                crc <<= 1;
+                if (crc & 0x1000000) crc ^= 0x1864CFB;
+            }
+            table[i] = crc & 0xFFFFFF;
+        }
+    }
+
+    uint32_t operator[](uint8_t i) const { return table[i]; }
+
+private:
+    uint32_t table[256];
+};
+
+/** CRC-24Q over len bytes, continuing from crc */
+inline uint32_t crc24q(const uint8_t *data, size_t len, uint32_t crc = 0)
+{
+    static const Crc24qTable table;
+    for (size_t i = 0; i < len; i++) {
+        crc = ((crc << 8) & 0xFFFFFF) ^ table[(uint8_t)(crc >> 16) ^ data[i]];
+    }
+    return crc;
+}
+
+/** Check the CRC of a complete frame of payloadLength(frame) + FRAME_OVERHEAD bytes */
+inline bool checkCrc(const uint8_t *frame)
+{
+    const size_t len = HEADER_LENGTH + payloadLength(frame);
+    const uint32_t crc = ((uint32_t)frame[len] << 16) | ((uint32_t)frame[len + 1] << 8) | frame[len + 2];
+    return crc24q(frame, len) == crc;
+}
+
+} // namespace rtcm3
+} // namespace rtk_ros
@@ -0,0 +1,226 @@
+/**
+ * @file rtcm_monitor.hpp
+ * Content of the RTCM stream the base sends, summarized per epoch.
+ *
+ * Station (1005/1006), MSM4-7 observation and GLONASS bias (1230) messages are
+ * decoded with the fixed-size decoder of rtcm3_msm.hpp, without allocating.
+ * An epoch ends at its last MSM (multiple message bit 0), or when an MSM of a
+ * constellation already seen arrives that does not continue it: another epoch
+ * time, or a previous part with the multiple message bit 0. The parts of an
+ * epoch split over several MSM of a constellation add up. The summary gives per
+ * constellation the
+ * satellites, signals and cells, their CNR and the cells whose lock time went
+ * back since the previous epoch (cycle slip or loss of lock at the base).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "rtcm3_msm.hpp"
+
+namespace rtk_ros {
+
+/** MSM series 107x-113x as UBX gnssId, as in the Satellites message */
+static const size_t RTCM_CONSTELLATIONS = 7;
+static const uint8_t RTCM_GNSS_ID[RTCM_CONSTELLATIONS] = {0, 6, 2, 1, 5, 3, 7};
+
+struct RtcmConstellationSummary {
+    bool present = false;
+    uint8_t msm_type = 0;
+    uint8_t num_satellites = 0;
+    uint8_t num_signals = 0;
+    uint16_t num_cells = 0;
+    uint16_t lock_resets = 0;
+    float cno_mean = 0.f;       ///< [dBHz], over the cells with a CNR
+    float cno_min = 0.f;
+};
+
+struct RtcmEpochSummary {
+    uint16_t station_id = 0;
+    uint32_t epoch_time = 0;    ///< epoch field of the last MSM
+    uint16_t frames = 0;
+    uint16_t bytes = 0;
+    RtcmConstellationSummary constellations[RTCM_CONSTELLATIONS];
+
+    bool station_position = false;
+    double arp_ecef[3] = {0.0, 0.0, 0.0};   ///< [m]
+    float antenna_height = 0.f;             ///< [m], 1006 only
+    double station_time = 0.0;              ///< arrival of the last 1005/1006 [s]
+
+    bool glonass_biases = false;
+    uint8_t glonass_bias_mask = 0;          ///< L1 C/A, L1 P, L2 C/A, L2 P from bit 3
+    double glonass_bias_time = 0.0;
+};
+
+class RtcmMonitor
+{
+public:
+    struct Counters {
+        uint64_t frames = 0;
+        uint64_t epochs = 0;
+        uint64_t undecodable = 0;   ///< known message numbers that did not decode
+    };
+
+    RtcmMonitor() { memset(lockMs, 0, sizeof(lockMs)); }
+
+    /**
+     * Decode a complete frame received at now [s].
+     * @return true when it completes an epoch, see summary()
+     */
+    bool onFrame(const uint8_t *frame, size_t len, double now) {
+        if (len < rtcm3::FRAME_OVERHEAD + 2) return false;
+        ++count.frames;
+        const uint16_t number = rtcm3::messageNumber(frame);
+
+        if (number == 1005 || number == 1006) {
+            if (!decodeStation(frame, number == 1006, now)) ++count.undecodable;
+        } else if (number == 1230) {
+            if (!decodeGlonassBiases(frame, now)) ++count.undecodable;
+        } else if (rtcm3::isMsm(number) && number % 10 >= 4) {
+            const size_t c = number / 10 - 107;
+            if (!rtcm3::decodeMsm(frame, len, msm)) {
+                ++count.undecodable;
+            } else {
+                const Part &part = parts[c];
+                if (current.constellations[c].present && (msm.epoch != part.epoch || !part.multiple)) finishEpoch();
+                addMsm(c);
+                accountFrame(len);
+                if (!msm.multiple) {
+                    finishEpoch();
+                    return true;
+                }
+                return false;
+            }
+        }
+        accountFrame(len);
+        return false;
+    }
+
+    /** The last completed epoch */
+    const RtcmEpochSummary &summary() const { return last; }
+    const Counters &counters() const { return count; }
+
+private:
+    void accountFrame(size_t len) {
+        ++current.frames;
+        current.bytes = (uint16_t)(current.bytes + len);
+    }
+
+    bool decodeStation(const uint8_t *frame, bool height, double now) {
+        rtcm3::BitReader r(frame + rtcm3::HEADER_LENGTH, rtcm3::payloadLength(frame));
+        r.skip(12);
+        const uint16_t id = (uint16_t)r.u(12);
+        r.skip(6 + 4);
+        const int64_t x = r.s64(38);
+        r.skip(2);
+        const int64_t y = r.s64(38);
+        r.skip(2);
+        const int64_t z = r.s64(38);
+        const uint32_t h = height ? r.u(16) : 0;
+        if (r.overrun()) return false;
+        stationId = id;
+        station.arp_ecef[0] = x * 1e-4;
+        station.arp_ecef[1] = y * 1e-4;
+        station.arp_ecef[2] = z * 1e-4;
+        station.antenna_height = (float)(h * 1e-4);
+        station.station_time = now;
+        station.station_position = true;
+        return true;
+    }
+
+    bool decodeGlonassBiases(const uint8_t *frame, double now) {
+        rtcm3::BitReader r(frame + rtcm3::HEADER_LENGTH, rtcm3::payloadLength(frame));
+        r.skip(12 + 12 + 1 + 3);
+        const uint8_t mask = (uint8_t)r.u(4);
+        r.skip(16 * rtcm3::popcount64(mask));
+        if (r.overrun()) return false;
+        station.glonass_bias_mask = mask;
+        station.glonass_bias_time = now;
+        station.glonass_biases = true;
+        return true;
+    }
+
+    void addMsm(size_t c) {
+        RtcmConstellationSummary &s = current.constellations[c];
+        Part &part = parts[c];
+        s.present = true;
+        s.msm_type = msm.type();
+        part.epoch = msm.epoch;
+        part.multiple = msm.multiple;
+        part.satellite_mask |= msm.satellite_mask;
+        part.signal_mask |= msm.signal_mask;
+        s.num_satellites = (uint8_t)rtcm3::popcount64(part.satellite_mask);
+        s.num_signals = (uint8_t)rtcm3::popcount64(part.signal_mask);
+        s.num_cells = (uint16_t)(s.num_cells + msm.num_cells);
+        current.station_id = msm.station_id;
+        current.epoch_time = msm.epoch;
+
+        // Cells in satellite-major order, satellite and signal ids from the masks
+        uint8_t satIds[rtcm3::MSM_MAX_SATELLITES], sigIds[rtcm3::MSM_MAX_SIGNALS];
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < 64; i++) if (msm.satellite_mask >> (63 - i) & 1) satIds[n++] = i;
+        n = 0;
+        for (uint8_t i = 0; i < 32; i++) if (msm.signal_mask >> (31 - i) & 1) sigIds[n++] = i;
+
+        const unsigned cellBits = msm.num_satellites * msm.num_signals;
+        unsigned cell = 0;
+        for (unsigned bit = 0; bit < cellBits; bit++) {
+            if (!(msm.cell_mask >> (cellBits - 1 - bit) & 1)) continue;
+            const rtcm3::MsmCell &m = msm.cells[cell++];
+            uint32_t &previous = lockMs[c][satIds[bit / msm.num_signals]][sigIds[bit % msm.num_signals]];
+            if (m.lock_ms < previous) s.lock_resets++;
+            previous = m.lock_ms;
+            if (m.cnr > 0) {
+                const float cno = m.cnr / 16.f;
+                part.cno_sum += cno;
+                if (part.cno_count == 0 || cno < s.cno_min) s.cno_min = cno;
+                part.cno_count++;
+            }
+        }
+        s.cno_mean = part.cno_count > 0 ? part.cno_sum / part.cno_count : 0.f;
+    }
+
+    void finishEpoch() {
+        bool any = false;
+        for (size_t c = 0; c < RTCM_CONSTELLATIONS; c++) any |= current.constellations[c].present;
+        if (!any) return;
+        last = current;
+        last.station_position = station.station_position;
+        memcpy(last.arp_ecef, station.arp_ecef, sizeof(last.arp_ecef));
+        last.antenna_height = station.antenna_height;
+        last.station_time = station.station_time;
+        last.glonass_biases = station.glonass_biases;
+        last.glonass_bias_mask = station.glonass_bias_mask;
+        last.glonass_bias_time = station.glonass_bias_time;
+        if (station.station_position && stationId != last.station_id) last.station_position = false;
+        current = RtcmEpochSummary();
+        for (Part &part : parts) part = Part();
+        ++count.epochs;
+    }
+
+    /** MSM of a constellation in the current epoch so far */
+    struct Part {
+        uint32_t epoch = 0;
+        bool multiple = false;      ///< of the last one
+        uint64_t satellite_mask = 0;
+        uint32_t signal_mask = 0;
+        float cno_sum = 0.f;
+        unsigned cno_count = 0;
+    };
+
+    rtcm3::Msm msm;
+    RtcmEpochSummary current;
+    Part parts[RTCM_CONSTELLATIONS];
+    RtcmEpochSummary last;
+    /** Station and bias messages, kept across epochs */
+    RtcmEpochSummary station;
+    uint16_t stationId = 0;
+    /** Previous lock time per constellation, satellite and signal [ms] */
+    uint32_t lockMs[RTCM_CONSTELLATIONS][rtcm3::MSM_MAX_SATELLITES][rtcm3::MSM_MAX_SIGNALS];
+    Counters count;
+};
+
+} // namespace rtk_ros
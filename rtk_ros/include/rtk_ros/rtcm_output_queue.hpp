@@ -0,0 +1,260 @@
+/**
+ * @file rtcm_output_queue.hpp
+ * RTCM output queue in front of a link that can push back.
+ *
+ * Messages (one or more RTCM frames) are queued per epoch, an epoch ending at
+ * a message whose last frame is an MSM without the multiple message bit. When
+ * the sink cannot take a message (send() returns false), the policy decides
+ * what gives way:
+ *
+ *   drop_oldest       the oldest message is dropped when the queue is full
+ *   drop_stale_epoch  once a newer epoch is complete, older epochs not being
+ *                     sent are dropped whole, the link only ever carries
+ *                     complete epochs and catches up to the latest one
+ *   block             drain() waits for the sink (wait(timeout)) until the
+ *                     deadline of the message, then drops it
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+#include "mavlink_rtcm.hpp"
+#include "rtcm3_protocol.hpp"
+
+namespace rtk_ros {
+
+enum class OutputPolicy : uint8_t {
+    DropOldest = 0,
+    DropStaleEpoch,
+    Block
+};
+
+inline const char *outputPolicyName(OutputPolicy policy)
+{
+    switch (policy) {
+        case OutputPolicy::DropOldest: return "drop_oldest";
+        case OutputPolicy::DropStaleEpoch: return "drop_stale_epoch";
+        case OutputPolicy::Block: return "block";
+    }
+    return "";
+}
+
+/** @return false if name is not a policy, policy is unchanged then */
+inline bool outputPolicyFromName(const std::string &name, OutputPolicy &policy)
+{
+    for (OutputPolicy p : {OutputPolicy::DropOldest, OutputPolicy::DropStaleEpoch, OutputPolicy::Block}) {
+        if (name == outputPolicyName(p)) {
+            policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Whether the last frame of a message closes its epoch */
+inline bool endsEpoch(const uint8_t *data, size_t len)
+{
+    const uint8_t *last = nullptr;
+    size_t offset = 0;
+    while (offset + rtcm3::FRAME_OVERHEAD <= len && rtcm3::validHeader(data + offset)) {
+        last = data + offset;
+        offset += rtcm3::payloadLength(last) + rtcm3::FRAME_OVERHEAD;
+    }
+    return last && rtcm3::payloadLength(last) >= 7 && rtcm3::isMsm(rtcm3::messageNumber(last))
+        && !rtcm3::msmMultipleMessage(last);
+}
+
+class RtcmOutputQueue
+{
+public:
+    static const size_t CAPACITY = 64;
+    static const size_t MAX_MESSAGE_LENGTH = mavlink::RTCM_MAX_MESSAGE_LENGTH;
+
+    struct Counters {
+        uint64_t messages = 0;          ///< queued
+        uint64_t sent = 0;
+        uint64_t sent_bytes = 0;
+        uint64_t too_long = 0;          ///< over MAX_MESSAGE_LENGTH, dropped
+        uint64_t dropped_oldest = 0;    ///< dropped from a full queue
+        uint64_t stale_epochs = 0;      ///< epochs dropped for a newer complete one
+        uint64_t stale_messages = 0;    ///< messages of those epochs
+        uint64_t expired = 0;           ///< dropped at their deadline
+        uint64_t blocked = 0;           ///< times the sink could not take a message
+        size_t max_depth = 0;
+
+        uint64_t dropped() const { return too_long + dropped_oldest + stale_messages + expired; }
+    };
+
+    /**
+     * @param _deadline longest a message waits for the sink under Block, and
+     * longest an epoch stays open without its last MSM [s]
+     */
+    void configure(OutputPolicy _policy, double _deadline) {
+        policy = _policy;
+        deadline = _deadline > 0.0 ? _deadline : 0.0;
+    }
+
+    OutputPolicy outputPolicy() const { return policy; }
+
+    /** Queue a message received at now [s] */
+    void push(const uint8_t *data, size_t len, double now) {
+        if (len == 0) return;
+        if (len > MAX_MESSAGE_LENGTH) {
+            ++count.too_long;
+            return;
+        }
+        ++count.messages;
+
+        // Epochs of frames without MSM (legacy observations, ARP alone) end on timeout
+        if (epochOpen && now - epochStart > deadline) closeEpoch();
+        if (!epochOpen) {
+            epochOpen = true;
+            epochStart = now;
+        }
+
+        if (size == CAPACITY) {
+            if (policy == OutputPolicy::DropStaleEpoch && at(0).epoch != epoch && !headStarted()) {
+                dropEpoch(at(0).epoch);
+            } else {
+                pop();
+                ++count.dropped_oldest;
+            }
+        }
+        Item &item = at(size++);
+        memcpy(item.data, data, len);
+        item.len = (uint16_t)len;
+        item.epoch = epoch;
+        item.arrival = now;
+        if (size > count.max_depth) count.max_depth = size;
+
+        if (endsEpoch(data, len)) closeEpoch();
+    }
+
+    /**
+     * Send the queue to sink: bool send(data, len), false if it would block, and
+     * for Block bool wait(timeout [s]), false if the sink is still not ready.
+     */
+    template <typename Sink>
+    void drain(double now, Sink &sink) {
+        if (policy == OutputPolicy::DropStaleEpoch) dropStaleEpochs();
+
+        while (size > 0) {
+            Item &item = at(0);
+            if (sink.send(item.data, item.len)) {
+                sent(item);
+                continue;
+            }
+            ++count.blocked;
+            if (policy != OutputPolicy::Block) break;
+
+            const double remaining = item.arrival + deadline - now;
+            if (remaining > 0.0 && sink.wait(remaining)) {
+                // Ready again: retry once, a sink that keeps refusing is left for the next drain
+                if (sink.send(item.data, item.len)) {
+                    sent(item);
+                    continue;
+                }
+                ++count.blocked;
+                break;
+            }
+            // The whole wait was spent
+            if (remaining > 0.0) now = item.arrival + deadline;
+            ++count.expired;
+            pop();
+        }
+    }
+
+    size_t depth() const { return size; }
+    const Counters &counters() const { return count; }
+
+private:
+    struct Item {
+        uint8_t data[MAX_MESSAGE_LENGTH];
+        uint16_t len = 0;
+        uint32_t epoch = 0;
+        double arrival = 0.0;
+    };
+
+    Item &at(size_t i) { return items[(head + i) % CAPACITY]; }
+
+    static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+    void pop() {
+        head = (head + 1) % CAPACITY;
+        --size;
+    }
+
+    void sent(const Item &item) {
+        ++count.sent;
+        count.sent_bytes += item.len;
+        sending = true;
+        sendingEpoch = item.epoch;
+        pop();
+    }
+
+    /** Part of the head epoch already went to the sink */
+    bool headStarted() { return sending && size > 0 && at(0).epoch == sendingEpoch; }
+
+    void closeEpoch() {
+        if (!epochOpen) return;
+        lastComplete = epoch;
+        haveComplete = true;
+        ++epoch;
+        epochOpen = false;
+        if (policy == OutputPolicy::DropStaleEpoch) dropStaleEpochs();
+    }
+
+    /** Drop the queued epochs before the latest complete one, a partly sent epoch is finished first */
+    void dropStaleEpochs() {
+        if (!haveComplete) return;
+        size_t keep = 0;
+        if (headStarted()) {
+            while (keep < size && at(keep).epoch == sendingEpoch) keep++;
+        }
+        size_t out = keep;
+        bool dropped = false;
+        uint32_t droppedEpoch = 0;
+        for (size_t i = keep; i < size; i++) {
+            Item &item = at(i);
+            if (before(item.epoch, lastComplete)) {
+                ++count.stale_messages;
+                if (!dropped || item.epoch != droppedEpoch) ++count.stale_epochs;
+                dropped = true;
+                droppedEpoch = item.epoch;
+                continue;
+            }
+            if (out != i) at(out) = item;
+            out++;
+        }
+        size = out;
+    }
+
+    /** Drop the epoch e at the head */
+    void dropEpoch(uint32_t e) {
+        ++count.stale_epochs;
+        while (size > 0 && at(0).epoch == e) {
+            pop();
+            ++count.stale_messages;
+        }
+    }
+
+    Item items[CAPACITY];
+    size_t head = 0;
+    size_t size = 0;
+    bool sending = false;
+    uint32_t sendingEpoch = 0;    ///< epoch of the last message sent
+    uint32_t epoch = 0;           ///< epoch being queued
+    bool epochOpen = false;
+    double epochStart = 0.0;
+    uint32_t lastComplete = 0;
+    bool haveComplete = false;
+    OutputPolicy policy = OutputPolicy::DropStaleEpoch;
+    double deadline = 0.5;
+    Counters count;
+};
+
+} // namespace rtk_ros
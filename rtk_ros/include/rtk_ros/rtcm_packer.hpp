@@ -0,0 +1,125 @@
+/**
+ * @file rtcm_packer.hpp
+ * Packing of the RTCM frames of an epoch into GPS_RTCM_DATA messages.
+ *
+ * Sent one per message, a 25-byte 1230 frame takes a 180-byte fragment and a
+ * MAVLink packet of its own. The packer holds the frames of an epoch until its
+ * last MSM (multiple message bit 0) and splits that ordered sequence into
+ * messages of up to 4 fragments, with the fewest fragments and then the fewest
+ * messages. Frames keep their order and are never split across messages, so a
+ * lost packet only costs the frames of its message.
+ *
+ * Multi-frame messages of exactly 360 or 540 bytes are avoided: a receiver
+ * reassembling fragments only knows a message is complete at a short or at
+ * the fourth fragment.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "mavlink_rtcm.hpp"
+#include "rtcm3_protocol.hpp"
+
+namespace rtk_ros {
+
+class RtcmPacker
+{
+public:
+    static const size_t MAX_FRAMES = 64;
+    static const size_t CAPACITY = 8 * mavlink::RTCM_MAX_MESSAGE_LENGTH;
+
+    struct Counters {
+        uint64_t frames = 0;
+        uint64_t epochs = 0;      ///< flushes, at the end of an epoch or on timeout
+        uint64_t messages = 0;
+        uint64_t too_long = 0;    ///< frames over 4 fragments, dropped
+    };
+
+    /**
+     * Queue a frame, the epoch is sent to sink (send(data, len)) after its last MSM.
+     * @param now time of arrival [s]
+     */
+    template <typename Sink>
+    void add(const uint8_t *frame, size_t len, double now, Sink &sink) {
+        if (len > mavlink::RTCM_MAX_MESSAGE_LENGTH) {
+            ++count.too_long;
+            return;
+        }
+        if (frames == MAX_FRAMES || offsets[frames] + len > CAPACITY) flush(sink);
+        if (frames == 0) firstArrival = now;
+        memcpy(buffer + offsets[frames], frame, len);
+        offsets[frames + 1] = (uint16_t)(offsets[frames] + len);
+        ++frames;
+        ++count.frames;
+
+        if (len >= rtcm3::FRAME_OVERHEAD + 7 && rtcm3::isMsm(rtcm3::messageNumber(frame)) && !rtcm3::msmMultipleMessage(frame)) {
+            flush(sink);
+        }
+    }
+
+    /** Send the frames queued for more than delay [s], for epochs without MSM */
+    template <typename Sink>
+    void flushOlderThan(double now, double delay, Sink &sink) {
+        if (frames > 0 && now - firstArrival >= delay) flush(sink);
+    }
+
+    template <typename Sink>
+    void flush(Sink &sink) {
+        if (frames == 0) return;
+
+        // cost[i]: fragments << 8 | messages to send frames [0, i), from[i] first frame of the last message
+        uint32_t cost[MAX_FRAMES + 1];
+        uint8_t from[MAX_FRAMES + 1];
+        cost[0] = 0;
+        for (size_t i = 1; i <= frames; i++) {
+            cost[i] = UINT32_MAX;
+            for (size_t j = i; j-- > 0;) {
+                const size_t bytes = offsets[i] - offsets[j];
+                if (bytes > mavlink::RTCM_MAX_MESSAGE_LENGTH) break;
+                if (j + 1 < i && stallsReassembly(bytes)) continue;
+                const uint32_t c = cost[j] + (fragments(bytes) << 8) + 1;
+                if (c < cost[i]) {
+                    cost[i] = c;
+                    from[i] = (uint8_t)j;
+                }
+            }
+        }
+
+        uint8_t starts[MAX_FRAMES];
+        size_t messages = 0;
+        for (size_t i = frames; i > 0; i = from[i]) {
+            starts[messages++] = from[i];
+        }
+        for (size_t m = messages; m-- > 0;) {
+            // starts[] runs backwards, starts[m] begins the next message and starts[m - 1] the one after
+            const size_t end = m > 0 ? starts[m - 1] : frames;
+            sink.send(buffer + offsets[starts[m]], offsets[end] - offsets[starts[m]]);
+        }
+        count.messages += messages;
+        ++count.epochs;
+        frames = 0;
+    }
+
+    size_t pendingFrames() const { return frames; }
+    const Counters &counters() const { return count; }
+
+private:
+    static uint32_t fragments(size_t bytes) {
+        return (uint32_t)((bytes + mavlink::RTCM_FRAGMENT_LENGTH - 1) / mavlink::RTCM_FRAGMENT_LENGTH);
+    }
+
+    static bool stallsReassembly(size_t bytes) {
+        return bytes == 2 * mavlink::RTCM_FRAGMENT_LENGTH || bytes == 3 * mavlink::RTCM_FRAGMENT_LENGTH;
+    }
+
+    uint8_t buffer[CAPACITY];
+    uint16_t offsets[MAX_FRAMES + 1] = {0};
+    size_t frames = 0;
+    double firstArrival = 0.0;
+    Counters count;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,268 @@
+/**
+ * @file rtcm_scheduler.hpp
+ * RTCM output scheduling within the bandwidth of a telemetry link.
+ *
+ * Frames are classified by message type (antenna position, MSM per
+ * constellation, GLONASS biases) and queued. service() sends them highest
+ * priority first, oldest first within a class, as long as a token bucket
+ * refilled at the budget allows it. Frames are charged the cost given to
+ * add(), their size on the link including its framing. The bucket holds one
+ * second of budget, and a frame costing more is sent once the bucket is full:
+ * over any interval T at most budget * T + max(budget * 1 s, largest cost)
+ * bytes are sent. A frame that doesn't fit defers all lower priorities.
+ * Frames are shed instead of arriving late when they exceed the
+ * maximum age, when a newer frame of the same message number is queued (for
+ * MSM, of a later epoch: the parts of an MSM split with the multiple message
+ * bit share their number and epoch), or when the queue is full (lowest
+ * priority, oldest first).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+
+#include "rtcm3_protocol.hpp"
+
+namespace rtk_ros {
+
+/** Message classes, declared in their default priority order */
+enum RtcmClass : uint8_t {
+    RTCM_CLASS_ARP = 0,          ///< 1005-1008, 1033: station position and antenna
+    RTCM_CLASS_GPS,              ///< MSM 107x, 1001-1004
+    RTCM_CLASS_GALILEO,          ///< MSM 109x
+    RTCM_CLASS_BEIDOU,           ///< MSM 112x
+    RTCM_CLASS_GLONASS,          ///< MSM 108x, 1009-1012
+    RTCM_CLASS_GLONASS_BIAS,     ///< 1230: GLONASS code-phase biases
+    RTCM_CLASS_QZSS,             ///< MSM 111x
+    RTCM_CLASS_SBAS,             ///< MSM 110x
+    RTCM_CLASS_OTHER,
+    RTCM_CLASS_COUNT
+};
+
+inline RtcmClass rtcmClass(uint16_t number)
+{
+    if ((number >= 1005 && number <= 1008) || number == 1033) return RTCM_CLASS_ARP;
+    if (number == 1230) return RTCM_CLASS_GLONASS_BIAS;
+    if (number >= 1001 && number <= 1004) return RTCM_CLASS_GPS;
+    if (number >= 1009 && number <= 1012) return RTCM_CLASS_GLONASS;
+    if (!rtcm3::isMsm(number)) return RTCM_CLASS_OTHER;
+    switch (number / 10) {
+        case 107: return RTCM_CLASS_GPS;
+        case 108: return RTCM_CLASS_GLONASS;
+        case 109: return RTCM_CLASS_GALILEO;
+        case 110: return RTCM_CLASS_SBAS;
+        case 111: return RTCM_CLASS_QZSS;
+        case 112: return RTCM_CLASS_BEIDOU;
+        default: return RTCM_CLASS_OTHER;
+    }
+}
+
+inline const char *rtcmClassName(uint8_t c)
+{
+    static const char *const names[RTCM_CLASS_COUNT] = {
+        "arp", "gps", "galileo", "beidou", "glonass", "glonass_bias", "qzss", "sbas", "other"
+    };
+    return c < RTCM_CLASS_COUNT ? names[c] : "";
+}
+
+class RtcmScheduler
+{
+public:
+    static const size_t CAPACITY = 64;
+    static const size_t MAX_FRAME_LENGTH = rtcm3::MAX_PAYLOAD_LENGTH + rtcm3::FRAME_OVERHEAD;
+
+    struct ClassCounters {
+        uint64_t frames = 0;        ///< queued
+        uint64_t sent = 0;
+        uint64_t sent_bytes = 0;   ///< charged against the budget
+        uint64_t stale = 0;         ///< dropped over the maximum age
+        uint64_t superseded = 0;    ///< dropped for a newer frame of the same message
+        uint64_t overflow = 0;      ///< dropped from a full queue
+        double max_delay = 0.0;     ///< longest queueing of a sent frame [s]
+
+        uint64_t shed() const { return stale + superseded + overflow; }
+    };
+
+    RtcmScheduler() {
+        for (uint8_t c = 0; c < RTCM_CLASS_COUNT; c++) rank[c] = c;
+    }
+
+    /**
+     * @param budget link budget [bytes/s], 0 disables scheduling
+     * @param _maxAge age after which a queued frame is dropped [s]
+     */
+    void configure(double budget, double _maxAge) {
+        rate = budget > 0.0 ? budget : 0.0;
+        maxAge = _maxAge;
+        // One second of burst, larger frames wait for a full bucket
+        burst = rate;
+        tokens = burst;
+    }
+
+    bool enabled() const { return rate > 0.0; }
+
+    /**
+     * Priority order, highest first, as class names separated by spaces or commas.
+     * Classes not listed keep their default order after the listed ones.
+     * @return false if a name is unknown, the order is unchanged then
+     */
+    bool setPriorities(const std::string &order) {
+        uint8_t newRank[RTCM_CLASS_COUNT];
+        bool listed[RTCM_CLASS_COUNT] = {false};
+        uint8_t next = 0;
+        std::string list(order);
+        for (char &ch : list) if (ch == ',') ch = ' ';
+        std::istringstream names(list);
+        std::string name;
+        while (names >> name) {
+            uint8_t c = 0;
+            while (c < RTCM_CLASS_COUNT && name != rtcmClassName(c)) c++;
+            if (c == RTCM_CLASS_COUNT) return false;
+            if (listed[c]) continue;
+            listed[c] = true;
+            newRank[c] = next++;
+        }
+        for (uint8_t c = 0; c < RTCM_CLASS_COUNT; c++) {
+            if (!listed[c]) newRank[c] = next++;
+        }
+        memcpy(rank, newRank, sizeof(rank));
+        return true;
+    }
+
+    /**
+     * Queue a complete frame received at now [s].
+     * @param cost bytes it takes on the link, charged against the budget when it is sent, 0 for len
+     */
+    void add(const uint8_t *frame, size_t len, double now, size_t cost = 0) {
+        if (len > MAX_FRAME_LENGTH || len < rtcm3::FRAME_OVERHEAD + 2) return;
+        const uint16_t number = rtcm3::messageNumber(frame);
+        const RtcmClass c = rtcmClass(number);
+        const bool msm = rtcm3::isMsm(number) && rtcm3::payloadLength(frame) >= 7;
+        const uint32_t epoch = msm ? rtcm3::msmEpochTime(frame) : 0;
+        ++count[c].frames;
+
+        for (size_t i = 0; i < CAPACITY; i++) {
+            Slot &s = slots[i];
+            if (!s.used || s.number != number) continue;
+            // An earlier part of the same epoch is not superseded, the epoch would go out incomplete
+            if (msm && s.multiple && s.epoch == epoch) continue;
+            s.used = false;
+            ++count[c].superseded;
+        }
+
+        Slot *slot = nullptr;
+        for (size_t i = 0; i < CAPACITY && !slot; i++) {
+            if (!slots[i].used) slot = &slots[i];
+        }
+        if (!slot) {
+            // Full: shed the lowest priority, oldest frame unless the new one ranks below all
+            Slot *victim = select(false);
+            if (rank[c] > rank[victim->cls]) {
+                ++count[c].overflow;
+                return;
+            }
+            ++count[victim->cls].overflow;
+            slot = victim;
+        }
+        memcpy(slot->data, frame, len);
+        slot->len = (uint16_t)len;
+        slot->cost = cost > 0 ? (uint32_t)cost : (uint32_t)len;
+        slot->number = number;
+        slot->cls = c;
+        slot->epoch = epoch;
+        slot->multiple = msm && rtcm3::msmMultipleMessage(frame);
+        slot->arrival = now;
+        slot->order = nextOrder++;
+        slot->used = true;
+    }
+
+    /** Send what the budget allows to sink (send(data, len)) */
+    template <typename Sink>
+    void service(double now, Sink &sink) {
+        if (lastRefill > 0.0 && now > lastRefill) {
+            tokens += (now - lastRefill) * rate;
+            if (tokens > burst) tokens = burst;
+        }
+        lastRefill = now;
+
+        for (size_t i = 0; i < CAPACITY; i++) {
+            if (slots[i].used && now - slots[i].arrival > maxAge) {
+                ++count[slots[i].cls].stale;
+                slots[i].used = false;
+            }
+        }
+
+        while (Slot *slot = select(true)) {
+            const double age = now - slot->arrival;
+            if (tokens < slot->cost && tokens < burst) break;
+            tokens -= slot->cost;
+            ClassCounters &cc = count[slot->cls];
+            ++cc.sent;
+            cc.sent_bytes += slot->cost;
+            if (age > cc.max_delay) cc.max_delay = age;
+            slot->used = false;
+            sink.send(slot->data, slot->len);
+        }
+    }
+
+    const ClassCounters &counters(uint8_t c) const { return count[c]; }
+
+    uint64_t shed() const {
+        uint64_t n = 0;
+        for (uint8_t c = 0; c < RTCM_CLASS_COUNT; c++) n += count[c].shed();
+        return n;
+    }
+
+    size_t queued() const {
+        size_t n = 0;
+        for (size_t i = 0; i < CAPACITY; i++) n += slots[i].used;
+        return n;
+    }
+
+private:
+    struct Slot {
+        uint8_t data[MAX_FRAME_LENGTH];
+        uint16_t len = 0;
+        uint32_t cost = 0;          ///< [bytes] charged against the budget
+        uint16_t number = 0;
+        RtcmClass cls = RTCM_CLASS_OTHER;
+        uint32_t epoch = 0;         ///< MSM epoch time
+        bool multiple = false;      ///< MSM with more messages of its epoch to follow
+        double arrival = 0.0;
+        uint64_t order = 0;         ///< arrival order, the parts of an epoch may share an arrival time
+        bool used = false;
+    };
+
+    /** Highest priority (or lowest if !highest) queued frame, oldest first within a class */
+    Slot *select(bool highest) {
+        Slot *best = nullptr;
+        for (size_t i = 0; i < CAPACITY; i++) {
+            Slot &s = slots[i];
+            if (!s.used) continue;
+            if (!best) {
+                best = &s;
+                continue;
+            }
+            const int r = rank[s.cls], rb = rank[best->cls];
+            if (highest ? r < rb : r > rb) best = &s;
+            else if (r == rb && s.order < best->order) best = &s;
+        }
+        return best;
+    }
+
+    Slot slots[CAPACITY];
+    uint8_t rank[RTCM_CLASS_COUNT];
+    ClassCounters count[RTCM_CLASS_COUNT];
+    double rate = 0.0;
+    double burst = 0.0;
+    double tokens = 0.0;
+    double maxAge = 1.0;
+    double lastRefill = 0.0;
+    uint64_t nextOrder = 0;
+};
+
+} // namespace rtk_ros
@@ -6,19 +6,49 @@
 
 #pragma once
 
+#include <errno.h>
+#include <string.h>
 #include <sstream>
 #include <string>
 #include <iostream>
 
 #include <ros/ros.h>
 
-#include <serial/serial.h>
 #include <mavros_msgs/RTCM.h>
 #include <sensor_msgs/NavSatFix.h>
-#include <rtk_ros/GpsDrivers/src/ubx.h>
-#include <rtk_ros/GpsDrivers/src/ashtech.h>
 #include <rtk_ros/GpsDrivers/src/gps_helper.h>
+#include <rtk_ros/Satellites.h>
+#include <rtk_ros/SatelliteStatistics.h>
+#include <rtk_ros/Dop.h>
+#include <rtk_ros/InterferenceStatus.h>
+#include <rtk_ros/SurveyStatus.h>
+#include <rtk_ros/RawObservations.h>
+#include <rtk_ros/RtcmQuality.h>
 #include "definitions.h"
+#include "satellite_table.hpp"
+#include "signal_statistics.hpp"
+#include "sky_geometry.hpp"
+#include "interference_monitor.hpp"
+#include "survey_status.hpp"
+#include "base_estimator.hpp"
+#include "fixed_position.hpp"
+#include "raw_observations.hpp"
+#include "raw_logger.hpp"
+#include "stream_demux.hpp"
+#include "ubx_dispatch.hpp"
+#include "receiver_config.hpp"
+#include "transport.hpp"
+#include "driver_adapter.hpp"
+#include "protocol_detect.hpp"
+#include "driver_plugin.hpp"
+#include "mavlink_rtcm.hpp"
+#include "rtcm_packer.hpp"
+#include "rtcm_scheduler.hpp"
+#include "rtcm_output_queue.hpp"
+#include "rtcm3_msm.hpp"
+#include "rtcm_monitor.hpp"
+#include "base_failover.hpp"
+#include "shared_memory.hpp"
 
 class RTKNode
 {
@@ -30,19 +60,34 @@ public:
         float _surveyDuration = 90.0):
         connected(false), baud(_baud), port(_port),
         surveyAccuracy(_surveyAccuracy), surveyDuration(_surveyDuration), nh(_nh) {
-            surveyInStatus = new SurveyInStatus();
+            memset(&surveyInStatus, 0, sizeof(surveyInStatus));
             pReportSatInfo = new satellite_info_s();
-            RTCMPublisher = nh->advertise<mavros_msgs::RTCM>("/mavros/gps_rtk/send_rtcm", 1);
+            RTCMPublisher = nh->advertise<mavros_msgs::RTCM>("/mavros/gps_rtk/send_rtcm", 10);
             GPSPublisher = nh->advertise<sensor_msgs::NavSatFix>("gps", 1);
+            SatellitesPublisher = nh->advertise<rtk_ros::Satellites>("satellites", 1);
+            StatisticsPublisher = nh->advertise<rtk_ros::SatelliteStatistics>("satellite_statistics", 1);
+            DopPublisher = nh->advertise<rtk_ros::Dop>("dop", 1);
+            InterferencePublisher = nh->advertise<rtk_ros::InterferenceStatus>("interference", 1);
+            SurveyPublisher = nh->advertise<rtk_ros::SurveyStatus>("survey_status", 1, true);
+            RawPublisher = nh->advertise<rtk_ros::RawObservations>("raw_observations", 10);
+            RtcmQualityPublisher = nh->advertise<rtk_ros::RtcmQuality>("rtcm_quality", 1);
     };
 	~RTKNode() {
         if (gpsDriver) {
-            delete gpsDriver;
+            driverLoader.destroy(gpsDriver);
             gpsDriver = nullptr;
         }
-        if (serial) {
-            delete serial;
-            serial = nullptr;
+        if (driverAdapter) {
+            delete driverAdapter;
+            driverAdapter = nullptr;
+        }
+        if (transport) {
+            delete transport;
+            transport = nullptr;
+        }
+        if (standbyTransport) {
+            delete standbyTransport;
+            standbyTransport = nullptr;
         }
         if (pReportSatInfo) {
             delete pReportSatInfo;
@@ -63,44 +108,46 @@ public:
     }
 
     void connect() {
-        if (!serial) serial = new serial::Serial();
-        serial->setPort(port);
-
-        serial->open();
-        if (!serial->isOpen()) {
-            ROS_WARN_STREAM("GPS: Failed to open Serial Device: " << port);
+        if (!transport) transport = rtk_ros::Transport::create(port, baud);
+        if (!transport) {
+            ROS_FATAL_STREAM("GPS: Unknown port URI: " << port);
             return;
         }
-        serial->setBaudrate(baud);
-        serial->setBytesize(serial::eightbits);
-        serial->setParity(serial::parity_none);
-        serial->setStopbits(serial::stopbits_one);
-        serial->setFlowcontrol(serial::flowcontrol_none);
 
         for (int tries = 0; tries < 5; tries++) {
             try {
-                ROS_DEBUG("Trying to connect to the serial port");
-                serial->open();
-            } catch (serial::IOException) {
+                ROS_DEBUG_STREAM("Trying to connect to " << transport->name());
+                transport->open();
             } catch (...) {
-                ROS_FATAL("Other serial port exception");
+                ROS_FATAL("Other transport exception");
             }
 
-            if (serial->isOpen()) {
+            if (transport->isOpen()) {
                 connected = true;
-                serial::Timeout timeout = serial::Timeout::simpleTimeout(500);
-                serial->setTimeout(timeout);
                 return;
             } else {
                 connected = false;
-                ROS_INFO_STREAM("Bad Connection with serial port Error " << port);
+                ROS_INFO_STREAM("Bad Connection with " << transport->name());
             }
         }
     };
 
     void run() {
-        if (gpsDriver->configure(baud, GPSDriverUBX::OutputMode::RTCM) == 0) {
+        if (!gpsDriver) return;
+        // MTK receivers can't be a base, they only report their position
+        const GPSHelper::OutputMode outputMode = protocol == rtk_ros::GpsProtocol::MTK ? GPSHelper::OutputMode::GPS : GPSHelper::OutputMode::RTCM;
+        if (gpsDriver->configure(baud, outputMode) == 0) {
             ROS_INFO("Configured");
+            if (protocol == rtk_ros::GpsProtocol::UBX) {
+                sendConfiguration();
+            }
+            if (fixedPositionSet) {
+                ROS_INFO_STREAM("Base fixed at ECEF " << std::fixed << fixedPosition.ecef[0] << " "
+                    << fixedPosition.ecef[1] << " " << fixedPosition.ecef[2] << ", accuracy " << fixedPosition.accuracy << " m");
+            }
+            if (measurementPeriod > 0) {
+                ROS_INFO_STREAM("Navigation rate set to " << 1000.0 / measurementPeriod << " Hz");
+            }
             /* reset report */
             memset(&reportGPSPos, 0, sizeof(reportGPSPos));
 
@@ -108,7 +155,9 @@ public:
             //bus errors or buggy firmware. In this case we want to try multiple times before giving up.
             int numTries = 0;
 
-            while (ros::ok() && numTries < 3) {
+            // With a standby base the node keeps forwarding its corrections when the primary is lost
+            while (ros::ok() && (numTries < 3 || standbyTransport)) {
+                if (numTries >= 3) standbyTransport->waitReadable(100);
                 int helperRet = gpsDriver->receive(100);
                 ROS_DEBUG("Reading data");
 
@@ -120,13 +169,52 @@ public:
                         numTries = 0;
                     }
 
-                    if (pReportSatInfo && (helperRet & 2)) {
-                        publishGPSSatellite();
+                    if ((pReportSatInfo && (helperRet & 2)) || satellitesUpdated) {
+                        updateSatellites(helperRet & 2);
                         numTries = 0;
                     }
                 } else {
                     ++numTries;
                 }
+
+                if (surveyUpdated) {
+                    baseFailover.setSurvey(rtk_ros::BASE_PRIMARY, surveyIn.active, surveyIn.valid);
+                    publishSurveyStatus();
+                }
+
+                if (standbyTransport) {
+                    serviceStandby();
+                }
+
+                if (rawUpdated) {
+                    publishRawObservations();
+                }
+
+                if (rtcmQualityUpdated) {
+                    publishRtcmQuality();
+                }
+
+                if (rtcmScheduler.enabled()) {
+                    serviceRtcmScheduler();
+                }
+
+                if (mavlinkOutput.isOpen()) {
+                    const double now = ros::WallTime::now().toSec();
+                    if (packDelay > 0.0) {
+                        MavlinkQueueInput input = {rtcmOutputQueue, now};
+                        rtcmPacker.flushOlderThan(now, packDelay, input);
+                    }
+                    drainMavlinkQueue(now);
+                }
+
+                if (hostEstimation && !basePositionSent && baseEstimator.converged()) {
+                    sendBasePosition();
+                }
+
+                if (statisticsPeriod > 0.0 && (ros::Time::now() - lastStatisticsPublish).toSec() >= statisticsPeriod) {
+                    publishSignalStatistics();
+                    logStreamCounters();
+                }
             }
 
             // if (_serial->error() != Serial::NoError && _serial->error() != Serial::TimeoutError) {
@@ -157,26 +245,563 @@ public:
             << std::endl << "HDOP: "     << reportGPSPos.hdop << "\t VDOP" << reportGPSPos.vdop
             << std::endl << "lat: " << reportGPSPos.lat << "\t lon:" << reportGPSPos.lon
             << std::endl << "heading: " << reportGPSPos.heading
-            << std::endl << "sat used: " << (int)reportGPSPos.satellites_used);
+            << std::endl << "sat used: " << (int)reportGPSPos.satellites_used
+            << std::endl << "noise: " << reportGPSPos.noise_per_ms << "\t jamming: " << reportGPSPos.jamming_indicator);
         GPSPublisher.publish(msg);
+        if (sharedMemory.isOpen()) {
+            rtk_ros::shm::Position position;
+            position.time_utc_usec = reportGPSPos.time_utc_usec;
+            position.lat = reportGPSPos.lat;
+            position.lon = reportGPSPos.lon;
+            position.alt = reportGPSPos.alt;
+            position.alt_ellipsoid = reportGPSPos.alt_ellipsoid;
+            position.eph = reportGPSPos.eph;
+            position.epv = reportGPSPos.epv;
+            position.hdop = reportGPSPos.hdop;
+            position.vdop = reportGPSPos.vdop;
+            position.fix_type = reportGPSPos.fix_type;
+            position.satellites_used = reportGPSPos.satellites_used;
+            sharedMemory.writePosition(position);
+        }
+        interferenceMonitor.updatePosition(reportGPSPos.noise_per_ms, reportGPSPos.jamming_indicator);
+
+        publishDop(msg.header);
+    };
+
+    void publishDop(const std_msgs::Header &header) {
+        rtk_ros::Dop &msg = dopMsg;
+        msg.header = header;
+
+        rtk_ros::DopValues dop = skyGeometry.combined();
+        msg.num_sv = dop.num_sv;
+        msg.gdop = dop.gdop;
+        msg.pdop = dop.pdop;
+        msg.hdop = dop.hdop;
+        msg.vdop = dop.vdop;
+        msg.tdop = dop.tdop;
+
+        msg.gnss_id.clear();
+        msg.constellation_num_sv.clear();
+        msg.constellation_gdop.clear();
+        msg.constellation_pdop.clear();
+        msg.constellation_hdop.clear();
+        msg.constellation_vdop.clear();
+        msg.constellation_tdop.clear();
+        for (uint8_t gnss = 0; gnss < rtk_ros::GNSS_COUNT; gnss++) {
+            if (skyGeometry.satellites(gnss) == 0) continue;
+            dop = skyGeometry.constellation(gnss);
+            msg.gnss_id.push_back(gnss);
+            msg.constellation_num_sv.push_back(dop.num_sv);
+            msg.constellation_gdop.push_back(dop.gdop);
+            msg.constellation_pdop.push_back(dop.pdop);
+            msg.constellation_hdop.push_back(dop.hdop);
+            msg.constellation_vdop.push_back(dop.vdop);
+            msg.constellation_tdop.push_back(dop.tdop);
+        }
+        DopPublisher.publish(msg);
+    };
+
+    /** New satellite epoch, either decoded from NAV-SAT or reported by the driver */
+    void updateSatellites(bool driverReport) {
+        if (driverReport && !navSatReceived) {
+            // Receiver without NAV-SAT support, fall back to the capped driver report
+            satTable.fromSatelliteInfo(*pReportSatInfo);
+            satellitesUpdated = true;
+        }
+        if (!satellitesUpdated) return;
+        satellitesUpdated = false;
+
+        signalStatistics.update(satTable);
+        skyGeometry.update(satTable);
+        interferenceMonitor.update(satTable);
+        publishGPSSatellite();
+        publishInterference();
     };
 
     void publishGPSSatellite() {
-        ROS_WARN_STREAM_THROTTLE(0.1, "I see " << (int)pReportSatInfo->count << " sattelites");
-        // pReportSatInfo
+        // The message is a member so the arrays keep their capacity between epochs
+        const uint16_t count = satTable.count;
+        satellitesMsg.header.stamp = ros::Time::now();
+        satellitesMsg.header.frame_id = "rtk_base";
+        satellitesMsg.itow = satTable.itow;
+        satellitesMsg.num_svs = satTable.num_svs;
+        satellitesMsg.gnss_id.assign(satTable.gnss_id, satTable.gnss_id + count);
+        satellitesMsg.sv_id.assign(satTable.sv_id, satTable.sv_id + count);
+        satellitesMsg.cno.assign(satTable.cno, satTable.cno + count);
+        satellitesMsg.elevation.assign(satTable.elevation, satTable.elevation + count);
+        satellitesMsg.azimuth.assign(satTable.azimuth, satTable.azimuth + count);
+        satellitesMsg.flags.resize(count);
+        for (uint16_t i = 0; i < count; i++) {
+            satellitesMsg.flags[i] = satTable.used[i] | (satTable.quality[i] << 1)
+                | (satTable.health[i] << 4) | (satTable.diff_corr[i] << 6);
+        }
+        if (satTable.num_svs > count) {
+            ROS_WARN_STREAM_THROTTLE(10, "Satellite table full: " << (int)satTable.num_svs << " SVs tracked, "
+                << count << " kept (RTK_SAT_TABLE_CAPACITY)");
+        }
+        SatellitesPublisher.publish(satellitesMsg);
+    };
+
+    void publishSignalStatistics() {
+        lastStatisticsPublish = ros::Time::now();
+        size_t count = signalStatistics.compute(statisticsResults);
+
+        rtk_ros::SatelliteStatistics &msg = statisticsMsg;
+        msg.header.stamp = lastStatisticsPublish;
+        msg.header.frame_id = "rtk_base";
+        msg.window = rtk_ros::SignalStatistics::WINDOW;
+        msg.window_fill = signalStatistics.windowFill();
+        msg.gnss_id.resize(count);
+        msg.sv_id.resize(count);
+        msg.samples.resize(count);
+        msg.cno_min.resize(count);
+        msg.cno_mean.resize(count);
+        msg.cno_variance.resize(count);
+        msg.elevation_mean.resize(count);
+        msg.used_ratio.resize(count);
+        msg.dropouts.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const rtk_ros::SignalStatistics::Result &r = statisticsResults[i];
+            msg.gnss_id[i] = r.gnss_id;
+            msg.sv_id[i] = r.sv_id;
+            msg.samples[i] = r.samples;
+            msg.cno_min[i] = r.cno_min;
+            msg.cno_mean[i] = r.cno_mean;
+            msg.cno_variance[i] = r.cno_variance;
+            msg.elevation_mean[i] = r.elevation_mean;
+            msg.used_ratio[i] = r.used_ratio;
+            msg.dropouts[i] = r.dropouts;
+        }
+        StatisticsPublisher.publish(msg);
+    };
+
+    void publishInterference() {
+        const rtk_ros::InterferenceMonitor::State &state = interferenceMonitor.status();
+        rtk_ros::InterferenceStatus msg;
+        msg.header.stamp = ros::Time::now();
+        msg.header.frame_id = "rtk_base";
+        msg.jamming_state = state.jamming_state;
+        msg.jam_indicator = state.jam_indicator;
+        msg.noise_per_ms = state.noise_per_ms;
+        msg.agc_count = state.agc_count;
+        msg.noise_baseline = state.noise_baseline;
+        msg.num_sv = state.num_sv;
+        msg.cno_mean = state.cno_mean;
+        msg.cno_stddev = state.cno_stddev;
+        msg.cno_elevation_correlation = state.cno_elevation_correlation;
+        msg.jamming_suspected = state.jamming_suspected;
+        msg.spoofing_suspected = state.spoofing_suspected;
+        msg.rtcm_gated = rtcmGated();
+        msg.rtcm_frames_gated = rtcmFramesGated;
+        InterferencePublisher.publish(msg);
+
+        if (state.spoofing_suspected) {
+            ROS_WARN_STREAM_THROTTLE(10, "Spoofing suspected: C/N0 " << state.cno_mean << " +- " << state.cno_stddev
+                << " dBHz, elevation correlation " << state.cno_elevation_correlation
+                << (rtcmGated() ? ", RTCM output suppressed" : ""));
+        }
+        if (state.jamming_suspected) {
+            ROS_WARN_STREAM_THROTTLE(10, "Jamming suspected: jamInd " << (int)state.jam_indicator
+                << " noise " << state.noise_per_ms << " (baseline " << state.noise_baseline << ")");
+        }
+    };
+
+    void publishSurveyStatus() {
+        surveyUpdated = false;
+        surveyPredictor.update(surveyIn.duration, surveyIn.mean_accuracy);
+
+        rtk_ros::SurveyStatus msg;
+        msg.header.stamp = ros::Time::now();
+        msg.header.frame_id = "rtk_base";
+        msg.duration = surveyIn.duration;
+        msg.mean_accuracy = surveyIn.mean_accuracy;
+        msg.observations = surveyIn.observations;
+        msg.valid = surveyIn.valid;
+        msg.active = surveyIn.active;
+        for (int i = 0; i < 3; i++) msg.mean_ecef[i] = surveyIn.mean_ecef[i];
+        msg.target_accuracy = surveyAccuracy;
+        msg.min_duration = surveyDuration;
+        msg.eta = surveyIn.valid ? 0.f
+            : surveyPredictor.eta(surveyIn.duration, surveyIn.mean_accuracy, surveyAccuracy, surveyDuration);
+        SurveyPublisher.publish(msg);
+
+        if (sharedMemory.isOpen()) {
+            rtk_ros::shm::Survey survey;
+            for (int i = 0; i < 3; i++) survey.mean_ecef[i] = surveyIn.mean_ecef[i];
+            survey.mean_accuracy = surveyIn.mean_accuracy;
+            survey.duration = surveyIn.duration;
+            survey.observations = surveyIn.observations;
+            survey.active = surveyIn.active;
+            survey.valid = surveyIn.valid;
+            sharedMemory.writeSurvey(survey);
+        }
+    };
+
+    void publishRawObservations() {
+        rawUpdated = false;
+        const rtk_ros::RawEpochHeader &epoch = rawEpoch.header;
+        const size_t n = epoch.count;
+
+        rtk_ros::RawObservations &msg = rawMsg;
+        msg.header.stamp = ros::Time::now();
+        msg.header.frame_id = "rtk_base";
+        msg.rcv_tow = epoch.rcv_tow;
+        msg.week = epoch.week;
+        msg.leap_seconds = epoch.leap_seconds;
+        msg.leap_seconds_known = epoch.rec_stat & 0x01;
+        msg.clock_reset = (epoch.rec_stat >> 1) & 0x01;
+        msg.num_meas = epoch.num_meas;
+        msg.gnss_id.resize(n);
+        msg.sv_id.resize(n);
+        msg.sig_id.resize(n);
+        msg.freq_id.resize(n);
+        msg.pseudorange.resize(n);
+        msg.carrier_phase.resize(n);
+        msg.doppler.resize(n);
+        msg.cno.resize(n);
+        msg.lock_time.resize(n);
+        msg.trk_stat.resize(n);
+        msg.pseudorange_stdev.resize(n);
+        msg.carrier_phase_stdev.resize(n);
+        msg.doppler_stdev.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            const rtk_ros::RawMeasurement &m = rawEpoch.meas[i];
+            msg.gnss_id[i] = m.gnss_id;
+            msg.sv_id[i] = m.sv_id;
+            msg.sig_id[i] = m.sig_id;
+            msg.freq_id[i] = m.freq_id;
+            msg.pseudorange[i] = m.pseudorange;
+            msg.carrier_phase[i] = m.carrier_phase;
+            msg.doppler[i] = m.doppler;
+            msg.cno[i] = m.cno;
+            msg.lock_time[i] = m.lock_time;
+            msg.trk_stat[i] = m.trk_stat;
+            msg.pseudorange_stdev[i] = m.pseudorangeStdev();
+            msg.carrier_phase_stdev[i] = m.carrierPhaseStdev();
+            msg.doppler_stdev[i] = m.dopplerStdev();
+        }
+        RawPublisher.publish(msg);
+    };
+
+    void publishRtcmQuality() {
+        rtcmQualityUpdated = false;
+        const rtk_ros::RtcmEpochSummary &epoch = rtcmMonitor.summary();
+        const double now = ros::WallTime::now().toSec();
+
+        rtk_ros::RtcmQuality &msg = rtcmQualityMsg;
+        msg.header.stamp = ros::Time::now();
+        msg.header.frame_id = "rtk_base";
+        msg.station_id = epoch.station_id;
+        msg.epoch_time = epoch.epoch_time;
+        msg.frames = epoch.frames;
+        msg.bytes = epoch.bytes;
+        msg.gnss_id.clear();
+        msg.msm_type.clear();
+        msg.num_satellites.clear();
+        msg.num_signals.clear();
+        msg.num_cells.clear();
+        msg.lock_resets.clear();
+        msg.cno_mean.clear();
+        msg.cno_min.clear();
+        for (size_t c = 0; c < rtk_ros::RTCM_CONSTELLATIONS; c++) {
+            const rtk_ros::RtcmConstellationSummary &s = epoch.constellations[c];
+            if (!s.present) continue;
+            msg.gnss_id.push_back(rtk_ros::RTCM_GNSS_ID[c]);
+            msg.msm_type.push_back(s.msm_type);
+            msg.num_satellites.push_back(s.num_satellites);
+            msg.num_signals.push_back(s.num_signals);
+            msg.num_cells.push_back(s.num_cells);
+            msg.lock_resets.push_back(s.lock_resets);
+            msg.cno_mean.push_back(s.cno_mean);
+            msg.cno_min.push_back(s.cno_min);
+        }
+        msg.station_position = epoch.station_position;
+        for (int i = 0; i < 3; i++) msg.arp_ecef[i] = epoch.arp_ecef[i];
+        msg.antenna_height = epoch.antenna_height;
+        msg.station_age = epoch.station_position ? (float)(now - epoch.station_time) : -1.f;
+        msg.glonass_biases = epoch.glonass_biases;
+        msg.glonass_bias_mask = epoch.glonass_bias_mask;
+        msg.glonass_bias_age = epoch.glonass_biases ? (float)(now - epoch.glonass_bias_time) : -1.f;
+        RtcmQualityPublisher.publish(msg);
+    };
+
+    /** Switch the receiver to fixed mode at the host-side estimate (CFG-TMODE3) */
+    void sendBasePosition() {
+        double ecef[3];
+        baseEstimator.position(ecef);
+        float accuracy = (float)baseEstimator.standardError();
+        sendFixedPosition(ecef, accuracy);
+        basePositionSent = true;
+        ROS_INFO_STREAM("Host-side base estimate converged after " << baseEstimator.duration() << " s, "
+            << baseEstimator.samples() << " samples (" << baseEstimator.rejectedSamples() << " rejected), accuracy "
+            << accuracy << " m: ECEF " << std::fixed << ecef[0] << " " << ecef[1] << " " << ecef[2]);
+    };
+
+    void sendFixedPosition(const double ecef[3], float accuracy) {
+        uint8_t frame[rtk_ros::ubx::CFG_TMODE3_LENGTH + rtk_ros::ubx::FRAME_OVERHEAD];
+        size_t len = rtk_ros::ubx::appendFrame(frame, 0, rtk_ros::ubx::cfgTmode3Fixed(ecef[0], ecef[1], ecef[2], accuracy));
+        transport->write(frame, len);
+    };
+
+    /**
+     * Write the node's configuration on top of the driver's in a single call.
+     * The message enables are compile-time blobs, see receiver_config.hpp.
+     */
+    void sendConfiguration() {
+        uint8_t blob[rtk_ros::config::MAX_CONFIG_LENGTH];
+        size_t len = appendBlob(blob, 0, rtk_ros::config::BASE_MESSAGES);
+        if (fixedPositionSet) {
+            // Known base position, skip the survey altogether
+            len = rtk_ros::ubx::appendFrame(blob, len, rtk_ros::ubx::cfgTmode3Fixed(fixedPosition.ecef[0],
+                    fixedPosition.ecef[1], fixedPosition.ecef[2], fixedPosition.accuracy));
+        } else if (hostEstimation) {
+            len = appendBlob(blob, len, rtk_ros::config::HOST_ESTIMATION_MESSAGES);
+        }
+        if (rawPublish || rawLogger.isOpen()) {
+            len = appendBlob(blob, len, rtk_ros::config::RAW_MESSAGES);
+        }
+        if (measurementPeriod > 0) {
+            len = rtk_ros::ubx::appendFrame(blob, len, rtk_ros::ubx::cfgRate(measurementPeriod));
+        }
+        transport->write(blob, len);
+    };
+
+    template <size_t N>
+    static size_t appendBlob(uint8_t *out, size_t pos, const rtk_ros::ubx::ConstexprArray<uint8_t, N> &blob) {
+        memcpy(out + pos, blob.data, N);
+        return pos + N;
+    };
+
+    /**
+     * Measurement and navigation rate [Hz], 0 keeps the driver's default.
+     * Limited to 20 Hz, receivers that can't keep up output at their own limit.
+     */
+    void setNavigationRate(float rate) {
+        if (rate <= 0.f) {
+            measurementPeriod = 0;
+            return;
+        }
+        float period = 1000.f / rate;
+        if (period < rtk_ros::ubx::MIN_MEASUREMENT_PERIOD) {
+            ROS_WARN_STREAM("Navigation rate limited to " << 1000 / rtk_ros::ubx::MIN_MEASUREMENT_PERIOD << " Hz");
+            period = rtk_ros::ubx::MIN_MEASUREMENT_PERIOD;
+        }
+        measurementPeriod = period < 65535.f ? (uint16_t)(period + 0.5f) : 65535;
+    };
+
+    /**
+     * Estimate the base position on the host from NAV-HPPOSECEF instead of
+     * waiting for the receiver's survey-in
+     * @param accuracy target 3D accuracy [m]
+     * @param minDuration minimum observation time [s]
+     */
+    void setHostEstimation(bool enable, float accuracy, float minDuration) {
+        hostEstimation = enable;
+        baseEstimator.settings.target_accuracy = accuracy;
+        baseEstimator.settings.min_duration = minDuration;
+    };
+
+    /** Use a known base position (e.g. from rtk_base_refine) instead of a survey */
+    void setFixedPosition(const rtk_ros::FixedPosition &position) {
+        fixedPosition = position;
+        fixedPositionSet = true;
+        hostEstimation = false;
+    };
+
+    /**
+     * Enable RXM-RAWX/RXM-SFRBX (M8T, F9P and other raw-capable receivers).
+     * @param publish publish ~/raw_observations
+     * @param logFile binary log for post-processing, empty to disable
+     * @param bufferSize log buffer [bytes], records are dropped when it is full
+     */
+    void setRawMeasurements(bool publish, const std::string &logFile, size_t bufferSize) {
+        rawPublish = publish;
+        if (logFile.empty()) return;
+        if (rawLogger.open(logFile, bufferSize)) {
+            ROS_INFO_STREAM("Logging raw measurements to " << logFile);
+        } else {
+            ROS_ERROR_STREAM("Cannot open the raw measurement log " << logFile);
+        }
+    };
+
+    /** Suppress RTCM output while spoofing is suspected */
+    void setInterferenceGate(bool gate) {
+        gateRTCMOnSpoofing = gate;
+    };
+
+    bool rtcmGated() const {
+        return gateRTCMOnSpoofing && interferenceMonitor.status().spoofing_suspected;
+    };
+
+    /** Publish rate of the satellite statistics [Hz], 0 disables them */
+    void setStatisticsRate(float rate) {
+        statisticsPeriod = rate > 0.f ? 1.0 / rate : 0.0;
+    };
+
+    /** Called by the stream demultiplexer for every valid UBX frame read from the receiver */
+    void onUbxMessage(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len) {
+        UbxDispatch::dispatch(*this, msgClass, msgId, payload, len);
+    };
+
+    void onUbx(const rtk_ros::ubx::MonHw &, const uint8_t *payload, uint16_t len) {
+        interferenceMonitor.decodeMonHw(payload, len);
+    };
+
+    void onUbx(const rtk_ros::ubx::MonRf &, const uint8_t *payload, uint16_t len) {
+        interferenceMonitor.decodeMonRf(payload, len);
+    };
+
+    /** Both positions are timed by their iTOW, so NAV-PVT and NAV-HPPOSECEF samples share one time base */
+    void onUbx(const rtk_ros::ubx::NavPvt &, const uint8_t *payload, uint16_t len) {
+        rtk_ros::EcefSample sample;
+        // Fallback for receivers without NAV-HPPOSECEF
+        if (hostEstimation && !basePositionSent && !hpposecefReceived
+                && sample.decodeNavPvt(payload, len) && sample.valid) {
+            baseEstimator.add(towClock.seconds(sample.itow), sample.ecef, sample.accuracy);
+        }
+    };
+
+    void onUbx(const rtk_ros::ubx::NavHpposecef &, const uint8_t *payload, uint16_t len) {
+        rtk_ros::EcefSample sample;
+        if (!hostEstimation || basePositionSent || !sample.decodeNavHpposecef(payload, len)) return;
+        if (!hpposecefReceived) {
+            // Restart without the NAV-PVT samples, they would bias the high-precision mean
+            hpposecefReceived = true;
+            baseEstimator.reset();
+            towClock.reset();
+        }
+        if (sample.valid) baseEstimator.add(towClock.seconds(sample.itow), sample.ecef, sample.accuracy);
+    };
+
+    void onUbx(const rtk_ros::ubx::NavSvin &, const uint8_t *payload, uint16_t len) {
+        if (surveyIn.decodeNavSvin(payload, len)) {
+            surveyUpdated = true;
+            navSvinReceived = true;
+        }
+    };
+
+    void onUbx(const rtk_ros::ubx::RxmRawx &, const uint8_t *payload, uint16_t len) {
+        if (!rawEpoch.decodeRxmRawx(payload, len)) return;
+        if (rawLogger.isOpen() && !rawLogger.logEpoch(rawEpoch, ros::Time::now().toNSec())) {
+            ROS_WARN_THROTTLE(10, "Raw measurement log %s, %lu records dropped",
+                    rawLogger.failed() ? "write failed" : "buffer full", (unsigned long)rawLogger.droppedRecords());
+        }
+        rawUpdated = rawPublish;
+    };
+
+    void onUbx(const rtk_ros::ubx::RxmSfrbx &, const uint8_t *payload, uint16_t len) {
+        if (rawLogger.isOpen() && navSubframe.decodeRxmSfrbx(payload, len)) {
+            rawLogger.logSubframe(navSubframe, ros::Time::now().toNSec());
+        }
+    };
+
+    void onUbx(const rtk_ros::ubx::NavSat &, const uint8_t *payload, uint16_t len) {
+        if (satTable.decodeNavSat(payload, len)) {
+            satellitesUpdated = true;
+            navSatReceived = true;
+        } else {
+            ROS_WARN_THROTTLE(10, "Malformed NAV-SAT message");
+        }
     };
 
     void connect_gps() {
         // dynamic model
         uint8_t stationary_model = 2;
-        ROS_INFO("Connect Driver");
-        gpsDriver = new GPSDriverUBX(GPSDriverUBX::Interface::UART, &callbackEntry, this, &reportGPSPos, pReportSatInfo, stationary_model);
+        if (autodetectProtocol) {
+            detectReceiver();
+        }
+        ROS_INFO_STREAM("Connect " << rtk_ros::protocolName(protocol) << " driver");
+        // Bind the driver to the concrete transport so its reads are resolved at compile time
+        if (rtk_ros::SerialTransport *t = dynamic_cast<rtk_ros::SerialTransport *>(transport)) {
+            gpsDriver = createDriver(*t, stationary_model);
+        } else if (rtk_ros::TcpTransport *t = dynamic_cast<rtk_ros::TcpTransport *>(transport)) {
+            gpsDriver = createDriver(*t, stationary_model);
+        } else if (rtk_ros::UnixSocketTransport *t = dynamic_cast<rtk_ros::UnixSocketTransport *>(transport)) {
+            gpsDriver = createDriver(*t, stationary_model);
+        } else {
+            gpsDriver = newDriver(&callbackEntry, this, stationary_model);
+        }
+        if (!gpsDriver) {
+            ROS_FATAL_STREAM("Cannot load the " << rtk_ros::protocolName(protocol) << " driver: " << driverLoader.error());
+            return;
+        }
         gpsDriver->setSurveyInSpecs(surveyAccuracy * 10000, surveyDuration);
         ROS_INFO("Configure survey");
         memset(&reportGPSPos, 0, sizeof(reportGPSPos)); // Reset report
     };
 
+    /**
+     * Receiver protocol: "auto" detects it on the port and caches the result
+     * in cacheFile (empty to disable), or one of "ubx", "ashtech", "mtk".
+     */
+    void setProtocol(const std::string &name, const std::string &cacheFile) {
+        protocolCacheFile = cacheFile;
+        autodetectProtocol = name == "auto";
+        if (autodetectProtocol) return;
+        protocol = rtk_ros::protocolFromName(name);
+        if (protocol == rtk_ros::GpsProtocol::Unknown) {
+            ROS_ERROR_STREAM("Unknown receiver protocol " << name << ", using ubx");
+            protocol = rtk_ros::GpsProtocol::UBX;
+        }
+    };
+
+    /** Sniff the port for the receiver protocol, the cached result of the port is confirmed first */
+    void detectReceiver() {
+        const bool serial = dynamic_cast<rtk_ros::SerialTransport *>(transport) != nullptr;
+        rtk_ros::ProtocolCache cache(protocolCacheFile);
+        rtk_ros::ProtocolDetection cached, detection;
+        if (cache.lookup(port, cached)) {
+            detection = rtk_ros::detectProtocol(*transport, {serial ? cached.baud : baud}, DETECT_WINDOW_MS);
+            if (detection.protocol != cached.protocol) detection = rtk_ros::ProtocolDetection();
+        }
+        if (detection.protocol == rtk_ros::GpsProtocol::Unknown) {
+            std::vector<unsigned> bauds(1, baud);
+            if (serial) {
+                for (unsigned b : rtk_ros::DETECT_BAUDRATES) {
+                    if (b != baud) bauds.push_back(b);
+                }
+            }
+            ROS_INFO_STREAM("Detecting the receiver protocol on " << transport->name());
+            detection = rtk_ros::detectProtocol(*transport, bauds, DETECT_WINDOW_MS);
+            if (detection.protocol != rtk_ros::GpsProtocol::Unknown && !protocolCacheFile.empty()
+                    && !cache.store(port, detection)) {
+                ROS_WARN_STREAM("Cannot write the protocol cache " << protocolCacheFile);
+            }
+        }
+
+        if (detection.protocol == rtk_ros::GpsProtocol::Unknown) {
+            // Silent receiver, the UBX driver sweeps the baudrates itself while configuring
+            ROS_WARN("No known protocol on the receiver port, assuming ubx");
+            protocol = rtk_ros::GpsProtocol::UBX;
+            return;
+        }
+        protocol = detection.protocol;
+        ROS_INFO_STREAM("Detected a " << rtk_ros::protocolName(protocol) << " receiver at " << detection.baud << " baud");
+        if (serial && protocol != rtk_ros::GpsProtocol::UBX) {
+            // Only the UBX driver switches the receiver to the configured baudrate
+            baud = detection.baud;
+        }
+    };
+
+    template <typename TransportT>
+    GPSHelper *createDriver(TransportT &t, uint8_t dynamic_model) {
+        typedef rtk_ros::DriverAdapter<TransportT, RTKNode> Adapter;
+        Adapter *adapter = new Adapter(t, *this);
+        driverAdapter = adapter;
+        return newDriver(Adapter::entry(), adapter->user(), dynamic_model);
+    };
+
+    GPSHelper *newDriver(GPSCallbackPtr entry, void *user, uint8_t dynamic_model) {
+        rtk_ros::DriverArgs args = {entry, user, &reportGPSPos, pReportSatInfo, dynamic_model};
+        return driverLoader.create(rtk_ros::protocolName(protocol), args);
+    };
 
+    /** Directory of the driver modules, empty to use the library path */
+    void setDriverPath(const std::string &path) {
+        driverLoader.setPath(path);
+    };
+
+    /** Untyped callback, kept for drivers created without an adapter */
     static int callbackEntry(GPSCallbackType type, void *data1, int data2, void *user)
     {
         RTKNode *node = (RTKNode *)user;
@@ -185,83 +810,480 @@ public:
 
 
     void gotRTCMData(uint8_t *data, size_t len) {
-        mavros_msgs::RTCM msg;
-        msg.data.resize(len);
-        msg.data.assign(data, data + len);
-        RTCMPublisher.publish(msg);
-        ROS_WARN("Publish RTCM");
+        if (standbyTransport) {
+            FailoverSink sink = {*this};
+            baseFailover.onFrame(rtk_ros::BASE_PRIMARY, data, len, ros::WallTime::now().toSec(), sink);
+        } else {
+            forwardRtcm(data, len);
+        }
     }
 
-    int callback(GPSCallbackType type, void *data1, int data2)
-    {
-        int bytes_written = 0;
-        switch (type) {
-            case GPSCallbackType::readDeviceData: {
-                ROS_DEBUG("Read more data");
-                
-                if (serial->available() == 0) {
-                    int timeout = *((int *) data1);
-                    //if (!_serial->waitForReadyRead(timeout))
-                    if (!serial->waitReadable())
-                        return 0; // error, no new data
-                }
-                return (int)serial->read((uint8_t *) data1, data2);
-            }
-            case GPSCallbackType::writeDeviceData: {
-                ROS_DEBUG("Write device data");
-                bytes_written = serial->write((uint8_t *) data1, data2);
-                if (bytes_written == data2) {
-                    return data2;
-                }
-                return -1;
+    /** RTCM of the active base, through the spoofing gate and the scheduler to the outputs */
+    void forwardRtcm(const uint8_t *data, size_t len) {
+        if (rtcmGated()) {
+            ++rtcmFramesGated;
+            return;
+        }
+        // Local consumers get every frame, the link budget applies to the outputs below
+        sharedMemory.writeFrame(data, len);
+        if (rtcmScheduler.enabled()) {
+            const double now = ros::WallTime::now().toSec();
+            // The budget is the link's: MAVLink when it is open, otherwise the topic (mavros)
+            const bool budgetMsm4 = mavlinkOutput.isOpen() ? mavlinkMsm4 : topicMsm4;
+            const bool allMsm4 = (!mavlinkOutput.isOpen() || mavlinkMsm4) && (!rtcmTopic || topicMsm4);
+            const uint8_t *frame = data;
+            size_t frameLen = len, linkLen = len;
+            if (budgetMsm4 && allMsm4) {
+                // Queued as every output sends it, outputRtcm() passes MSM4 through
+                frame = msm4Downgrade.apply(data, frameLen);
+                linkLen = frameLen;
+            } else if (budgetMsm4) {
+                // The other output keeps MSM7, charge the size the link carries
+                budgetDowngrade.apply(data, linkLen);
             }
+            // MAVLink adds its framing to every fragment
+            if (mavlinkOutput.isOpen()) linkLen = rtk_ros::mavlink::gpsRtcmDataLength(linkLen);
+            rtcmScheduler.add(frame, frameLen, now, linkLen);
+            RtcmSink sink = {*this};
+            rtcmScheduler.service(now, sink);
+        } else {
+            outputRtcm(data, len);
+        }
+    }
 
-            case GPSCallbackType::setBaudrate: {
-                ROS_DEBUG("Set baudrate");
-                serial->setBaudrate(data2);
-                return true;
+    /** RTCM to every enabled output */
+    void outputRtcm(const uint8_t *data, size_t len) {
+        size_t msm4Len = len;
+        const uint8_t *msm4 = mavlinkMsm4 || topicMsm4 ? msm4Downgrade.apply(data, msm4Len) : data;
+        if (mavlinkOutput.isOpen()) {
+            const uint8_t *frame = mavlinkMsm4 ? msm4 : data;
+            const size_t frameLen = mavlinkMsm4 ? msm4Len : len;
+            const double now = ros::WallTime::now().toSec();
+            MavlinkQueueInput input = {rtcmOutputQueue, now};
+            if (packDelay > 0.0) {
+                rtcmPacker.add(frame, frameLen, now, input);
+            } else {
+                input.send(frame, frameLen);
             }
+            drainMavlinkQueue(now);
+        }
+        if (rtcmTopic) {
+            mavros_msgs::RTCM msg;
+            if (topicMsm4) msg.data.assign(msm4, msm4 + msm4Len);
+            else msg.data.assign(data, data + len);
+            RTCMPublisher.publish(msg);
+            ROS_DEBUG("Publish RTCM");
+        }
+    }
 
-            case GPSCallbackType::gotRTCMMessage: {
-                ROS_FATAL("RTCM");
-                gotRTCMData((uint8_t*) data1, data2);
-                break;
-            }
+    /**
+     * Keep the RTCM output within a link budget, shedding low priority and stale frames.
+     * @param budget [bytes/s], 0 sends everything as it comes
+     * @param maxAge frames queued for longer are dropped [s]
+     * @param priorities class names, highest priority first (rtcm_scheduler.hpp)
+     */
+    void setRtcmBudget(float budget, float maxAge, const std::string &priorities) {
+        rtcmScheduler.configure(budget, maxAge);
+        if (!priorities.empty() && !rtcmScheduler.setPriorities(priorities)) {
+            ROS_ERROR_STREAM("Invalid RTCM priorities \"" << priorities << "\", keeping the default order");
+        }
+    };
 
-            case GPSCallbackType::surveyInStatus: {
-                ROS_DEBUG("Survey");
-                surveyInStatus = (SurveyInStatus*)data1;
-                ROS_DEBUG_STREAM("Survey-in status: " << surveyInStatus->duration  << " cur accuracy: " << surveyInStatus->mean_accuracy 
-                        << " valid:" << (int)(surveyInStatus->flags & 1) << " active: " << (int)((surveyInStatus->flags>>1) & 1));
-                break;
-            }
+    void serviceRtcmScheduler() {
+        RtcmSink sink = {*this};
+        rtcmScheduler.service(ros::WallTime::now().toSec(), sink);
+        const uint64_t shed = rtcmScheduler.shed();
+        if (shed > rtcmShedReported) {
+            ROS_WARN_STREAM_THROTTLE(10, "RTCM over the link budget, " << shed << " frames shed");
+            rtcmShedReported = shed;
+        }
+    };
+
+    /**
+     * Run a standby base on a second receiver, its RTCM is forwarded when the primary is unhealthy.
+     * It is configured for survey-in with the survey parameters and read without a driver, so it
+     * must be a u-blox base whose port already outputs UBX and RTCM3 at baud.
+     * @param port transport URI as for the primary, empty for no standby
+     */
+    void setStandby(const std::string &port, unsigned baud, rtk_ros::BaseFailover::Config config) {
+        if (config.station_id > 4095) {
+            // DF003 is a 12-bit field
+            ROS_ERROR_STREAM("RTCM station id " << config.station_id << " out of range (0-4095), ids are not rewritten");
+            config.station_id = -1;
+        }
+        baseFailover.configure(config);
+        if (port.empty()) return;
+        standbyTransport = rtk_ros::Transport::create(port, baud);
+        if (!standbyTransport) {
+            ROS_ERROR_STREAM("Unknown standby port URI: " << port);
+            return;
+        }
+        if (config.station_id >= 0) {
+            ROS_INFO_STREAM("RTCM station id rewritten to " << config.station_id);
+        }
+    };
+
+    /**
+     * Write the RTCM frames sent and the latest position and survey-in to the POSIX shared
+     * memory segment name (e.g. "/rtk_ros"), see shared_memory_client.hpp to read it.
+     * @param name empty to disable
+     */
+    void setSharedMemory(const std::string &name) {
+        if (name.empty()) return;
+        if (sharedMemory.open(name)) {
+            ROS_INFO_STREAM("RTCM and position in shared memory " << name);
+        } else {
+            ROS_ERROR_STREAM("Cannot create the shared memory segment " << name << ": " << strerror(errno));
+        }
+    };
+
+    /** Read the standby base, feed the failover its health and switch if needed */
+    void serviceStandby() {
+        if (!standbyTransport->isOpen() && !connectStandby()) return;
+        uint8_t buffer[1024];
+        size_t available;
+        while ((available = standbyTransport->available()) > 0) {
+            const int n = standbyTransport->read(buffer, std::min(available, sizeof(buffer)));
+            if (n <= 0) break;
+            standbyDemux.parse(buffer, n, standbyHandler);
+        }
+
+        const double now = ros::WallTime::now().toSec();
+        baseFailover.setCrcErrors(rtk_ros::BASE_PRIMARY, streamDemux.counters().rtcm.errors, now);
+        baseFailover.setCrcErrors(rtk_ros::BASE_STANDBY, standbyDemux.counters().rtcm.errors, now);
+        FailoverSink sink = {*this};
+        baseFailover.update(now, sink);
+        if (baseFailover.active() != reportedBase) {
+            reportedBase = baseFailover.active();
+            ROS_WARN_STREAM("RTCM switched to the " << rtk_ros::baseSourceName(reportedBase) << " base");
+        }
+    };
 
-            case GPSCallbackType::setClock: {
-                ROS_DEBUG("Set clock");
-                break;
+    bool connectStandby() {
+        // Retried from the run loop, not more than every few seconds
+        const double now = ros::WallTime::now().toSec();
+        if (now - standbyConnectTime < STANDBY_RETRY_PERIOD) return false;
+        standbyConnectTime = now;
+        if (!standbyTransport->open()) {
+            ROS_WARN_STREAM_THROTTLE(60, "Cannot open the standby base on " << standbyTransport->name());
+            return false;
+        }
+        uint8_t blob[rtk_ros::config::STANDBY_CONFIG_LENGTH];
+        size_t len = appendBlob(blob, 0, rtk_ros::config::BASE_MESSAGES);
+        len = appendBlob(blob, len, rtk_ros::config::STANDBY_MESSAGES);
+        len = rtk_ros::ubx::appendFrame(blob, len, rtk_ros::ubx::cfgTmode3SurveyIn((uint32_t)surveyDuration, surveyAccuracy));
+        if (measurementPeriod > 0) {
+            len = rtk_ros::ubx::appendFrame(blob, len, rtk_ros::ubx::cfgRate(measurementPeriod));
+        }
+        standbyTransport->write(blob, len);
+        ROS_INFO_STREAM("Standby base on " << standbyTransport->name());
+        return true;
+    };
+
+    /**
+     * Re-encode MSM7 as MSM4 per destination, about half the bandwidth for
+     * rovers that do not use the extended resolution and range rates.
+     */
+    void setMsm4Output(bool mavlink, bool topic) {
+        mavlinkMsm4 = mavlink;
+        topicMsm4 = topic;
+    };
+
+    /**
+     * What gives way when the MAVLink socket cannot take more RTCM (rtcm_output_queue.hpp).
+     * @param policy drop_oldest, drop_stale_epoch or block
+     * @param deadline longest wait of a message under block, and of an epoch for its last MSM [s]
+     */
+    void setRtcmOutputPolicy(const std::string &policy, float deadline) {
+        rtk_ros::OutputPolicy p = rtcmOutputQueue.outputPolicy();
+        if (!rtk_ros::outputPolicyFromName(policy, p)) {
+            ROS_ERROR_STREAM("Unknown RTCM output policy \"" << policy << "\", using " << rtk_ros::outputPolicyName(p));
+        }
+        rtcmOutputQueue.configure(p, deadline);
+    };
+
+    void drainMavlinkQueue(double now) {
+        MavlinkQueueOutput output = {mavlinkOutput};
+        rtcmOutputQueue.drain(now, output);
+        const rtk_ros::RtcmOutputQueue::Counters &q = rtcmOutputQueue.counters();
+        if (q.dropped() > rtcmDropsReported) {
+            ROS_WARN_STREAM_THROTTLE(10, "MAVLink link behind, " << q.dropped() << " RTCM messages dropped ("
+                << rtk_ros::outputPolicyName(rtcmOutputQueue.outputPolicy()) << ")");
+            rtcmDropsReported = q.dropped();
+        }
+    };
+
+    /**
+     * Pack the frames of an epoch into as few GPS_RTCM_DATA fragments as possible.
+     * @param delay longest hold of a frame waiting for the end of its epoch [s], 0 sends every frame alone
+     */
+    void setMavlinkPacking(float delay) {
+        packDelay = delay > 0.f ? delay : 0.0;
+    };
+
+    /**
+     * Send RTCM as MAVLink GPS_RTCM_DATA to uri (udp://host:port), empty to disable.
+     * @param topic keep publishing the RTCM topic for mavros
+     */
+    void setMavlinkOutput(const std::string &uri, uint8_t sysid, uint8_t compid, bool topic) {
+        rtcmTopic = topic;
+        if (uri.empty()) return;
+        if (mavlinkOutput.open(uri, sysid, compid)) {
+            ROS_INFO_STREAM("Sending RTCM as MAVLink to " << uri);
+        } else {
+            ROS_ERROR_STREAM("Cannot send MAVLink to " << uri);
+        }
+        if (!rtcmTopic && !mavlinkOutput.isOpen()) {
+            ROS_WARN("No RTCM output left, publishing the RTCM topic");
+            rtcmTopic = true;
+        }
+    };
+
+    int callback(GPSCallbackType type, void *data1, int data2)
+    {
+        return rtk_ros::dispatchDriverCallback(*transport, *this, type, data1, data2);
+    };
+
+    /** Bytes read from the receiver, messages the driver does not decode are picked up here */
+    void onDeviceData(const uint8_t *data, int len) {
+        streamDemux.parse(data, len, *this);
+    };
+
+    /** RTCM frames are published through the driver (gotRTCMData), decoded here for monitoring only */
+    void onRtcmFrame(const uint8_t *frame, size_t len) {
+        if (rtcmMonitorEnabled && rtcmMonitor.onFrame(frame, len, ros::WallTime::now().toSec())) {
+            rtcmQualityUpdated = true;
+        }
+    };
+
+    void setRtcmMonitor(bool enable) {
+        rtcmMonitorEnabled = enable;
+    };
+
+    void onNmeaSentence(const char *sentence, size_t len) {
+        ROS_DEBUG_STREAM_THROTTLE(10, "NMEA on the receiver port: " << std::string(sentence, len > 2 ? len - 2 : len));
+    };
+
+    void logStreamCounters() const {
+        const rtk_ros::StreamDemux::Counters &c = streamDemux.counters();
+        ROS_DEBUG_STREAM("Receiver stream (frames/bytes/errors): UBX " << c.ubx.frames << "/" << c.ubx.bytes << "/" << c.ubx.errors
+            << ", RTCM " << c.rtcm.frames << "/" << c.rtcm.bytes << "/" << c.rtcm.errors
+            << ", NMEA " << c.nmea.frames << "/" << c.nmea.bytes << "/" << c.nmea.errors
+            << ", " << c.unknown_bytes << " unknown bytes");
+        ROS_DEBUG_STREAM("Satellite table: " << satTable.truncated << " epochs truncated to " << satTable.CAPACITY
+            << " SVs, " << satTable.unknown_svs << " unknown NAV-SVINFO SVs skipped");
+        if (mavlinkOutput.isOpen()) {
+            const rtk_ros::MavlinkRtcmOutput::Counters &m = mavlinkOutput.counters();
+            ROS_DEBUG_STREAM("MAVLink RTCM: " << m.messages << " messages in " << m.packets << " packets, " << m.bytes
+                << " bytes, " << m.too_long << " too long, " << m.would_block << " would block, " << m.send_errors << " send errors, payload efficiency "
+                << 100.0 * m.efficiency() << " %");
+            const rtk_ros::RtcmOutputQueue::Counters &q = rtcmOutputQueue.counters();
+            ROS_DEBUG_STREAM("RTCM output queue (" << rtk_ros::outputPolicyName(rtcmOutputQueue.outputPolicy()) << "): "
+                << q.sent << "/" << q.messages << " messages sent, " << q.blocked << " blocked, dropped "
+                << q.dropped_oldest << " oldest, " << q.stale_messages << " in " << q.stale_epochs << " stale epochs, "
+                << q.expired << " expired, depth " << rtcmOutputQueue.depth() << "/" << q.max_depth);
+            if (packDelay > 0.0) {
+                const rtk_ros::RtcmPacker::Counters &p = rtcmPacker.counters();
+                ROS_DEBUG_STREAM("RTCM packing: " << p.frames << " frames of " << p.epochs << " epochs in "
+                    << p.messages << " messages, " << p.too_long << " too long");
+            }
+        }
+        if (standbyTransport) {
+            const rtk_ros::BaseFailover::Counters &f = baseFailover.counters();
+            for (uint8_t b = 0; b < rtk_ros::BASE_SOURCES; b++) {
+                const rtk_ros::BaseFailover::Health &h = baseFailover.health(b);
+                ROS_DEBUG_STREAM("Base " << rtk_ros::baseSourceName(b) << (b == baseFailover.active() ? " (active)" : "")
+                    << ": " << (h.healthy ? "healthy" : "unhealthy") << ", " << f.epochs[b] << " epochs at " << h.epoch_rate
+                    << "/s, " << h.crc_rate << " CRC errors/s, survey " << (h.survey_active ? "active" : "inactive")
+                    << (h.survey_valid ? " valid" : ""));
             }
-            default: {
-                ROS_FATAL_STREAM("Do nothing? " << (int)type);
-                break;
+            ROS_DEBUG_STREAM("Base failover: " << f.switches << " switches, " << f.forwarded << " frames forwarded, "
+                << f.held_overflow << " epochs too large to hold");
+        }
+        if (sharedMemory.isOpen()) {
+            const rtk_ros::SharedMemoryWriter::Counters &m = sharedMemory.counters();
+            ROS_DEBUG_STREAM("Shared memory: " << m.frames << " frames, " << m.bytes << " bytes, "
+                << m.too_long << " too long, " << m.snapshots << " snapshots");
+        }
+        if (mavlinkMsm4 || topicMsm4) {
+            const rtk_ros::Msm4Downgrade::Counters &d = msm4Downgrade.counters();
+            ROS_DEBUG_STREAM("MSM7 to MSM4: " << d.converted << "/" << d.frames << " frames, " << d.bytes_in << " -> "
+                << d.bytes_out << " bytes, " << d.errors << " undecodable");
+        }
+        if (rtcmScheduler.enabled()) {
+            for (uint8_t c = 0; c < rtk_ros::RTCM_CLASS_COUNT; c++) {
+                const rtk_ros::RtcmScheduler::ClassCounters &r = rtcmScheduler.counters(c);
+                if (r.frames == 0) continue;
+                ROS_DEBUG_STREAM("RTCM " << rtk_ros::rtcmClassName(c) << ": " << r.sent << "/" << r.frames << " frames sent, "
+                    << r.sent_bytes << " bytes, shed " << r.stale << " stale, " << r.superseded << " superseded, "
+                    << r.overflow << " overflow, max delay " << r.max_delay << " s");
             }
         }
+    };
 
-        return 0;
+    void onSurveyInStatus(const SurveyInStatus &status) {
+        // The driver's status lives on its stack, keep a copy
+        surveyInStatus = status;
+        ROS_DEBUG_STREAM("Survey-in status: " << surveyInStatus.duration  << " cur accuracy: " << surveyInStatus.mean_accuracy 
+                << " valid:" << (int)(surveyInStatus.flags & 1) << " active: " << (int)((surveyInStatus.flags>>1) & 1));
+        if (!navSvinReceived) {
+            // NAV-SVIN not seen by the node parser, publish what the driver reports
+            surveyIn.duration = surveyInStatus.duration;
+            surveyIn.mean_accuracy = surveyInStatus.mean_accuracy * 1e-3f;
+            surveyIn.valid = surveyInStatus.flags & 1;
+            surveyIn.active = (surveyInStatus.flags >> 1) & 1;
+            surveyUpdated = true;
+        }
+    };
+
+    void onSetClock(const timespec &time) {
+        (void)time;
+        ROS_DEBUG("Set clock");
     };
 
 
     bool connected;
 private:
+    /** UBX messages decoded by the node, the driver handles the rest */
+    typedef rtk_ros::ubx::UbxDispatcher<RTKNode,
+            rtk_ros::ubx::NavPvt,
+            rtk_ros::ubx::NavSat,
+            rtk_ros::ubx::NavSvin,
+            rtk_ros::ubx::NavHpposecef,
+            rtk_ros::ubx::MonHw,
+            rtk_ros::ubx::MonRf,
+            rtk_ros::ubx::RxmRawx,
+            rtk_ros::ubx::RxmSfrbx> UbxDispatch;
+
+
     ros::Publisher GPSPublisher;
     ros::Publisher RTCMPublisher;
+    ros::Publisher SatellitesPublisher;
+    ros::Publisher StatisticsPublisher;
+    ros::Publisher DopPublisher;
+    ros::Publisher InterferencePublisher;
+    ros::Publisher SurveyPublisher;
+    ros::Publisher RawPublisher;
+    ros::Publisher RtcmQualityPublisher;
     ros::NodeHandle * nh;
     unsigned baud;
     std::string port;
     float surveyAccuracy;
     float surveyDuration;
-    SurveyInStatus* surveyInStatus = nullptr;
+    SurveyInStatus surveyInStatus;
+    rtk_ros::DriverLoader driverLoader;
     GPSHelper* gpsDriver = nullptr;
-    serial::Serial* serial = nullptr;
+    rtk_ros::DriverAdapterBase* driverAdapter = nullptr;
+    rtk_ros::Transport* transport = nullptr;
+    /** Sniffing time per baudrate, long enough for two 1 Hz NMEA or MTK epochs */
+    static const int DETECT_WINDOW_MS = 2200;
+    rtk_ros::GpsProtocol protocol = rtk_ros::GpsProtocol::UBX;
+    bool autodetectProtocol = false;
+    std::string protocolCacheFile;
 	struct vehicle_gps_position_s	reportGPSPos;
 	struct satellite_info_s		*pReportSatInfo = nullptr;
+    rtk_ros::StreamDemux streamDemux;
+    rtk_ros::SatelliteTable satTable;
+    rtk_ros::Satellites satellitesMsg;
+    bool satellitesUpdated = false;
+    bool navSatReceived = false;
+    rtk_ros::SignalStatistics signalStatistics;
+    rtk_ros::SignalStatistics::Result statisticsResults[rtk_ros::SignalStatistics::SLOTS];
+    rtk_ros::SatelliteStatistics statisticsMsg;
+    double statisticsPeriod = 5.0;
+    ros::Time lastStatisticsPublish;
+    uint16_t measurementPeriod = 0;
+    rtk_ros::SkyGeometry skyGeometry;
+    rtk_ros::Dop dopMsg;
+    rtk_ros::InterferenceMonitor interferenceMonitor;
+    bool gateRTCMOnSpoofing = false;
+    uint32_t rtcmFramesGated = 0;
+    rtk_ros::MavlinkRtcmOutput mavlinkOutput;
+    rtk_ros::RtcmPacker rtcmPacker;
+    rtk_ros::RtcmOutputQueue rtcmOutputQueue;
+    rtk_ros::Msm4Downgrade msm4Downgrade;
+    /** MSM4 sizes of frames queued as MSM7 for the scheduler, its counters are not logged */
+    rtk_ros::Msm4Downgrade budgetDowngrade;
+    bool mavlinkMsm4 = false;
+    bool topicMsm4 = false;
+    uint64_t rtcmDropsReported = 0;
+    rtk_ros::RtcmScheduler rtcmScheduler;
+    uint64_t rtcmShedReported = 0;
+
+    /** Failover output, the active base's frames */
+    struct FailoverSink {
+        RTKNode &node;
+        void send(const uint8_t *data, size_t len) { node.forwardRtcm(data, len); }
+    };
+
+    /** Standby base stream: RTCM to the failover, NAV-SVIN for its survey state */
+    struct StandbyHandler {
+        RTKNode &node;
+
+        void onUbxMessage(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len) {
+            if (msgClass == rtk_ros::ubx::CLASS_NAV && msgId == rtk_ros::ubx::ID_NAV_SVIN
+                    && node.standbySurvey.decodeNavSvin(payload, len)) {
+                node.baseFailover.setSurvey(rtk_ros::BASE_STANDBY, node.standbySurvey.active, node.standbySurvey.valid);
+            }
+        }
+
+        void onNmeaSentence(const char *, size_t) {}
+
+        void onRtcmFrame(const uint8_t *frame, size_t len) {
+            FailoverSink sink = {node};
+            node.baseFailover.onFrame(rtk_ros::BASE_STANDBY, frame, len, ros::WallTime::now().toSec(), sink);
+        }
+    };
+
+    /** Scheduler output */
+    struct RtcmSink {
+        RTKNode &node;
+        void send(const uint8_t *data, size_t len) { node.outputRtcm(data, len); }
+    };
+
+    /** Packed or single RTCM messages into the MAVLink output queue */
+    struct MavlinkQueueInput {
+        rtk_ros::RtcmOutputQueue &queue;
+        double now;
+        void send(const uint8_t *data, size_t len) { queue.push(data, len, now); }
+    };
+
+    /** Output queue to the socket, a message refused on a full buffer is kept for later */
+    struct MavlinkQueueOutput {
+        rtk_ros::MavlinkRtcmOutput &output;
+        bool send(const uint8_t *data, size_t len) { return output.send(data, len) || !output.wouldBlock(); }
+        bool wait(double timeout) { return output.waitWritable(timeout); }
+    };
+    double packDelay = 0.0;
+    bool rtcmTopic = true;
+    rtk_ros::SurveyIn surveyIn;
+    rtk_ros::SurveyPredictor surveyPredictor;
+    bool surveyUpdated = false;
+    bool navSvinReceived = false;
+    rtk_ros::RawEpoch rawEpoch;
+    rtk_ros::NavSubframe navSubframe;
+    rtk_ros::RawObservations rawMsg;
+    rtk_ros::RawLogger rawLogger;
+    bool rawPublish = false;
+    bool rawUpdated = false;
+    rtk_ros::RtcmMonitor rtcmMonitor;
+    rtk_ros::Transport *standbyTransport = nullptr;
+    rtk_ros::StreamDemux standbyDemux;
+    StandbyHandler standbyHandler{*this};
+    rtk_ros::SurveyIn standbySurvey;
+    rtk_ros::BaseFailover baseFailover;
+    uint8_t reportedBase = rtk_ros::BASE_PRIMARY;
+    double standbyConnectTime = -1e9;
+    static constexpr double STANDBY_RETRY_PERIOD = 5.0;
+    rtk_ros::SharedMemoryWriter sharedMemory;
+    rtk_ros::RtcmQuality rtcmQualityMsg;
+    bool rtcmMonitorEnabled = true;
+    bool rtcmQualityUpdated = false;
+    rtk_ros::BaseEstimator baseEstimator;
+    rtk_ros::TowClock towClock;
+    bool hostEstimation = false;
+    bool hpposecefReceived = false;
+    bool basePositionSent = false;
+    rtk_ros::FixedPosition fixedPosition;
+    bool fixedPositionSet = false;
 };
@@ -0,0 +1,145 @@
+/**
+ * @file satellite_table.hpp
+ * Structure-of-arrays satellite table decoded from UBX-NAV-SAT.
+ * Unlike satellite_info_s it is not limited to 20 entries; the capacity is
+ * set at compile time with RTK_SAT_TABLE_CAPACITY.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ubx_protocol.hpp"
+
+#ifndef RTK_SAT_TABLE_CAPACITY
+#define RTK_SAT_TABLE_CAPACITY 64
+#endif
+
+namespace rtk_ros {
+
+/** u-blox gnssId values */
+enum GnssId : uint8_t {
+    GNSS_GPS = 0,
+    GNSS_SBAS = 1,
+    GNSS_GALILEO = 2,
+    GNSS_BEIDOU = 3,
+    GNSS_IMES = 4,
+    GNSS_QZSS = 5,
+    GNSS_GLONASS = 6,
+    GNSS_COUNT = 7
+};
+
+template <size_t Capacity>
+struct SatelliteTableT {
+    static const size_t CAPACITY = Capacity;
+
+    uint32_t itow = 0;          ///< GPS time of week of the epoch [ms]
+    uint8_t num_svs = 0;        ///< number of SVs reported by the receiver
+    uint16_t count = 0;         ///< number of SVs stored, min(num_svs, CAPACITY)
+    uint32_t truncated = 0;     ///< epochs where num_svs exceeded CAPACITY
+    uint32_t unknown_svs = 0;   ///< NAV-SVINFO entries with an SV number of no known GNSS, skipped
+
+    uint8_t gnss_id[Capacity];
+    uint8_t sv_id[Capacity];
+    uint8_t cno[Capacity];      ///< [dBHz]
+    int8_t elevation[Capacity]; ///< [deg], -91 when unknown
+    int16_t azimuth[Capacity];  ///< [deg]
+    int16_t pr_res[Capacity];   ///< pseudorange residual [0.1 m]
+    uint8_t quality[Capacity];  ///< signal quality indicator (0..7)
+    uint8_t used[Capacity];     ///< 1 when the SV is used for navigation
+    uint8_t health[Capacity];   ///< 0 unknown, 1 healthy, 2 unhealthy
+    uint8_t diff_corr[Capacity];///< 1 when differential corrections are available
+
+    /**
+     * Decode a NAV-SAT payload in place. Nothing is allocated: entries beyond
+     * CAPACITY are dropped and counted in truncated.
+     * @return false if the payload is malformed
+     */
+    bool decodeNavSat(const uint8_t *payload, size_t len) {
+        static const size_t HEADER = 8;
+        static const size_t BLOCK = 12;
+
+        if (len < HEADER) return false;
+        uint8_t n = payload[5];
+        if (len < HEADER + BLOCK * n) return false;
+
+        itow = ubx::readU4(payload);
+        num_svs = n;
+        count = n < Capacity ? n : (uint16_t)Capacity;
+        if (n > Capacity) ++truncated;
+
+        const uint8_t *sv = payload + HEADER;
+        for (uint16_t i = 0; i < count; i++, sv += BLOCK) {
+            uint32_t flags = ubx::readU4(sv + 8);
+            gnss_id[i] = sv[0];
+            sv_id[i] = sv[1];
+            cno[i] = sv[2];
+            elevation[i] = (int8_t)sv[3];
+            azimuth[i] = ubx::readI2(sv + 4);
+            pr_res[i] = ubx::readI2(sv + 6);
+            quality[i] = flags & 0x07;
+            used[i] = (flags >> 3) & 0x01;
+            health[i] = (flags >> 4) & 0x03;
+            diff_corr[i] = (flags >> 6) & 0x01;
+        }
+        return true;
+    }
+
+    /**
+     * Fill the table from the driver's satellite_info_s, for receivers without NAV-SAT.
+     * The driver reports NAV-SVINFO numbering, which is mapped back to gnssId/svId;
+     * SV numbers outside the NAV-SVINFO ranges are skipped and counted in unknown_svs.
+     */
+    template <typename SatelliteInfo>
+    void fromSatelliteInfo(const SatelliteInfo &info) {
+        uint16_t known = 0;
+        count = 0;
+        for (uint16_t j = 0; j < info.count; j++) {
+            uint8_t gnss, sv;
+            if (!splitSvinfoId(info.svid[j], gnss, sv)) {
+                ++unknown_svs;
+                continue;
+            }
+            if (known++ >= Capacity) continue;
+            const uint16_t i = count++;
+            gnss_id[i] = gnss;
+            sv_id[i] = sv;
+            cno[i] = info.snr[j];
+            elevation[i] = (int8_t)info.elevation[j];
+            // satellite_info_s keeps the azimuth in 0..255 for 0..360 deg
+            azimuth[i] = (int16_t)(info.azimuth[j] * 360 / 255);
+            pr_res[i] = 0;
+            quality[i] = 0;
+            used[i] = info.used[j] ? 1 : 0;
+            health[i] = 0;
+            diff_corr[i] = 0;
+        }
+        num_svs = (uint8_t)known;
+        if (known > Capacity) ++truncated;
+    }
+
+    /** @return false if svid is in none of the NAV-SVINFO ranges */
+    static bool splitSvinfoId(uint8_t svid, uint8_t &gnss, uint8_t &sv) {
+        if (svid >= 1 && svid <= 32) { gnss = GNSS_GPS; sv = svid; }
+        else if (svid >= 33 && svid <= 64) { gnss = GNSS_BEIDOU; sv = svid - 27; }
+        else if (svid >= 65 && svid <= 96) { gnss = GNSS_GLONASS; sv = svid - 64; }
+        else if (svid >= 120 && svid <= 158) { gnss = GNSS_SBAS; sv = svid; }
+        else if (svid >= 159 && svid <= 163) { gnss = GNSS_BEIDOU; sv = svid - 158; }
+        else if (svid >= 173 && svid <= 182) { gnss = GNSS_IMES; sv = svid - 172; }
+        else if (svid >= 193 && svid <= 197) { gnss = GNSS_QZSS; sv = svid - 192; }
+        else if (svid >= 211 && svid <= 246) { gnss = GNSS_GALILEO; sv = svid - 210; }
+        else return false;
+        return true;
+    }
+
+    uint16_t usedCount() const {
+        uint16_t n = 0;
+        for (uint16_t i = 0; i < count; i++) n += used[i];
+        return n;
+    }
+};
+
+typedef SatelliteTableT<RTK_SAT_TABLE_CAPACITY> SatelliteTable;
+
+} // namespace rtk_ros
@@ -0,0 +1,265 @@
+/**
+ * @file shared_memory.hpp
+ * RTCM frames and the latest position in POSIX shared memory, for local
+ * consumers that do not use ROS (see shared_memory_client.hpp).
+ *
+ * The segment (shm_open name, e.g. "/rtk_ros") holds:
+ *
+ *   a byte ring of RTCM frames, one writer and any number of readers: each
+ *   record is a RecordHeader and the frame, padded to 8 bytes, and never
+ *   wraps (a PAD record or less than a header fills the end of the ring).
+ *   The writer first advances reserve_pos over the record it is about to
+ *   write, then write_pos once it is written. Readers keep their own
+ *   position and check reserve_pos after copying a record: if the writer
+ *   came within a ring of it, the copy may be torn and the reader skips to
+ *   write_pos. Nobody waits on anybody.
+ *
+ *   a snapshot of the latest position and survey-in under a seqlock: the
+ *   sequence is odd while the writer updates it, readers retry until they
+ *   copied it with the same even sequence before and after.
+ *
+ * Times are CLOCK_MONOTONIC [ns]. A node restarting creates a new segment
+ * and marks the previous one STATE_CLOSED, readers then reopen the name.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <string>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rtcm3_protocol.hpp"
+
+namespace rtk_ros {
+namespace shm {
+
+static const uint32_t MAGIC = 0x4D4B5452;  ///< "RTKM"
+static const uint32_t VERSION = 1;
+static const uint32_t STATE_OPEN = 1;
+static const uint32_t STATE_CLOSED = 2;
+
+/** Ring size [bytes], a power of two: several seconds of corrections */
+static const size_t RING_SIZE = 1 << 16;
+static const size_t MAX_FRAME_LENGTH = rtcm3::MAX_PAYLOAD_LENGTH + rtcm3::FRAME_OVERHEAD;
+
+static const uint16_t RECORD_PAD = 0;
+static const uint16_t RECORD_RTCM = 1;
+
+struct RecordHeader {
+    uint64_t sequence;      ///< frame counter of the writer, gaps are frames a reader lost
+    uint64_t time;          ///< [ns]
+    uint16_t length;        ///< of the frame following the header [bytes]
+    uint16_t type;
+    uint32_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 24, "RecordHeader must not be padded");
+
+inline size_t recordLength(size_t frameLength)
+{
+    return (sizeof(RecordHeader) + frameLength + 7) & ~(size_t)7;
+}
+
+struct Position {
+    uint64_t time = 0;              ///< [ns], 0 before the first fix
+    uint64_t time_utc_usec = 0;
+    int32_t lat = 0;                ///< [1e-7 deg]
+    int32_t lon = 0;                ///< [1e-7 deg]
+    int32_t alt = 0;                ///< MSL [mm]
+    int32_t alt_ellipsoid = 0;      ///< [mm]
+    float eph = 0.f;                ///< [m]
+    float epv = 0.f;                ///< [m]
+    float hdop = 0.f;
+    float vdop = 0.f;
+    uint8_t fix_type = 0;
+    uint8_t satellites_used = 0;
+    uint8_t reserved[6] = {0, 0, 0, 0, 0, 0};
+};
+
+struct Survey {
+    uint64_t time = 0;              ///< [ns], 0 before the first NAV-SVIN
+    double mean_ecef[3] = {0.0, 0.0, 0.0};  ///< [m]
+    float mean_accuracy = 0.f;      ///< [m]
+    uint32_t duration = 0;          ///< [s]
+    uint32_t observations = 0;
+    uint8_t active = 0;
+    uint8_t valid = 0;
+    uint8_t reserved[2] = {0, 0};
+};
+
+struct Snapshot {
+    Position position;
+    Survey survey;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+    "the segment needs address-free atomics");
+
+struct Segment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    uint32_t writer_pid;
+    std::atomic<uint32_t> state;
+
+    alignas(64) std::atomic<uint64_t> write_pos;    ///< end of the last record written
+    std::atomic<uint64_t> reserve_pos;              ///< end of the record being written
+
+    alignas(64) std::atomic<uint32_t> snapshot_sequence;
+    Snapshot snapshot;
+
+    alignas(64) uint8_t ring[RING_SIZE];
+};
+
+inline uint64_t monotonicTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+} // namespace shm
+
+class SharedMemoryWriter
+{
+public:
+    struct Counters {
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t too_long = 0;
+        uint64_t snapshots = 0;
+    };
+
+    ~SharedMemoryWriter() { close(); }
+
+    /** Create the segment name, replacing (and closing) one left by a previous node */
+    bool open(const std::string &_name) {
+        close();
+        closeStale(_name);
+        shm_unlink(_name.c_str());
+        const int fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        void *p = MAP_FAILED;
+        if (ftruncate(fd, sizeof(shm::Segment)) == 0) {
+            p = mmap(nullptr, sizeof(shm::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            shm_unlink(_name.c_str());
+            return false;
+        }
+        // ftruncate zero-filled it, the atomics only need constructing
+        segment = new (p) shm::Segment;
+        segment->version = shm::VERSION;
+        segment->ring_size = shm::RING_SIZE;
+        segment->writer_pid = (uint32_t)getpid();
+        segment->write_pos.store(0, std::memory_order_relaxed);
+        segment->reserve_pos.store(0, std::memory_order_relaxed);
+        segment->snapshot_sequence.store(0, std::memory_order_relaxed);
+        segment->snapshot = snapshot;
+        segment->state.store(shm::STATE_OPEN, std::memory_order_relaxed);
+        // Readers check the magic last
+        std::atomic_thread_fence(std::memory_order_release);
+        segment->magic = shm::MAGIC;
+        name = _name;
+        position = 0;
+        return true;
+    }
+
+    /** Mark the segment closed and remove its name, mapped readers keep their copy */
+    void close() {
+        if (!segment) return;
+        segment->state.store(shm::STATE_CLOSED, std::memory_order_release);
+        munmap(segment, sizeof(shm::Segment));
+        shm_unlink(name.c_str());
+        segment = nullptr;
+    }
+
+    bool isOpen() const { return segment != nullptr; }
+
+    /** Append a complete frame to the ring */
+    void writeFrame(const uint8_t *frame, size_t len) {
+        if (!segment) return;
+        if (len > shm::MAX_FRAME_LENGTH) {
+            ++count.too_long;
+            return;
+        }
+        const size_t length = shm::recordLength(len);
+        const size_t offset = position & (shm::RING_SIZE - 1);
+        const size_t remaining = shm::RING_SIZE - offset;
+        const size_t skip = length > remaining ? remaining : 0;
+        const uint64_t end = position + skip + length;
+
+        segment->reserve_pos.store(end, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        shm::RecordHeader header = {count.frames, shm::monotonicTime(), 0, shm::RECORD_PAD, 0};
+        if (skip >= sizeof(header)) memcpy(segment->ring + offset, &header, sizeof(header));
+        header.length = (uint16_t)len;
+        header.type = shm::RECORD_RTCM;
+        uint8_t *record = segment->ring + ((position + skip) & (shm::RING_SIZE - 1));
+        memcpy(record, &header, sizeof(header));
+        memcpy(record + sizeof(header), frame, len);
+        segment->write_pos.store(end, std::memory_order_release);
+
+        position = end;
+        ++count.frames;
+        count.bytes += len;
+    }
+
+    void writePosition(const shm::Position &_position) {
+        snapshot.position = _position;
+        snapshot.position.time = shm::monotonicTime();
+        publishSnapshot();
+    }
+
+    void writeSurvey(const shm::Survey &survey) {
+        snapshot.survey = survey;
+        snapshot.survey.time = shm::monotonicTime();
+        publishSnapshot();
+    }
+
+    const Counters &counters() const { return count; }
+
+private:
+    void publishSnapshot() {
+        if (!segment) return;
+        const uint32_t sequence = segment->snapshot_sequence.load(std::memory_order_relaxed);
+        segment->snapshot_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        segment->snapshot = snapshot;
+        segment->snapshot_sequence.store(sequence + 2, std::memory_order_release);
+        ++count.snapshots;
+    }
+
+    /** A segment of a node that did not close it, readers would otherwise wait on it forever */
+    static void closeStale(const std::string &_name) {
+        const int fd = shm_open(_name.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shm::Segment)) {
+            void *p = mmap(nullptr, sizeof(shm::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                shm::Segment *stale = (shm::Segment *)p;
+                if (stale->magic == shm::MAGIC) stale->state.store(shm::STATE_CLOSED, std::memory_order_release);
+                munmap(p, sizeof(shm::Segment));
+            }
+        }
+        ::close(fd);
+    }
+
+    shm::Segment *segment = nullptr;
+    std::string name;
+    uint64_t position = 0;
+    shm::Snapshot snapshot;
+    Counters count;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,171 @@
+/**
+ * @file shared_memory_client.hpp
+ * Reader of the segment rtk_node writes with shm/name set (shared_memory.hpp).
+ * Header-only, no ROS, link with -lrt on older glibc:
+ *
+ *   rtk_ros::SharedMemoryClient client;
+ *   if (!client.open("/rtk_ros")) ...;
+ *   rtk_ros::SharedMemoryClient::Frame frame;
+ *   while (client.readFrame(frame)) radio.write(frame.data, frame.length);
+ *   rtk_ros::shm::Snapshot snapshot;
+ *   if (client.snapshot(snapshot) && snapshot.position.fix_type >= 3) ...;
+ *   if (client.writerClosed()) client.open("/rtk_ros");
+ *
+ * A client starts at the frames written after open() and is never waited
+ * for: one that falls a whole ring behind skips to the newest frame, the
+ * frames it missed are counted in lost().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shared_memory.hpp"
+
+namespace rtk_ros {
+
+class SharedMemoryClient
+{
+public:
+    struct Frame {
+        uint64_t sequence;
+        uint64_t time;      ///< written at [ns], CLOCK_MONOTONIC
+        uint16_t length;
+        uint8_t data[shm::MAX_FRAME_LENGTH];
+    };
+
+    ~SharedMemoryClient() { close(); }
+
+    /** Map the segment read-only, false if it does not exist (yet) or is not compatible */
+    bool open(const std::string &name) {
+        close();
+        const int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) return false;
+        struct stat st;
+        void *p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shm::Segment)) {
+            p = mmap(nullptr, sizeof(shm::Segment), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        const shm::Segment *s = (const shm::Segment *)p;
+        const bool valid = s->magic == shm::MAGIC;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!valid || s->version != shm::VERSION || s->ring_size != shm::RING_SIZE) {
+            munmap(p, sizeof(shm::Segment));
+            return false;
+        }
+        segment = s;
+        position = segment->write_pos.load(std::memory_order_acquire);
+        nextSequence = 0;
+        synced = false;
+        return true;
+    }
+
+    void close() {
+        if (!segment) return;
+        munmap((void *)segment, sizeof(shm::Segment));
+        segment = nullptr;
+    }
+
+    bool isOpen() const { return segment != nullptr; }
+
+    /** The node closed the segment or was replaced by a new one, reopen */
+    bool writerClosed() const {
+        return !segment || segment->state.load(std::memory_order_acquire) != shm::STATE_OPEN;
+    }
+
+    /** Next frame, false if there is none yet */
+    bool readFrame(Frame &frame) {
+        if (!segment) return false;
+        for (;;) {
+            const uint64_t end = segment->write_pos.load(std::memory_order_acquire);
+            if (position == end) return false;
+            if (end - position > shm::RING_SIZE) {
+                skipToEnd();
+                continue;
+            }
+            const size_t offset = position & (shm::RING_SIZE - 1);
+            const size_t remaining = shm::RING_SIZE - offset;
+            shm::RecordHeader header;
+            if (remaining < sizeof(header)) {
+                position += remaining;
+                continue;
+            }
+            memcpy(&header, segment->ring + offset, sizeof(header));
+            const bool pad = header.type != shm::RECORD_RTCM;
+            const bool fits = header.length <= shm::MAX_FRAME_LENGTH
+                && shm::recordLength(header.length) <= remaining;
+            if (!pad && fits) memcpy(frame.data, segment->ring + offset + sizeof(header), header.length);
+
+            // Valid only if the writer did not start on this record meanwhile
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (segment->reserve_pos.load(std::memory_order_relaxed) - position > shm::RING_SIZE) {
+                skipToEnd();
+                continue;
+            }
+            if (pad) {
+                position += remaining;
+                continue;
+            }
+            if (!fits) {
+                // Not written by a compatible writer, nothing to resynchronize on
+                skipToEnd();
+                return false;
+            }
+            position += shm::recordLength(header.length);
+            if (synced && header.sequence > nextSequence) lostFrames += header.sequence - nextSequence;
+            synced = true;
+            nextSequence = header.sequence + 1;
+            frame.sequence = header.sequence;
+            frame.time = header.time;
+            frame.length = header.length;
+            return true;
+        }
+    }
+
+    /**
+     * Latest position and survey-in, false if the writer kept updating it.
+     * Check time of each part, 0 until the node has one.
+     */
+    bool snapshot(shm::Snapshot &out) const {
+        if (!segment) return false;
+        for (int attempt = 0; attempt < 100; attempt++) {
+            const uint32_t before = segment->snapshot_sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            memcpy((void *)&out, (const void *)&segment->snapshot, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (segment->snapshot_sequence.load(std::memory_order_relaxed) == before) return true;
+        }
+        return false;
+    }
+
+    /** Frames overwritten before this client read them */
+    uint64_t lost() const { return lostFrames; }
+    /** Times the client fell a ring behind */
+    uint64_t overruns() const { return overrunCount; }
+
+private:
+    void skipToEnd() {
+        ++overrunCount;
+        position = segment->write_pos.load(std::memory_order_acquire);
+    }
+
+    const shm::Segment *segment = nullptr;
+    uint64_t position = 0;
+    uint64_t nextSequence = 0;
+    bool synced = false;
+    uint64_t lostFrames = 0;
+    uint64_t overrunCount = 0;
+};
+
+} // namespace rtk_ros
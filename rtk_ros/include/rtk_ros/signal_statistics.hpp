@@ -0,0 +1,192 @@
+/**
+ * @file signal_statistics.hpp
+ * Per-satellite rolling C/N0, elevation and used-flag statistics.
+ *
+ * Every tracked SV owns a slot with fixed-size ring buffers laid out
+ * contiguously ([slot][sample]), so updating an epoch is O(SVs) and the
+ * window reductions are branch-free loops the compiler can vectorize.
+ * Reductions only run when the statistics are published.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "satellite_table.hpp"
+
+#ifndef RTK_SIGNAL_STATS_WINDOW
+#define RTK_SIGNAL_STATS_WINDOW 128
+#endif
+
+namespace rtk_ros {
+
+template <size_t Slots, size_t Window>
+class SignalStatisticsT
+{
+public:
+    static const size_t SLOTS = Slots;
+    static const size_t WINDOW = Window;
+    static const uint16_t FREE_SLOT = 0xFFFF;
+
+    struct Result {
+        uint8_t gnss_id;
+        uint8_t sv_id;
+        uint16_t samples;        ///< epochs the SV was tracked in the window
+        float cno_min;           ///< [dBHz]
+        float cno_mean;          ///< [dBHz]
+        float cno_variance;      ///< [dBHz^2]
+        float elevation_mean;    ///< [deg]
+        float used_ratio;        ///< fraction of tracked epochs used in the solution
+        uint16_t dropouts;       ///< tracked -> lost transitions in the window
+    };
+
+    SignalStatisticsT() { reset(); }
+
+    void reset() {
+        head = 0;
+        filled = 0;
+        for (size_t s = 0; s < Slots; s++) {
+            key[s] = FREE_SLOT;
+            lastSeen[s] = 0;
+        }
+        for (size_t i = 0; i < Slots * Window; i++) {
+            cno[i] = 0.f;
+            elevation[i] = 0.f;
+            tracked[i] = 0.f;
+            used[i] = 0.f;
+        }
+    }
+
+    /**
+     * Push one epoch. SVs that are not listed get an untracked sample,
+     * slots whose SV was not seen for a whole window are recycled.
+     */
+    template <typename Table>
+    void update(const Table &table) {
+        ++epoch;
+        for (size_t s = 0; s < Slots; s++) {
+            const size_t i = s * Window + head;
+            cno[i] = 0.f;
+            elevation[i] = 0.f;
+            tracked[i] = 0.f;
+            used[i] = 0.f;
+        }
+
+        for (uint16_t n = 0; n < table.count; n++) {
+            uint16_t k = (uint16_t)((table.gnss_id[n] << 8) | table.sv_id[n]);
+            size_t s = findSlot(k);
+            if (s == Slots) {
+                s = allocateSlot(k);
+                if (s == Slots) continue; // more SVs than slots
+            }
+            const size_t i = s * Window + head;
+            cno[i] = table.cno[n];
+            elevation[i] = table.elevation[n];
+            tracked[i] = table.cno[n] > 0 ? 1.f : 0.f;
+            used[i] = table.used[n] ? 1.f : 0.f;
+            lastSeen[s] = epoch;
+        }
+
+        for (size_t s = 0; s < Slots; s++) {
+            if (key[s] != FREE_SLOT && epoch - lastSeen[s] >= Window) key[s] = FREE_SLOT;
+        }
+
+        head = (head + 1) % Window;
+        if (filled < Window) ++filled;
+    }
+
+    /**
+     * Reduce the window of every active slot into out.
+     * @return number of results written (at most Slots)
+     */
+    size_t compute(Result *out) const {
+        size_t n = 0;
+        for (size_t s = 0; s < Slots; s++) {
+            if (key[s] == FREE_SLOT) continue;
+            const float *c = cno + s * Window;
+            const float *e = elevation + s * Window;
+            const float *t = tracked + s * Window;
+            const float *u = used + s * Window;
+
+            float count = 0.f, sum = 0.f, sumSq = 0.f, sumEl = 0.f, sumUsed = 0.f;
+            float minCno = NOT_TRACKED_CNO;
+            float drops = 0.f;
+            for (size_t i = 0; i < Window; i++) {
+                count += t[i];
+                sum += c[i] * t[i];
+                sumSq += c[i] * c[i] * t[i];
+                sumEl += e[i] * t[i];
+                sumUsed += u[i];
+                float masked = c[i] + (1.f - t[i]) * NOT_TRACKED_CNO;
+                minCno = masked < minCno ? masked : minCno;
+            }
+            // Transitions over the whole ring, minus the newest -> oldest pair across head.
+            // Samples not written yet are zero and never count as a dropout.
+            for (size_t i = 1; i < Window; i++) {
+                drops += t[i - 1] * (1.f - t[i]);
+            }
+            drops += t[Window - 1] * (1.f - t[0]);
+            const size_t newest = (head + Window - 1) % Window;
+            drops -= t[newest] * (1.f - t[head]);
+
+            Result &r = out[n++];
+            r.gnss_id = key[s] >> 8;
+            r.sv_id = key[s] & 0xFF;
+            r.samples = (uint16_t)count;
+            if (count > 0.f) {
+                float mean = sum / count;
+                r.cno_mean = mean;
+                r.cno_variance = sumSq / count - mean * mean;
+                if (r.cno_variance < 0.f) r.cno_variance = 0.f;
+                r.cno_min = minCno;
+                r.elevation_mean = sumEl / count;
+                r.used_ratio = sumUsed / count;
+            } else {
+                r.cno_mean = r.cno_variance = r.cno_min = r.elevation_mean = r.used_ratio = 0.f;
+            }
+            r.dropouts = drops > 0.f ? (uint16_t)(drops + 0.5f) : 0;
+        }
+        return n;
+    }
+
+    size_t windowFill() const { return filled; }
+
+private:
+    static constexpr float NOT_TRACKED_CNO = 255.f;
+
+    size_t findSlot(uint16_t k) const {
+        for (size_t s = 0; s < Slots; s++) {
+            if (key[s] == k) return s;
+        }
+        return Slots;
+    }
+
+    size_t allocateSlot(uint16_t k) {
+        for (size_t s = 0; s < Slots; s++) {
+            if (key[s] == FREE_SLOT) {
+                key[s] = k;
+                // Start from an empty history
+                for (size_t i = s * Window; i < (s + 1) * Window; i++) {
+                    cno[i] = elevation[i] = tracked[i] = used[i] = 0.f;
+                }
+                return s;
+            }
+        }
+        return Slots;
+    }
+
+    size_t head;
+    size_t filled;
+    uint32_t epoch = 0;
+    uint16_t key[Slots];        ///< (gnss_id << 8) | sv_id, FREE_SLOT when unused
+    uint32_t lastSeen[Slots];
+    float cno[Slots * Window];
+    float elevation[Slots * Window];
+    float tracked[Slots * Window];
+    float used[Slots * Window];
+};
+
+typedef SignalStatisticsT<RTK_SAT_TABLE_CAPACITY, RTK_SIGNAL_STATS_WINDOW> SignalStatistics;
+
+} // namespace rtk_ros
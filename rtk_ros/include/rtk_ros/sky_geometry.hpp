@@ -0,0 +1,234 @@
+/**
+ * @file sky_geometry.hpp
+ * Dilution of precision from the azimuth/elevation of the used satellites.
+ *
+ * Each constellation keeps its own 4x4 normal matrix sum(h * h^T) with
+ * h = [-cos(el) sin(az), -cos(el) cos(az), -sin(el), 1] in ENU. Satellites
+ * entering, leaving or moving only add/subtract their own contribution, and
+ * the multi-GNSS matrix (one clock per constellation) is assembled from the
+ * per-constellation blocks when DOPs are requested.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "satellite_table.hpp"
+
+namespace rtk_ros {
+
+struct DopValues {
+    float gdop, pdop, hdop, vdop, tdop;
+    uint16_t num_sv;
+    bool valid;
+};
+
+template <size_t Slots>
+class SkyGeometryT
+{
+public:
+    /** Rebuild the matrices from scratch every so many epochs to bound rounding drift */
+    static const uint32_t REBUILD_EPOCHS = 3600;
+    static const uint16_t FREE_SLOT = 0xFFFF;
+    static const size_t MAX_STATES = 3 + GNSS_COUNT;
+
+    SkyGeometryT() { reset(); }
+
+    void reset() {
+        for (size_t s = 0; s < Slots; s++) key[s] = FREE_SLOT;
+        for (size_t c = 0; c < GNSS_COUNT; c++) {
+            for (size_t i = 0; i < 10; i++) normal[c][i] = 0.0;
+            numSv[c] = 0;
+        }
+        epochs = 0;
+    }
+
+    /** Apply the difference between the previous and the new set of used satellites */
+    template <typename Table>
+    void update(const Table &table) {
+        if (++epochs % REBUILD_EPOCHS == 0) reset();
+
+        for (size_t s = 0; s < Slots; s++) seen[s] = false;
+
+        for (uint16_t n = 0; n < table.count; n++) {
+            if (!table.used[n] || table.gnss_id[n] >= GNSS_COUNT) continue;
+            if (table.elevation[n] < -90 || table.elevation[n] > 90) continue;
+
+            uint16_t k = (uint16_t)((table.gnss_id[n] << 8) | table.sv_id[n]);
+            size_t s = findSlot(k);
+            if (s == Slots) {
+                s = findSlot(FREE_SLOT);
+                if (s == Slots) continue;
+                key[s] = k;
+                setGeometry(s, table.gnss_id[n], table.azimuth[n], table.elevation[n]);
+                accumulate(s, 1.0);
+            } else if (azimuth[s] != table.azimuth[n] || elevation[s] != table.elevation[n]) {
+                accumulate(s, -1.0);
+                setGeometry(s, table.gnss_id[n], table.azimuth[n], table.elevation[n]);
+                accumulate(s, 1.0);
+            }
+            seen[s] = true;
+        }
+
+        for (size_t s = 0; s < Slots; s++) {
+            if (key[s] != FREE_SLOT && !seen[s]) {
+                accumulate(s, -1.0);
+                key[s] = FREE_SLOT;
+            }
+        }
+    }
+
+    /** DOPs of a single constellation (needs 4 satellites) */
+    DopValues constellation(uint8_t gnss) const {
+        DopValues dop;
+        dop.num_sv = numSv[gnss];
+        double a[4 * 4];
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 4; j++) a[i * 4 + j] = normal[gnss][index(i, j)];
+        }
+        double q[4];
+        dop.valid = numSv[gnss] >= 4 && inverseDiagonal(a, 4, q);
+        fill(dop, q, q[3]);
+        return dop;
+    }
+
+    /**
+     * DOPs of the combined solution with one receiver clock per constellation.
+     * TDOP refers to the clock of the constellation with the most used satellites.
+     */
+    DopValues combined() const {
+        DopValues dop;
+        size_t clocks[GNSS_COUNT];
+        size_t n_clocks = 0;
+        size_t reference = 0;
+        dop.num_sv = 0;
+        for (size_t c = 0; c < GNSS_COUNT; c++) {
+            if (numSv[c] == 0) continue;
+            if (n_clocks == 0 || numSv[c] > numSv[clocks[reference]]) reference = n_clocks;
+            clocks[n_clocks++] = c;
+            dop.num_sv += numSv[c];
+        }
+
+        const size_t n = 3 + n_clocks;
+        double a[MAX_STATES * MAX_STATES];
+        for (size_t i = 0; i < n * n; i++) a[i] = 0.0;
+        for (size_t k = 0; k < n_clocks; k++) {
+            const double *m = normal[clocks[k]];
+            for (size_t i = 0; i < 3; i++) {
+                for (size_t j = 0; j < 3; j++) a[i * n + j] += m[index(i, j)];
+                a[i * n + 3 + k] = a[(3 + k) * n + i] = m[index(i, 3)];
+            }
+            a[(3 + k) * n + 3 + k] = m[index(3, 3)];
+        }
+
+        double q[MAX_STATES];
+        dop.valid = n_clocks > 0 && dop.num_sv >= n && inverseDiagonal(a, n, q);
+        fill(dop, q, dop.valid ? q[3 + reference] : 0.0);
+        if (dop.valid) {
+            double clock_sum = 0.0;
+            for (size_t k = 0; k < n_clocks; k++) clock_sum += q[3 + k];
+            dop.gdop = (float)sqrt(q[0] + q[1] + q[2] + clock_sum);
+        }
+        return dop;
+    }
+
+    uint16_t satellites(uint8_t gnss) const { return numSv[gnss]; }
+
+private:
+    /** Packed upper triangle of a symmetric 4x4 matrix */
+    static size_t index(size_t i, size_t j) {
+        if (i > j) { size_t t = i; i = j; j = t; }
+        return i * 4 - i * (i + 1) / 2 + j;
+    }
+
+    size_t findSlot(uint16_t k) const {
+        for (size_t s = 0; s < Slots; s++) {
+            if (key[s] == k) return s;
+        }
+        return Slots;
+    }
+
+    void setGeometry(size_t s, uint8_t gnss, int16_t az, int8_t el) {
+        const double d2r = M_PI / 180.0;
+        double cos_el = cos(el * d2r);
+        constellationOf[s] = gnss;
+        azimuth[s] = az;
+        elevation[s] = el;
+        los[s][0] = -cos_el * sin(az * d2r);
+        los[s][1] = -cos_el * cos(az * d2r);
+        los[s][2] = -sin(el * d2r);
+    }
+
+    void accumulate(size_t s, double sign) {
+        const double h[4] = {los[s][0], los[s][1], los[s][2], 1.0};
+        double *m = normal[constellationOf[s]];
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = i; j < 4; j++) m[index(i, j)] += sign * h[i] * h[j];
+        }
+        numSv[constellationOf[s]] += sign > 0 ? 1 : -1;
+    }
+
+    /**
+     * Diagonal of the inverse of a symmetric positive definite n x n matrix
+     * through its Cholesky factor, a is overwritten.
+     */
+    static bool inverseDiagonal(double *a, size_t n, double *q) {
+        // a = L * L^T, L stored in the lower triangle
+        for (size_t j = 0; j < n; j++) {
+            double d = a[j * n + j];
+            for (size_t k = 0; k < j; k++) d -= a[j * n + k] * a[j * n + k];
+            if (d <= 1e-12) return false;
+            d = sqrt(d);
+            a[j * n + j] = d;
+            for (size_t i = j + 1; i < n; i++) {
+                double v = a[i * n + j];
+                for (size_t k = 0; k < j; k++) v -= a[i * n + k] * a[j * n + k];
+                a[i * n + j] = v / d;
+            }
+        }
+        // Columns of L^-1, diag(A^-1)_i = sum_k (L^-1)_ki^2
+        double inv[MAX_STATES * MAX_STATES];
+        for (size_t i = 0; i < n; i++) {
+            inv[i * n + i] = 1.0 / a[i * n + i];
+            for (size_t r = i + 1; r < n; r++) {
+                double v = 0.0;
+                for (size_t k = i; k < r; k++) v -= a[r * n + k] * inv[k * n + i];
+                inv[r * n + i] = v / a[r * n + r];
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            double sum = 0.0;
+            for (size_t k = i; k < n; k++) sum += inv[k * n + i] * inv[k * n + i];
+            q[i] = sum;
+        }
+        return true;
+    }
+
+    static void fill(DopValues &dop, const double *q, double clock) {
+        if (!dop.valid) {
+            dop.gdop = dop.pdop = dop.hdop = dop.vdop = dop.tdop = NAN;
+            return;
+        }
+        dop.hdop = (float)sqrt(q[0] + q[1]);
+        dop.vdop = (float)sqrt(q[2]);
+        dop.pdop = (float)sqrt(q[0] + q[1] + q[2]);
+        dop.tdop = (float)sqrt(clock);
+        dop.gdop = (float)sqrt(q[0] + q[1] + q[2] + clock);
+    }
+
+    uint16_t key[Slots];
+    bool seen[Slots];
+    uint8_t constellationOf[Slots];
+    int16_t azimuth[Slots];
+    int8_t elevation[Slots];
+    double los[Slots][3];
+    double normal[GNSS_COUNT][10];
+    int16_t numSv[GNSS_COUNT];
+    uint32_t epochs;
+};
+
+typedef SkyGeometryT<RTK_SAT_TABLE_CAPACITY> SkyGeometry;
+
+} // namespace rtk_ros
@@ -0,0 +1,217 @@
+/**
+ * @file stream_demux.hpp
+ * Single-pass demultiplexer for a receiver port carrying UBX, RTCM 3 and NMEA.
+ *
+ * Each read buffer is scanned once for the three preambles (0xB5 0x62, 0xD3,
+ * '$'). A candidate frame is only accepted once its length and checksum are
+ * valid, otherwise the scan resumes one byte later, so a preamble byte in
+ * line noise can't hide the frames after it. Complete frames are passed to
+ * the handler in place:
+ *
+ *   void onUbxMessage(uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t len);
+ *   void onRtcmFrame(const uint8_t *frame, size_t len);     preamble to CRC
+ *   void onNmeaSentence(const char *sentence, size_t len);  '$' to "\r\n"
+ *
+ * Only a frame split across two reads is copied, into a buffer of one
+ * maximum-size UBX frame.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "byte_scan.hpp"
+#include "rtcm3_protocol.hpp"
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+
+class StreamDemux
+{
+public:
+    struct ProtocolCounters {
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t errors = 0;    ///< checksum or length errors of plausible frames
+    };
+
+    struct Counters {
+        ProtocolCounters ubx;
+        ProtocolCounters rtcm;
+        ProtocolCounters nmea;
+        uint64_t unknown_bytes = 0;
+    };
+
+    /** Longest sentence accepted, NMEA allows 82 characters but PUBX and others are longer */
+    static const size_t MAX_NMEA_LENGTH = 128;
+
+    void reset() { pendingLength = 0; }
+
+    /** Feed the bytes of one read, handler callbacks are made before returning */
+    template <typename Handler>
+    void parse(const uint8_t *data, size_t len, Handler &handler) {
+        for (;;) {
+            if (pendingLength == 0) {
+                const size_t end = scan(data, len, handler);
+                memcpy(pending, data + end, len - end);
+                pendingLength = len - end;
+                return;
+            }
+
+            // Complete the frame carried over from the previous read
+            const size_t need = requiredLength(pending, pendingLength);
+            if (need > pendingLength) {
+                if (len == 0) return;
+                const size_t n = need - pendingLength < len ? need - pendingLength : len;
+                memcpy(pending + pendingLength, data, n);
+                pendingLength += n;
+                data += n;
+                len -= n;
+                continue;
+            }
+            const size_t end = scan(pending, pendingLength, handler);
+            memmove(pending, pending + end, pendingLength - end);
+            pendingLength -= end;
+        }
+    }
+
+    const Counters &counters() const { return count; }
+    size_t pendingBytes() const { return pendingLength; }
+
+private:
+    static const size_t INVALID = 0;
+    static const size_t PENDING_CAPACITY = ubx::MAX_PAYLOAD_LENGTH + ubx::FRAME_OVERHEAD;
+
+    /**
+     * Frame length announced by the header at data[0], or the number of bytes
+     * needed to know it. INVALID if the header rules out a frame.
+     */
+    static size_t requiredLength(const uint8_t *data, size_t avail) {
+        switch (data[0]) {
+            case ubx::SYNC1: {
+                if (avail < 2) return 2;
+                if (data[1] != ubx::SYNC2) return INVALID;
+                if (avail < ubx::HEADER_LENGTH) return ubx::HEADER_LENGTH;
+                const uint16_t length = ubx::readU2(data + 4);
+                if (length > ubx::MAX_PAYLOAD_LENGTH) return INVALID;
+                return length + ubx::FRAME_OVERHEAD;
+            }
+            case rtcm3::PREAMBLE:
+                if (avail < rtcm3::HEADER_LENGTH) return rtcm3::HEADER_LENGTH;
+                if (!rtcm3::validHeader(data)) return INVALID;
+                return rtcm3::payloadLength(data) + rtcm3::FRAME_OVERHEAD;
+            default: {
+                // NMEA, the length is only known at the line feed
+                size_t limit = MAX_NMEA_LENGTH;
+                if (avail < limit) limit = avail;
+                const void *lf = memchr(data, '\n', limit);
+                if (lf) return (const uint8_t *)lf - data + 1;
+                if (avail < MAX_NMEA_LENGTH) return MAX_NMEA_LENGTH;
+                return INVALID;
+            }
+        }
+    }
+
+    /**
+     * Dispatch the frames in data.
+     * @return offset of a frame that continues past len, len if there is none
+     */
+    template <typename Handler>
+    size_t scan(const uint8_t *data, size_t len, Handler &handler) {
+        size_t i = 0;
+        while (i < len) {
+            const size_t next = i + findAnyOf(data + i, len - i, ubx::SYNC1, rtcm3::PREAMBLE, '$');
+            count.unknown_bytes += next - i;
+            if (next >= len) return len;
+            i = next;
+
+            const size_t length = requiredLength(data + i, len - i);
+            if (length == INVALID) {
+                // A UBX sync pair is only rejected here for an oversized length
+                if (data[i] == ubx::SYNC1 && len - i >= 2 && data[i + 1] == ubx::SYNC2) ++count.ubx.errors;
+                ++count.unknown_bytes;
+                ++i;
+                continue;
+            }
+            if (length > len - i) return i;
+
+            if (dispatch(data + i, length, handler)) {
+                i += length;
+            } else {
+                ++count.unknown_bytes;
+                ++i;
+            }
+        }
+        return len;
+    }
+
+    /** Validate a complete candidate frame and hand it out, @return false if invalid */
+    template <typename Handler>
+    bool dispatch(const uint8_t *frame, size_t length, Handler &handler) {
+        switch (frame[0]) {
+            case ubx::SYNC1: {
+                uint8_t ck_a = 0, ck_b = 0;
+                fletcher8Update(frame + 2, length - 4, ck_a, ck_b);
+                if (frame[length - 2] != ck_a || frame[length - 1] != ck_b) {
+                    ++count.ubx.errors;
+                    return false;
+                }
+                ++count.ubx.frames;
+                count.ubx.bytes += length;
+                handler.onUbxMessage(frame[2], frame[3], frame + ubx::HEADER_LENGTH, (uint16_t)(length - ubx::FRAME_OVERHEAD));
+                return true;
+            }
+            case rtcm3::PREAMBLE:
+                if (!rtcm3::checkCrc(frame)) {
+                    ++count.rtcm.errors;
+                    return false;
+                }
+                ++count.rtcm.frames;
+                count.rtcm.bytes += length;
+                handler.onRtcmFrame(frame, length);
+                return true;
+            default:
+                if (!checkNmea(frame, length)) return false;
+                ++count.nmea.frames;
+                count.nmea.bytes += length;
+                handler.onNmeaSentence((const char *)frame, length);
+                return true;
+        }
+    }
+
+    /**
+     * "$...*hh\r\n" with the XOR of the characters between '$' and '*'. The reserved
+     * '$', '!' and '*' cannot appear in between: a pair of stray '$' before a sentence
+     * would cancel out of the XOR and hide the sentence behind it.
+     */
+    bool checkNmea(const uint8_t *sentence, size_t length) {
+        if (length < 6 || sentence[length - 2] != '\r' || sentence[length - 5] != '*') return false;
+        uint8_t sum = 0;
+        for (size_t i = 1; i < length - 5; i++) {
+            if (sentence[i] < 0x20 || sentence[i] > 0x7E) return false;
+            if (sentence[i] == '$' || sentence[i] == '!' || sentence[i] == '*') return false;
+            sum ^= sentence[i];
+        }
+        int expected = (hexDigit(sentence[length - 4]) << 4) | hexDigit(sentence[length - 3]);
+        if (expected != sum) {
+            ++count.nmea.errors;
+            return false;
+        }
+        return true;
+    }
+
+    static int hexDigit(uint8_t c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return 0x100; // never matches a checksum
+    }
+
+    Counters count;
+    size_t pendingLength = 0;
+    uint8_t pending[PENDING_CAPACITY];
+};
+
+} // namespace rtk_ros
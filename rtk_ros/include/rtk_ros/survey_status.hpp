@@ -0,0 +1,116 @@
+/**
+ * @file survey_status.hpp
+ * Survey-in progress decoded from UBX-NAV-SVIN and time-to-completion prediction.
+ *
+ * The survey-in accuracy of a static receiver shrinks roughly as a * t^b
+ * (b close to -0.5 for white noise, flatter while multipath decorrelates).
+ * SurveyPredictor fits log(accuracy) = log(a) + b * log(t) online with
+ * exponential forgetting and solves for the time the target is reached.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+
+struct SurveyIn {
+    uint32_t itow = 0;
+    uint32_t duration = 0;      ///< [s]
+    double mean_ecef[3] = {0.0, 0.0, 0.0}; ///< [m]
+    float mean_accuracy = 0.f;  ///< [m]
+    uint32_t observations = 0;
+    bool valid = false;
+    bool active = false;
+
+    /** NAV-SVIN payload (40 bytes) */
+    bool decodeNavSvin(const uint8_t *payload, size_t len) {
+        if (len < 40) return false;
+        itow = ubx::readU4(payload + 4);
+        duration = ubx::readU4(payload + 8);
+        for (int i = 0; i < 3; i++) {
+            // cm plus 0.1 mm high precision part
+            mean_ecef[i] = ubx::readI4(payload + 12 + 4 * i) * 1e-2 + (int8_t)payload[24 + i] * 1e-4;
+        }
+        mean_accuracy = ubx::readU4(payload + 28) * 1e-4f;
+        observations = ubx::readU4(payload + 32);
+        valid = payload[36] != 0;
+        active = payload[37] != 0;
+        return true;
+    }
+};
+
+class SurveyPredictor
+{
+public:
+    /** Samples needed before an ETA is given */
+    static const uint32_t MIN_SAMPLES = 10;
+
+    /** Predictions beyond this [s] are reported as unknown */
+    static constexpr double MAX_ETA = 7.0 * 24 * 3600;
+
+    /** Forgetting factor per sample, the fit follows the recent part of the curve */
+    float forgetting = 0.98f;
+
+    void reset() {
+        s_w = s_x = s_y = s_xx = s_xy = 0.0;
+        samples = 0;
+        lastDuration = 0;
+    }
+
+    SurveyPredictor() { reset(); }
+
+    /** Add a (duration [s], accuracy [m]) sample */
+    void update(uint32_t duration, float accuracy) {
+        if (duration < lastDuration) reset(); // survey restarted
+        lastDuration = duration;
+        if (duration == 0 || accuracy <= 0.f) return;
+
+        const double x = log((double)duration);
+        const double y = log((double)accuracy);
+        s_w = forgetting * s_w + 1.0;
+        s_x = forgetting * s_x + x;
+        s_y = forgetting * s_y + y;
+        s_xx = forgetting * s_xx + x * x;
+        s_xy = forgetting * s_xy + x * y;
+        ++samples;
+    }
+
+    /** Fitted exponent b, only meaningful once an ETA is available */
+    double slope() const {
+        const double det = s_w * s_xx - s_x * s_x;
+        return det > 1e-9 ? (s_w * s_xy - s_x * s_y) / det : 0.0;
+    }
+
+    /**
+     * Seconds until the survey should satisfy both the accuracy target and the
+     * minimum duration, or a negative value when the fit does not converge yet.
+     */
+    float eta(uint32_t duration, float accuracy, float target_accuracy, float min_duration) const {
+        const float remaining_duration = min_duration > duration ? min_duration - duration : 0.f;
+        if (accuracy > 0.f && accuracy <= target_accuracy) return remaining_duration;
+        if (samples < MIN_SAMPLES || target_accuracy <= 0.f) return -1.f;
+
+        const double det = s_w * s_xx - s_x * s_x;
+        if (det <= 1e-9) return -1.f;
+        const double b = (s_w * s_xy - s_x * s_y) / det;
+        const double a = (s_y - b * s_x) / s_w;
+        if (b >= -1e-3) return -1.f; // accuracy is not improving
+
+        const double t = exp((log((double)target_accuracy) - a) / b);
+        if (!(t < MAX_ETA)) return -1.f;
+        const double remaining_accuracy = t > duration ? t - duration : 0.0;
+        return (float)(remaining_accuracy > remaining_duration ? remaining_accuracy : remaining_duration);
+    }
+
+private:
+    double s_w, s_x, s_y, s_xx, s_xy;
+    uint32_t samples;
+    uint32_t lastDuration;
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,273 @@
+/**
+ * @file transport.hpp
+ * Byte transports to the receiver, selected by the URI given in the port parameter:
+ *
+ *   /dev/ttyACM0, serial:///dev/ttyACM0   serial port
+ *   tcp://host:port                       TCP client, e.g. ser2net
+ *   unix:///path/to/socket                Unix domain stream socket
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <serial/serial.h>
+
+namespace rtk_ros {
+
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    /** @return true if the transport is open afterwards */
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    /** Bytes that can be read without blocking */
+    virtual size_t available() = 0;
+    /** Wait until data can be read, @return false on timeout */
+    virtual bool waitReadable(int timeout_ms) = 0;
+    /** @return bytes read, negative on error */
+    virtual int read(uint8_t *data, size_t len) = 0;
+    /** @return bytes written, negative on error */
+    virtual int write(const uint8_t *data, size_t len) = 0;
+    /** Only meaningful for serial ports, remote ends keep their own baudrate */
+    virtual bool setBaudrate(unsigned baud) = 0;
+
+    virtual std::string name() const = 0;
+
+    /** Build the transport matching uri, nullptr if the scheme is unknown */
+    static Transport *create(const std::string &uri, unsigned baud);
+};
+
+class SerialTransport final : public Transport
+{
+public:
+    SerialTransport(const std::string &_port, unsigned _baud) : port(_port), baud(_baud) {}
+
+    bool open() override {
+        serial.setPort(port);
+        serial.setBaudrate(baud);
+        serial.setBytesize(serial::eightbits);
+        serial.setParity(serial::parity_none);
+        serial.setStopbits(serial::stopbits_one);
+        serial.setFlowcontrol(serial::flowcontrol_none);
+        setTimeout(DEFAULT_TIMEOUT_MS);
+        try {
+            serial.open();
+        } catch (serial::IOException) {
+            return false;
+        }
+        return serial.isOpen();
+    }
+
+    void close() override { serial.close(); }
+    bool isOpen() const override { return serial.isOpen(); }
+    size_t available() override { return serial.available(); }
+
+    bool waitReadable(int timeout_ms) override {
+        // serial::Serial waits for its read timeout, which then bounds read() as well
+        setTimeout(timeout_ms > 0 ? timeout_ms : 0);
+        return serial.waitReadable();
+    }
+
+    int read(uint8_t *data, size_t len) override { return (int)serial.read(data, len); }
+    int write(const uint8_t *data, size_t len) override { return (int)serial.write(data, len); }
+
+    bool setBaudrate(unsigned _baud) override {
+        baud = _baud;
+        serial.setBaudrate(baud);
+        return true;
+    }
+
+    std::string name() const override { return port; }
+
+private:
+    static const int DEFAULT_TIMEOUT_MS = 500;
+
+    void setTimeout(int timeout_ms) {
+        if (timeout_ms == timeoutMs) return;
+        serial::Timeout timeout = serial::Timeout::simpleTimeout((uint32_t)timeout_ms);
+        serial.setTimeout(timeout);
+        timeoutMs = timeout_ms;
+    }
+
+    serial::Serial serial;
+    std::string port;
+    unsigned baud;
+    int timeoutMs = -1;
+};
+
+/** Stream socket transport, the subclasses only differ in how they connect */
+class SocketTransport : public Transport
+{
+public:
+    ~SocketTransport() override { close(); }
+
+    void close() override {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool isOpen() const override { return fd >= 0; }
+
+    size_t available() override {
+        int bytes = 0;
+        if (fd < 0 || ioctl(fd, FIONREAD, &bytes) < 0) return 0;
+        return bytes > 0 ? (size_t)bytes : 0;
+    }
+
+    bool waitReadable(int timeout_ms) override {
+        if (fd < 0) return false;
+        struct pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        int ret;
+        do {
+            ret = poll(&p, 1, timeout_ms);
+        } while (ret < 0 && errno == EINTR);
+        return ret > 0;
+    }
+
+    int read(uint8_t *data, size_t len) override {
+        if (fd < 0) return -1;
+        ssize_t ret = ::recv(fd, data, len, MSG_DONTWAIT);
+        if (ret > 0) return (int)ret;
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+        // Peer closed the connection or the socket failed
+        close();
+        return -1;
+    }
+
+    int write(const uint8_t *data, size_t len) override {
+        size_t written = 0;
+        while (fd >= 0 && written < len) {
+            ssize_t ret = ::send(fd, data + written, len - written, MSG_NOSIGNAL);
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    struct pollfd p = {fd, POLLOUT, 0};
+                    poll(&p, 1, 100);
+                    continue;
+                }
+                close();
+                return -1;
+            }
+            written += ret;
+        }
+        return (int)written;
+    }
+
+    bool setBaudrate(unsigned baud) override {
+        (void)baud;
+        return true;
+    }
+
+protected:
+    int fd = -1;
+};
+
+class TcpTransport final : public SocketTransport
+{
+public:
+    TcpTransport(const std::string &_host, const std::string &_service) : host(_host), service(_service) {}
+
+    bool open() override {
+        close();
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *result = nullptr;
+        if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0) return false;
+
+        for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd < 0) continue;
+            if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+            ::close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(result);
+        if (fd < 0) return false;
+
+        // UBX configuration is request/acknowledge, don't let Nagle delay the requests
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    std::string name() const override { return "tcp://" + host + ":" + service; }
+
+private:
+    std::string host;
+    std::string service;
+};
+
+class UnixSocketTransport final : public SocketTransport
+{
+public:
+    explicit UnixSocketTransport(const std::string &_path) : path(_path) {}
+
+    bool open() override {
+        close();
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return false;
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    std::string name() const override { return "unix://" + path; }
+
+private:
+    std::string path;
+};
+
+inline Transport *Transport::create(const std::string &uri, unsigned baud)
+{
+    const std::string::size_type scheme_end = uri.find("://");
+    if (scheme_end == std::string::npos) return new SerialTransport(uri, baud);
+
+    const std::string scheme = uri.substr(0, scheme_end);
+    const std::string rest = uri.substr(scheme_end + 3);
+    if (scheme == "serial") return new SerialTransport(rest, baud);
+    if (scheme == "unix") return new UnixSocketTransport(rest);
+    if (scheme == "tcp") {
+        // host:port, or [v6 address]:port
+        const std::string::size_type colon = rest.rfind(':');
+        if (colon == std::string::npos || colon + 1 >= rest.size()) return nullptr;
+        std::string host = rest.substr(0, colon);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+        return new TcpTransport(host, rest.substr(colon + 1));
+    }
+    return nullptr;
+}
+
+} // namespace rtk_ros
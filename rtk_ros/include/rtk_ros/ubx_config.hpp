@@ -0,0 +1,182 @@
+/**
+ * @file ubx_config.hpp
+ * Constexpr UBX configuration messages.
+ *
+ * The CFG payloads the node sends are built by constexpr functions returning
+ * a Message, and configBlob() serializes any number of them, checksums
+ * included, into one contiguous ConstexprArray:
+ *
+ *   constexpr auto blob = ubx::configBlob(ubx::cfgMsg(ubx::CLASS_NAV, ubx::ID_NAV_SAT, 1),
+ *                                         ubx::cfgRate(200));
+ *   transport->write(blob.data, blob.size());
+ *
+ * Static configurations are therefore compile-time data whose exact bytes can
+ * be checked with static_assert, and the same functions build the messages
+ * that depend on parameters at run time.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <initializer_list>
+
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+namespace ubx {
+
+static const size_t CFG_MSG_LENGTH = 3;
+static const size_t CFG_RATE_LENGTH = 6;
+static const size_t CFG_TMODE3_LENGTH = 40;
+
+/** Unframed UBX message */
+template <size_t N>
+struct Message {
+    static_assert(N > 0 && N <= MAX_PAYLOAD_LENGTH, "invalid payload length");
+
+    uint8_t msg_class;
+    uint8_t msg_id;
+    ConstexprArray<uint8_t, N> payload;
+
+    static constexpr size_t FRAME_LENGTH = N + FRAME_OVERHEAD;
+};
+
+namespace detail {
+
+template <size_t N>
+constexpr void putU2(ConstexprArray<uint8_t, N> &payload, size_t offset, uint16_t v)
+{
+    payload[offset] = (uint8_t)(v & 0xFF);
+    payload[offset + 1] = (uint8_t)(v >> 8);
+}
+
+template <size_t N>
+constexpr void putU4(ConstexprArray<uint8_t, N> &payload, size_t offset, uint32_t v)
+{
+    putU2(payload, offset, (uint16_t)(v & 0xFFFF));
+    putU2(payload, offset + 2, (uint16_t)(v >> 16));
+}
+
+constexpr size_t sum(std::initializer_list<size_t> values)
+{
+    size_t total = 0;
+    for (size_t v : values) total += v;
+    return total;
+}
+
+} // namespace detail
+
+/** CFG-MSG: output rate of a message on the current port, in navigation solutions */
+constexpr Message<CFG_MSG_LENGTH> cfgMsg(uint8_t msg_class, uint8_t msg_id, uint8_t rate)
+{
+    return Message<CFG_MSG_LENGTH>{CLASS_CFG, ID_CFG_MSG, {{msg_class, msg_id, rate}}};
+}
+
+/**
+ * CFG-RATE, one navigation solution per measurement, aligned to GPS time.
+ * @param period measurement period [ms]
+ */
+constexpr Message<CFG_RATE_LENGTH> cfgRate(uint16_t period)
+{
+    Message<CFG_RATE_LENGTH> message{CLASS_CFG, ID_CFG_RATE, {}};
+    detail::putU2(message.payload, 0, period);
+    detail::putU2(message.payload, 2, 1); // navRate: cycles per solution
+    detail::putU2(message.payload, 4, 1); // timeRef: GPS
+    return message;
+}
+
+/**
+ * CFG-TMODE3 switching the receiver to a fixed ECEF base position.
+ * @param x, y, z position [m]
+ * @param accuracy accuracy of the position [m]
+ */
+constexpr Message<CFG_TMODE3_LENGTH> cfgTmode3Fixed(double x, double y, double z, float accuracy)
+{
+    Message<CFG_TMODE3_LENGTH> message{CLASS_CFG, ID_CFG_TMODE3, {}};
+    detail::putU2(message.payload, 2, 2); // mode: fixed, ECEF
+    const double ecef[3] = {x, y, z};
+    for (int i = 0; i < 3; i++) {
+        // cm part plus a 0.1 mm part in -99..99
+        const int64_t tenth_mm = (int64_t)(ecef[i] * 1e4 + (ecef[i] >= 0 ? 0.5 : -0.5));
+        const int64_t cm = tenth_mm / 100;
+        detail::putU4(message.payload, 4 + 4 * i, (uint32_t)(int32_t)cm);
+        message.payload[16 + i] = (uint8_t)(int8_t)(tenth_mm - cm * 100);
+    }
+    // 0.1 mm in a U4, anything else (NaN included) would not convert
+    detail::putU4(message.payload, 20, accuracy >= 0.f && accuracy < 4e5f ? (uint32_t)(accuracy * 1e4f) : UINT32_MAX);
+    return message;
+}
+
+/**
+ * CFG-TMODE3 starting a survey-in.
+ * @param min_duration minimum duration [s]
+ * @param accuracy_limit position accuracy that ends the survey [m]
+ */
+constexpr Message<CFG_TMODE3_LENGTH> cfgTmode3SurveyIn(uint32_t min_duration, float accuracy_limit)
+{
+    Message<CFG_TMODE3_LENGTH> message{CLASS_CFG, ID_CFG_TMODE3, {}};
+    detail::putU2(message.payload, 2, 1); // mode: survey-in
+    detail::putU4(message.payload, 24, min_duration);
+    detail::putU4(message.payload, 28, (uint32_t)(accuracy_limit * 1e4f));
+    return message;
+}
+
+/**
+ * Serialize a message at out[pos], out must hold Message<N>::FRAME_LENGTH more bytes.
+ * Works on a ConstexprArray in constant expressions and on a plain buffer at run time.
+ * @return position after the frame
+ */
+template <typename Out, size_t N>
+constexpr size_t appendFrame(Out &out, size_t pos, const Message<N> &message)
+{
+    out[pos] = SYNC1;
+    out[pos + 1] = SYNC2;
+    out[pos + 2] = message.msg_class;
+    out[pos + 3] = message.msg_id;
+    out[pos + 4] = (uint8_t)(N & 0xFF);
+    out[pos + 5] = (uint8_t)(N >> 8);
+    for (size_t i = 0; i < N; i++) {
+        out[pos + HEADER_LENGTH + i] = message.payload[i];
+    }
+
+    uint8_t ck_a = 0, ck_b = 0;
+    for (size_t i = pos + 2; i < pos + HEADER_LENGTH + N; i++) {
+        ck_a = (uint8_t)(ck_a + out[i]);
+        ck_b = (uint8_t)(ck_b + ck_a);
+    }
+    out[pos + HEADER_LENGTH + N] = ck_a;
+    out[pos + HEADER_LENGTH + N + 1] = ck_b;
+    return pos + N + FRAME_OVERHEAD;
+}
+
+/** Frames of all messages back to back, in argument order */
+template <size_t... Ns>
+constexpr ConstexprArray<uint8_t, detail::sum({(Ns + FRAME_OVERHEAD)...})> configBlob(const Message<Ns> &... messages)
+{
+    ConstexprArray<uint8_t, detail::sum({(Ns + FRAME_OVERHEAD)...})> blob{};
+    size_t pos = 0;
+    // Braced initializers are evaluated in order
+    const size_t ends[] = {(pos = appendFrame(blob, pos, messages))...};
+    (void)ends;
+    return blob;
+}
+
+/** True if blob holds the bytes at offset, for static_assert on configurations */
+template <size_t N>
+constexpr bool blobMatches(const ConstexprArray<uint8_t, N> &blob, size_t offset, std::initializer_list<uint8_t> bytes)
+{
+    if (offset + bytes.size() > N) return false;
+    for (uint8_t b : bytes) {
+        if (blob[offset++] != b) return false;
+    }
+    return true;
+}
+
+// The 1 Hz CFG-RATE frame of the u-blox protocol specification
+static_assert(blobMatches(configBlob(cfgRate(1000)), 0,
+        {0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0xE8, 0x03, 0x01, 0x00, 0x01, 0x00, 0x01, 0x39}),
+        "CFG-RATE serialization");
+
+} // namespace ubx
+} // namespace rtk_ros
@@ -0,0 +1,131 @@
+/**
+ * @file ubx_dispatch.hpp
+ * Compile-time UBX dispatch table.
+ *
+ * Every message the node decodes is described by a MessageSpec (class, id and
+ * payload length rules). UbxDispatcher<Owner, Specs...> builds a table of the
+ * listed messages sorted by their 16-bit class/id key at compile time, and
+ * dispatch() finds an entry with a fixed-length binary search, checks the
+ * payload length and calls the owner's typed handler:
+ *
+ *   void onUbx(const ubx::NavSat &, const uint8_t *payload, uint16_t len);
+ *
+ * Messages that are not listed generate no code, and a listed message without
+ * a handler fails to compile.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+namespace ubx {
+
+constexpr uint16_t messageKey(uint8_t msg_class, uint8_t msg_id)
+{
+    return (uint16_t)((msg_class << 8) | msg_id);
+}
+
+/**
+ * Payload length rules of a message: at least MinLength bytes, followed by
+ * any number of BlockLength-byte repeated blocks if BlockLength is not 0.
+ */
+template <uint8_t Class, uint8_t Id, uint16_t MinLength, uint16_t BlockLength = 0>
+struct MessageSpec {
+    static_assert(MinLength <= MAX_PAYLOAD_LENGTH, "minimum payload longer than any UBX frame");
+    static_assert(BlockLength <= MAX_PAYLOAD_LENGTH - MinLength, "repeated block longer than any UBX frame");
+
+    static constexpr uint8_t msg_class = Class;
+    static constexpr uint8_t msg_id = Id;
+    static constexpr uint16_t key = messageKey(Class, Id);
+    static constexpr uint16_t min_length = MinLength;
+    static constexpr uint16_t block_length = BlockLength;
+};
+
+struct NavPvt : MessageSpec<CLASS_NAV, ID_NAV_PVT, 92> {};
+struct NavHpposecef : MessageSpec<CLASS_NAV, ID_NAV_HPPOSECEF, 28> {};
+struct NavSat : MessageSpec<CLASS_NAV, ID_NAV_SAT, 8, 12> {};
+struct NavSvin : MessageSpec<CLASS_NAV, ID_NAV_SVIN, 40> {};
+struct MonHw : MessageSpec<CLASS_MON, ID_MON_HW, 60> {};
+struct MonRf : MessageSpec<CLASS_MON, ID_MON_RF, 4, 24> {};
+struct RxmRawx : MessageSpec<CLASS_RXM, ID_RXM_RAWX, 16, 32> {};
+struct RxmSfrbx : MessageSpec<CLASS_RXM, ID_RXM_SFRBX, 8, 4> {};
+
+template <typename Owner>
+struct DispatchEntry {
+    uint16_t key;
+    uint16_t min_length;
+    uint16_t block_length;
+    void (*handler)(Owner &, const uint8_t *, uint16_t);
+};
+
+template <typename T, size_t N>
+constexpr ConstexprArray<T, N> sortedByKey(ConstexprArray<T, N> table)
+{
+    for (size_t i = 1; i < N; i++) {
+        for (size_t j = i; j > 0 && table[j].key < table[j - 1].key; j--) {
+            const T tmp = table[j];
+            table[j] = table[j - 1];
+            table[j - 1] = tmp;
+        }
+    }
+    return table;
+}
+
+template <typename T, size_t N>
+constexpr bool uniqueKeys(const ConstexprArray<T, N> &sorted)
+{
+    for (size_t i = 1; i < N; i++) {
+        if (sorted[i].key == sorted[i - 1].key) return false;
+    }
+    return true;
+}
+
+template <typename Owner, typename... Specs>
+class UbxDispatcher
+{
+public:
+    static constexpr size_t SIZE = sizeof...(Specs);
+    static_assert(SIZE > 0, "empty dispatch table");
+
+    template <typename Spec>
+    static void invoke(Owner &owner, const uint8_t *payload, uint16_t len) {
+        owner.onUbx(Spec(), payload, len);
+    }
+
+    typedef DispatchEntry<Owner> Entry;
+    typedef ConstexprArray<Entry, SIZE> Table;
+
+    static constexpr Table table = sortedByKey(Table{{Entry{Specs::key, Specs::min_length, Specs::block_length, &invoke<Specs>}...}});
+    static_assert(uniqueKeys(table), "message listed twice in the dispatch table");
+
+    /**
+     * Call the handler of a message.
+     * @return false if the message is not in the table or its length is invalid
+     */
+    static bool dispatch(Owner &owner, uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t len) {
+        const uint16_t key = messageKey(msg_class, msg_id);
+        // Branch-free lower bound, the trip count only depends on SIZE
+        size_t first = 0;
+        for (size_t n = SIZE; n > 1; n -= n / 2) {
+            first = table[first + n / 2].key < key ? first + n / 2 : first;
+        }
+        first += table[first].key < key;
+        if (first >= SIZE) return false;
+
+        const Entry &entry = table[first];
+        if (entry.key != key || len < entry.min_length) return false;
+        if (entry.block_length > 0 && (len - entry.min_length) % entry.block_length != 0) return false;
+        entry.handler(owner, payload, len);
+        return true;
+    }
+};
+
+template <typename Owner, typename... Specs>
+constexpr typename UbxDispatcher<Owner, Specs...>::Table UbxDispatcher<Owner, Specs...>::table;
+
+} // namespace ubx
+} // namespace rtk_ros
@@ -0,0 +1,208 @@
+/**
+ * @file ubx_parser.hpp
+ * Streaming UBX frame parser fed with the raw bytes read from the receiver.
+ * It only frames and validates messages, decoding is left to the handler.
+ *
+ * Between frames the parser works on the whole buffer: it looks for the sync
+ * pair with byte_scan's findPair(), checks frames that are complete in the
+ * buffer with the wide checksum and passes their payload in place. The byte
+ * state machine only handles frames split across two buffers.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "byte_scan.hpp"
+#include "ubx_protocol.hpp"
+
+namespace rtk_ros {
+
+class UbxParser
+{
+public:
+    UbxParser() { reset(); }
+
+    void reset() {
+        state = State::Sync1;
+        payloadLength = 0;
+        payloadIndex = 0;
+        ck_a = 0;
+        ck_b = 0;
+    }
+
+    /**
+     * Feed a chunk of bytes. For every valid frame,
+     * handler.onUbxMessage(msg_class, msg_id, payload, length) is called.
+     * The payload is only valid during the call.
+     */
+    template <typename Handler>
+    void parse(const uint8_t *data, size_t len, Handler &handler) {
+        size_t i = 0;
+        while (i < len) {
+            if (state == State::Payload) {
+                i += continuePayload(data + i, len - i);
+            } else if (state != State::Sync1) {
+                parseByte(data[i++], handler);
+            } else {
+                i = parseFrames(data, len, i, handler);
+            }
+        }
+    }
+
+    /** True between frames, when no partial frame is buffered */
+    bool idle() const { return state == State::Sync1; }
+
+    uint32_t checksumErrors() const { return checksumErrorCount; }
+    uint32_t oversizedFrames() const { return oversizedCount; }
+
+private:
+    enum class State : uint8_t {
+        Sync1, Sync2, Class, Id, Length1, Length2, Payload, ChecksumA, ChecksumB
+    };
+
+    /**
+     * Handle the frames that are complete in data, starting at i in the Sync1 state.
+     * @return where the byte state machine has to continue
+     */
+    template <typename Handler>
+    size_t parseFrames(const uint8_t *data, size_t len, size_t i, Handler &handler) {
+        while (i < len) {
+            const size_t sync = i + findPair(data + i, len - i, ubx::SYNC1, ubx::SYNC2);
+            if (sync >= len) {
+                // A trailing SYNC1 may be followed by SYNC2 in the next buffer
+                if (data[len - 1] == ubx::SYNC1) state = State::Sync2;
+                return len;
+            }
+            const uint8_t *frame = data + sync;
+            if (len - sync < ubx::HEADER_LENGTH) return startSplitFrame(sync);
+
+            const uint16_t length = ubx::readU2(frame + 4);
+            if (length > ubx::MAX_PAYLOAD_LENGTH) {
+                ++oversizedCount;
+                i = sync + ubx::HEADER_LENGTH;
+                continue;
+            }
+            if (len - sync < (size_t)length + ubx::FRAME_OVERHEAD) return startSplitFrame(sync);
+
+            uint8_t a = 0, b = 0;
+            fletcher8Update(frame + 2, length + 4, a, b);
+            const uint8_t *checksum = frame + ubx::HEADER_LENGTH + length;
+            if (checksum[0] != a) {
+                // Same resynchronization as the byte state machine
+                ++checksumErrorCount;
+                i = sync + ubx::HEADER_LENGTH + length + 1;
+                continue;
+            }
+            if (checksum[1] == b) {
+                handler.onUbxMessage(frame[2], frame[3], frame + ubx::HEADER_LENGTH, length);
+            } else {
+                ++checksumErrorCount;
+            }
+            i = sync + length + ubx::FRAME_OVERHEAD;
+        }
+        return i;
+    }
+
+    /** Consume the sync pair of a frame that continues in the next buffer */
+    size_t startSplitFrame(size_t sync) {
+        ck_a = ck_b = 0;
+        state = State::Class;
+        return sync + 2;
+    }
+
+    /** Buffer the part of a split payload that is in data, @return bytes used */
+    size_t continuePayload(const uint8_t *data, size_t len) {
+        size_t n = payloadLength - payloadIndex;
+        if (n > len) n = len;
+        memcpy(payload + payloadIndex, data, n);
+        fletcher8Update(data, n, ck_a, ck_b);
+        payloadIndex += n;
+        if (payloadIndex >= payloadLength) state = State::ChecksumA;
+        return n;
+    }
+
+    template <typename Handler>
+    void parseByte(uint8_t b, Handler &handler) {
+        switch (state) {
+            case State::Sync1:
+                if (b == ubx::SYNC1) state = State::Sync2;
+                break;
+            case State::Sync2:
+                if (b == ubx::SYNC2) {
+                    ck_a = ck_b = 0;
+                    state = State::Class;
+                } else if (b != ubx::SYNC1) {
+                    state = State::Sync1;
+                }
+                break;
+            case State::Class:
+                msgClass = b;
+                addChecksum(b);
+                state = State::Id;
+                break;
+            case State::Id:
+                msgId = b;
+                addChecksum(b);
+                state = State::Length1;
+                break;
+            case State::Length1:
+                payloadLength = b;
+                addChecksum(b);
+                state = State::Length2;
+                break;
+            case State::Length2:
+                payloadLength |= (uint16_t)(b << 8);
+                addChecksum(b);
+                if (payloadLength > ubx::MAX_PAYLOAD_LENGTH) {
+                    ++oversizedCount;
+                    reset();
+                    break;
+                }
+                payloadIndex = 0;
+                state = payloadLength > 0 ? State::Payload : State::ChecksumA;
+                break;
+            case State::Payload:
+                payload[payloadIndex++] = b;
+                addChecksum(b);
+                if (payloadIndex >= payloadLength) state = State::ChecksumA;
+                break;
+            case State::ChecksumA:
+                if (b != ck_a) {
+                    ++checksumErrorCount;
+                    reset();
+                    break;
+                }
+                state = State::ChecksumB;
+                break;
+            case State::ChecksumB:
+                if (b == ck_b) {
+                    handler.onUbxMessage(msgClass, msgId, payload, payloadLength);
+                } else {
+                    ++checksumErrorCount;
+                }
+                reset();
+                break;
+        }
+    }
+
+    void addChecksum(uint8_t b) {
+        ck_a += b;
+        ck_b += ck_a;
+    }
+
+    State state;
+    uint8_t msgClass = 0;
+    uint8_t msgId = 0;
+    uint16_t payloadLength;
+    uint16_t payloadIndex;
+    uint8_t ck_a;
+    uint8_t ck_b;
+    uint32_t checksumErrorCount = 0;
+    uint32_t oversizedCount = 0;
+    uint8_t payload[ubx::MAX_PAYLOAD_LENGTH];
+};
+
+} // namespace rtk_ros
@@ -0,0 +1,153 @@
+/**
+ * @file ubx_protocol.hpp
+ * UBX framing constants and helpers used by the node on top of the GpsDrivers parser
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace rtk_ros {
+namespace ubx {
+
+static const uint8_t SYNC1 = 0xB5;
+static const uint8_t SYNC2 = 0x62;
+
+/** Sync (2) + class (1) + id (1) + length (2) */
+static const size_t HEADER_LENGTH = 6;
+static const size_t CHECKSUM_LENGTH = 2;
+static const size_t FRAME_OVERHEAD = HEADER_LENGTH + CHECKSUM_LENGTH;
+
+/** Largest payload the node buffers, big enough for NAV-SAT / RXM-RAWX with 64+ SVs */
+static const size_t MAX_PAYLOAD_LENGTH = 4096;
+
+/* Message classes */
+static const uint8_t CLASS_NAV = 0x01;
+static const uint8_t CLASS_RXM = 0x02;
+static const uint8_t CLASS_ACK = 0x05;
+static const uint8_t CLASS_CFG = 0x06;
+static const uint8_t CLASS_MON = 0x0A;
+static const uint8_t CLASS_RTCM3 = 0xF5;   ///< output rates of RTCM messages, configured with CFG-MSG
+
+/* Message ids */
+static const uint8_t ID_NAV_PVT = 0x07;
+static const uint8_t ID_NAV_HPPOSECEF = 0x13;
+static const uint8_t ID_NAV_SAT = 0x35;
+static const uint8_t ID_NAV_SVIN = 0x3B;
+static const uint8_t ID_RXM_SFRBX = 0x13;
+static const uint8_t ID_RXM_RAWX = 0x15;
+static const uint8_t ID_CFG_MSG = 0x01;
+static const uint8_t ID_CFG_RATE = 0x08;
+static const uint8_t ID_CFG_TMODE3 = 0x71;
+static const uint8_t ID_MON_VER = 0x04;
+static const uint8_t ID_MON_HW = 0x09;
+static const uint8_t ID_MON_RF = 0x38;
+/* RTCM 3 message numbers as CLASS_RTCM3 ids */
+static const uint8_t ID_RTCM3_1005 = 0x05;
+static const uint8_t ID_RTCM3_1077 = 0x4D;
+static const uint8_t ID_RTCM3_1087 = 0x57;
+static const uint8_t ID_RTCM3_1097 = 0x61;
+static const uint8_t ID_RTCM3_1127 = 0x7F;
+static const uint8_t ID_RTCM3_1230 = 0xE6;
+
+/** Minimal constexpr-mutable array, std::array is only usable this way from C++17 */
+template <typename T, size_t N>
+struct ConstexprArray {
+    T data[N];
+    constexpr T &operator[](size_t i) { return data[i]; }
+    constexpr const T &operator[](size_t i) const { return data[i]; }
+    static constexpr size_t size() { return N; }
+};
+
+inline uint16_t readU2(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline int16_t readI2(const uint8_t *p)
+{
+    return (int16_t)readU2(p);
+}
+
+inline uint32_t readU4(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline int32_t readI4(const uint8_t *p)
+{
+    return (int32_t)readU4(p);
+}
+
+inline float readR4(const uint8_t *p)
+{
+    const uint32_t bits = readU4(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline double readR8(const uint8_t *p)
+{
+    const uint64_t bits = readU4(p) | ((uint64_t)readU4(p + 4) << 32);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline void writeU2(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+inline void writeU4(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+/**
+ * 8-bit Fletcher checksum as defined by the UBX protocol.
+ * ck_a / ck_b carry the running state so the sum can be continued over several chunks.
+ */
+inline void fletcher8(const uint8_t *data, size_t len, uint8_t &ck_a, uint8_t &ck_b)
+{
+    for (size_t i = 0; i < len; i++) {
+        ck_a += data[i];
+        ck_b += ck_a;
+    }
+}
+
+/**
+ * Serialize a UBX frame into out, which must hold payload_len + FRAME_OVERHEAD bytes.
+ * @return number of bytes written
+ */
+inline size_t buildFrame(uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t payload_len, uint8_t *out)
+{
+    out[0] = SYNC1;
+    out[1] = SYNC2;
+    out[2] = msg_class;
+    out[3] = msg_id;
+    out[4] = (uint8_t)(payload_len & 0xFF);
+    out[5] = (uint8_t)(payload_len >> 8);
+    for (uint16_t i = 0; i < payload_len; i++) {
+        out[HEADER_LENGTH + i] = payload[i];
+    }
+
+    uint8_t ck_a = 0, ck_b = 0;
+    fletcher8(out + 2, payload_len + 4, ck_a, ck_b);
+    out[HEADER_LENGTH + payload_len] = ck_a;
+    out[HEADER_LENGTH + payload_len + 1] = ck_b;
+    return payload_len + FRAME_OVERHEAD;
+}
+
+/** Shortest measurement period accepted by the node, 20 Hz is the fastest u-blox RTK navigation rate */
+static const uint16_t MIN_MEASUREMENT_PERIOD = 50;
+
+} // namespace ubx
+} // namespace rtk_ros
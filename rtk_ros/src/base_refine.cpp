@@ -0,0 +1,275 @@
+/****************************************************************************
+ *
+ *   Offline base position refinement from recorded UBX captures.
+ *
+ *   Every capture is memory-mapped and split in chunks that are decoded in
+ *   parallel. NAV-HPPOSECEF epochs are used when present, NAV-PVT otherwise.
+ *   The batch estimator rejects outliers around the median (MAD), and the
+ *   accuracy is the standard error of batch means so that correlated epochs
+ *   are not counted as independent. The result is written as a fixed position
+ *   file for rtk_node (base/fixed_position_file).
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <rtk_ros/ubx_parser.hpp>
+#include <rtk_ros/base_estimator.hpp>
+#include <rtk_ros/fixed_position.hpp>
+
+namespace {
+
+struct Epoch {
+    double d[3];        ///< offset to the reference position [m]
+    float accuracy;
+};
+
+struct Capture {
+    std::string path;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+struct Chunk {
+    size_t capture;
+    size_t begin;
+    size_t end;
+    std::vector<rtk_ros::EcefSample> samples;
+    std::vector<bool> high_precision;
+};
+
+/** Collects position epochs of one chunk */
+struct ChunkDecoder {
+    Chunk *chunk;
+
+    void onUbxMessage(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len) {
+        if (msgClass != rtk_ros::ubx::CLASS_NAV) return;
+        rtk_ros::EcefSample sample;
+        bool decoded = false;
+        if (msgId == rtk_ros::ubx::ID_NAV_HPPOSECEF) decoded = sample.decodeNavHpposecef(payload, len);
+        else if (msgId == rtk_ros::ubx::ID_NAV_PVT) decoded = sample.decodeNavPvt(payload, len);
+        if (decoded && sample.valid) {
+            chunk->samples.push_back(sample);
+            chunk->high_precision.push_back(msgId == rtk_ros::ubx::ID_NAV_HPPOSECEF);
+        }
+    }
+};
+
+/**
+ * Decode [begin, end) of a capture. A frame that straddles end is completed
+ * here, the next chunk starts mid-frame and resynchronizes on the checksum.
+ */
+void decodeChunk(const Capture &capture, Chunk &chunk)
+{
+    rtk_ros::UbxParser parser;
+    ChunkDecoder decoder{&chunk};
+    parser.parse(capture.data + chunk.begin, chunk.end - chunk.begin, decoder);
+    for (size_t i = chunk.end; i < capture.size && !parser.idle(); i++) {
+        parser.parse(capture.data + i, 1, decoder);
+    }
+}
+
+template <typename Function>
+void parallelFor(size_t count, unsigned threads, Function function)
+{
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) function(i);
+        });
+    }
+    for (std::thread &w : workers) w.join();
+}
+
+double median(std::vector<double> &values)
+{
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options] capture.ubx [capture.ubx ...]\n"
+        "  -o FILE    fixed position file to write (default: base_position.yaml)\n"
+        "  -j N       worker threads (default: all cores)\n"
+        "  -k SIGMA   outlier threshold in robust sigmas (default: 4)\n"
+        "  -b N       epochs per batch for the standard error (default: 300)\n"
+        "  -a METERS  ignore epochs reporting a worse accuracy (default: 10)\n",
+        name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string output = "base_position.yaml";
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    double outlierSigma = 4.0;
+    size_t batchSize = 300;
+    float maxAccuracy = 10.f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:j:k:b:a:h")) != -1) {
+        switch (opt) {
+            case 'o': output = optarg; break;
+            case 'j': threads = std::max(1, atoi(optarg)); break;
+            case 'k': outlierSigma = atof(optarg); break;
+            case 'b': batchSize = std::max(2, atoi(optarg)); break;
+            case 'a': maxAccuracy = atof(optarg); break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Map the captures and split them in chunks
+    const size_t chunkSize = 16 * 1024 * 1024;
+    std::vector<Capture> captures;
+    std::vector<Chunk> chunks;
+    for (int i = optind; i < argc; i++) {
+        Capture capture;
+        capture.path = argv[i];
+        int fd = open(argv[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            fprintf(stderr, "Cannot open %s: %s\n", argv[i], strerror(errno));
+            return 1;
+        }
+        capture.size = st.st_size;
+        if (capture.size > 0) {
+            void *data = mmap(nullptr, capture.size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                fprintf(stderr, "Cannot map %s: %s\n", argv[i], strerror(errno));
+                return 1;
+            }
+            madvise(data, capture.size, MADV_SEQUENTIAL);
+            capture.data = (const uint8_t *)data;
+        }
+        close(fd);
+
+        for (size_t begin = 0; begin < capture.size; begin += chunkSize) {
+            Chunk chunk;
+            chunk.capture = captures.size();
+            chunk.begin = begin;
+            chunk.end = std::min(begin + chunkSize, capture.size);
+            chunks.push_back(chunk);
+        }
+        captures.push_back(capture);
+    }
+
+    parallelFor(chunks.size(), threads, [&](size_t i) {
+        decodeChunk(captures[chunks[i].capture], chunks[i]);
+    });
+
+    // Prefer high precision epochs when the captures contain them
+    bool highPrecision = false;
+    for (const Chunk &chunk : chunks) {
+        highPrecision = highPrecision || std::find(chunk.high_precision.begin(), chunk.high_precision.end(), true) != chunk.high_precision.end();
+    }
+
+    std::vector<Epoch> epochs;
+    double reference[3] = {0.0, 0.0, 0.0};
+    for (const Chunk &chunk : chunks) {
+        for (size_t i = 0; i < chunk.samples.size(); i++) {
+            const rtk_ros::EcefSample &s = chunk.samples[i];
+            if (chunk.high_precision[i] != highPrecision || s.accuracy > maxAccuracy) continue;
+            if (epochs.empty()) std::copy(s.ecef, s.ecef + 3, reference);
+            Epoch e;
+            for (int k = 0; k < 3; k++) e.d[k] = s.ecef[k] - reference[k];
+            e.accuracy = s.accuracy;
+            epochs.push_back(e);
+        }
+    }
+    for (const Capture &capture : captures) {
+        if (capture.data) munmap((void *)capture.data, capture.size);
+    }
+
+    if (epochs.size() < 2 * batchSize) {
+        fprintf(stderr, "Only %zu usable epochs, need at least %zu\n", epochs.size(), 2 * batchSize);
+        return 1;
+    }
+
+    // Median and MAD per axis
+    double med[3], mad[3];
+    parallelFor(3, std::min(3u, threads), [&](size_t k) {
+        std::vector<double> values(epochs.size());
+        for (size_t i = 0; i < epochs.size(); i++) values[i] = epochs[i].d[k];
+        med[k] = median(values);
+        for (size_t i = 0; i < epochs.size(); i++) values[i] = std::fabs(epochs[i].d[k] - med[k]);
+        mad[k] = std::max(1.4826 * median(values), 1e-4);
+    });
+
+    std::vector<Epoch> inliers;
+    inliers.reserve(epochs.size());
+    for (const Epoch &e : epochs) {
+        bool keep = true;
+        for (int k = 0; k < 3; k++) keep = keep && std::fabs(e.d[k] - med[k]) <= outlierSigma * mad[k];
+        if (keep) inliers.push_back(e);
+    }
+
+    // Batch means of consecutive inliers, reduced in parallel
+    const size_t batches = inliers.size() / batchSize;
+    if (batches < 2) {
+        fprintf(stderr, "Only %zu epochs left after rejecting %zu outliers, need at least %zu\n",
+                inliers.size(), epochs.size() - inliers.size(), 2 * batchSize);
+        return 1;
+    }
+    std::vector<double> batchMeans(batches * 3);
+    parallelFor(batches, threads, [&](size_t b) {
+        double sum[3] = {0.0, 0.0, 0.0};
+        for (size_t i = b * batchSize; i < (b + 1) * batchSize; i++) {
+            for (int k = 0; k < 3; k++) sum[k] += inliers[i].d[k] - med[k];
+        }
+        for (int k = 0; k < 3; k++) batchMeans[b * 3 + k] = sum[k] / batchSize;
+    });
+
+    rtk_ros::FixedPosition result;
+    double variance = 0.0;
+    for (int k = 0; k < 3; k++) {
+        double sum = 0.0, sumSq = 0.0;
+        for (size_t i = 0; i < inliers.size(); i++) sum += inliers[i].d[k] - med[k];
+        for (size_t b = 0; b < batches; b++) {
+            const double m = batchMeans[b * 3 + k];
+            sumSq += m * m;
+        }
+        double batchMean = 0.0;
+        for (size_t b = 0; b < batches; b++) batchMean += batchMeans[b * 3 + k];
+        batchMean /= batches;
+        const double batchVariance = (sumSq / batches - batchMean * batchMean) * batches / (batches - 1);
+        variance += batchVariance / batches;
+        result.ecef[k] = reference[k] + med[k] + sum / inliers.size();
+    }
+    result.accuracy = (float)std::sqrt(variance);
+    result.samples = inliers.size();
+
+    printf("%zu captures, %zu chunks, %u threads\n", captures.size(), chunks.size(), threads);
+    printf("%zu %s epochs, %zu outliers rejected, %zu batches of %zu\n", epochs.size(),
+           highPrecision ? "NAV-HPPOSECEF" : "NAV-PVT", epochs.size() - inliers.size(), batches, batchSize);
+    printf("ECEF %.4f %.4f %.4f, accuracy %.4f m\n", result.ecef[0], result.ecef[1], result.ecef[2], result.accuracy);
+
+    std::string comment = "rtk_base_refine over " + std::to_string(captures.size()) + " capture(s)";
+    if (!result.save(output, comment.c_str())) {
+        fprintf(stderr, "Cannot write %s\n", output.c_str());
+        return 1;
+    }
+    printf("Written to %s\n", output.c_str());
+    return 0;
+}
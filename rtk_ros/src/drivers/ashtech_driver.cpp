@@ -0,0 +1,10 @@
+/****************************************************************************
+ *
+ *   GPSDriverAshtech as a driver module, see driver_plugin.hpp.
+ *
+ ****************************************************************************/
+
+#include <rtk_ros/GpsDrivers/src/ashtech.h>
+#include <rtk_ros/driver_plugin.hpp>
+
+RTK_ROS_DRIVER_PLUGIN(new GPSDriverAshtech(args->callback, args->user, args->gps_position, args->satellite_info))
@@ -0,0 +1,10 @@
+/****************************************************************************
+ *
+ *   GPSDriverMTK as a driver module, see driver_plugin.hpp.
+ *
+ ****************************************************************************/
+
+#include <rtk_ros/GpsDrivers/src/mtk.h>
+#include <rtk_ros/driver_plugin.hpp>
+
+RTK_ROS_DRIVER_PLUGIN(new GPSDriverMTK(args->callback, args->user, args->gps_position))
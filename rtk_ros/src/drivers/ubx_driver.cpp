@@ -0,0 +1,11 @@
+/****************************************************************************
+ *
+ *   GPSDriverUBX as a driver module, see driver_plugin.hpp.
+ *
+ ****************************************************************************/
+
+#include <rtk_ros/GpsDrivers/src/ubx.h>
+#include <rtk_ros/driver_plugin.hpp>
+
+RTK_ROS_DRIVER_PLUGIN(new GPSDriverUBX(GPSDriverUBX::Interface::UART, args->callback, args->user,
+        args->gps_position, args->satellite_info, args->dynamic_model))
@@ -5,6 +5,9 @@
  * 
  ****************************************************************************/
 
+#include <algorithm>
+#include <stdlib.h>
+
 #include <ros/ros.h>
 #include <rtk_ros/rtk_node.hpp>
 
@@ -16,15 +19,110 @@ int main(int argc, char *argv[])
 
     std::string port = "/dev/ttyACM0";
     int32_t baud = 115200;
+    std::string protocol = "ubx";
+    const char *rosHome = getenv("ROS_HOME");
+    const char *home = getenv("HOME");
+    std::string protocolCache = rosHome ? std::string(rosHome) : home ? std::string(home) + "/.ros" : std::string();
+    if (!protocolCache.empty()) protocolCache += "/rtk_ros_protocols";
+    std::string driverPath;
+    std::string mavlinkUdp;
+    int32_t mavlinkSystemId = rtk_ros::MavlinkRtcmOutput::DEFAULT_SYSTEM_ID;
+    int32_t mavlinkComponentId = rtk_ros::MavlinkRtcmOutput::DEFAULT_COMPONENT_ID;
+    float mavlinkPackDelay = 0.1;
+    bool rtcmTopic = true;
+    bool mavlinkMsm4 = false;
+    bool topicMsm4 = false;
+    bool rtcmMonitor = true;
+    float rtcmBudget = 0.0;
+    float rtcmMaxAge = 1.0;
+    std::string rtcmPriorities;
+    std::string rtcmOutputPolicy = "drop_stale_epoch";
+    float rtcmOutputDeadline = 0.5;
     float surveyAccuracy = 4.0;
     float surveyDuration = 90.0;
+    float statisticsRate = 0.2;
+    float navigationRate = 0.0;
+    bool gateRTCM = false;
+    bool hostEstimation = false;
+    float baseMinDuration = 60.0;
+    std::string fixedPositionFile;
+    bool rawPublish = false;
+    std::string rawLogFile;
+    int32_t rawLogBuffer = 1024;
+    std::string standbyPort;
+    int32_t standbyBaud = baud;
+    float failoverTimeout = 1.5;
+    float failoverMaxCrcRate = 1.0;
+    float failoverRevertDelay = 30.0;
+    int32_t failoverStationId = -1;
+    std::string shmName;
 
     pnh.param<std::string>("port", port, port);
     pnh.param<int32_t>("baud", baud, baud);
+    pnh.param<std::string>("protocol", protocol, protocol);
+    pnh.param<std::string>("protocol_cache", protocolCache, protocolCache);
+    pnh.param<std::string>("driver_path", driverPath, driverPath);
+    pnh.param<std::string>("mavlink/udp", mavlinkUdp, mavlinkUdp);
+    pnh.param<int32_t>("mavlink/system_id", mavlinkSystemId, mavlinkSystemId);
+    pnh.param<int32_t>("mavlink/component_id", mavlinkComponentId, mavlinkComponentId);
+    pnh.param<float>("mavlink/pack_delay", mavlinkPackDelay, mavlinkPackDelay);
+    pnh.param<bool>("rtcm/topic", rtcmTopic, rtcmTopic);
+    pnh.param<bool>("mavlink/msm4", mavlinkMsm4, mavlinkMsm4);
+    pnh.param<bool>("rtcm/topic_msm4", topicMsm4, topicMsm4);
+    pnh.param<bool>("rtcm/monitor", rtcmMonitor, rtcmMonitor);
+    pnh.param<float>("rtcm/budget", rtcmBudget, rtcmBudget);
+    pnh.param<float>("rtcm/max_age", rtcmMaxAge, rtcmMaxAge);
+    pnh.param<std::string>("rtcm/priorities", rtcmPriorities, rtcmPriorities);
+    pnh.param<std::string>("rtcm/output_policy", rtcmOutputPolicy, rtcmOutputPolicy);
+    pnh.param<float>("rtcm/output_deadline", rtcmOutputDeadline, rtcmOutputDeadline);
     pnh.param<float>("survey/accuracy", surveyAccuracy, surveyAccuracy);
     pnh.param<float>("survey/duration", surveyDuration, surveyDuration);
+    pnh.param<float>("statistics/rate", statisticsRate, statisticsRate);
+    pnh.param<float>("navigation/rate", navigationRate, navigationRate);
+    pnh.param<bool>("interference/gate_rtcm", gateRTCM, gateRTCM);
+    pnh.param<bool>("base/host_estimate", hostEstimation, hostEstimation);
+    pnh.param<float>("base/min_duration", baseMinDuration, baseMinDuration);
+    pnh.param<std::string>("base/fixed_position_file", fixedPositionFile, fixedPositionFile);
+    pnh.param<bool>("raw/publish", rawPublish, rawPublish);
+    pnh.param<std::string>("raw/log_file", rawLogFile, rawLogFile);
+    pnh.param<int32_t>("raw/log_buffer", rawLogBuffer, rawLogBuffer);
+    pnh.param<std::string>("standby/port", standbyPort, standbyPort);
+    pnh.param<int32_t>("standby/baud", standbyBaud, baud);
+    pnh.param<float>("failover/timeout", failoverTimeout, failoverTimeout);
+    pnh.param<float>("failover/max_crc_rate", failoverMaxCrcRate, failoverMaxCrcRate);
+    pnh.param<float>("failover/revert_delay", failoverRevertDelay, failoverRevertDelay);
+    pnh.param<int32_t>("failover/station_id", failoverStationId, failoverStationId);
+    pnh.param<std::string>("shm/name", shmName, shmName);
 
     RTKNode rtknode(&nh, baud, port, surveyAccuracy, surveyDuration);
+    rtknode.setProtocol(protocol, protocolCache);
+    rtknode.setDriverPath(driverPath);
+    rtknode.setMavlinkOutput(mavlinkUdp, (uint8_t)mavlinkSystemId, (uint8_t)mavlinkComponentId, rtcmTopic);
+    rtknode.setMavlinkPacking(mavlinkPackDelay);
+    rtknode.setMsm4Output(mavlinkMsm4, topicMsm4);
+    rtknode.setRtcmMonitor(rtcmMonitor);
+    rtknode.setRtcmOutputPolicy(rtcmOutputPolicy, rtcmOutputDeadline);
+    rtknode.setRtcmBudget(rtcmBudget, rtcmMaxAge, rtcmPriorities);
+    rtknode.setStatisticsRate(statisticsRate);
+    rtknode.setNavigationRate(navigationRate);
+    rtknode.setRawMeasurements(rawPublish, rawLogFile, (size_t)std::max(rawLogBuffer, 64) * 1024);
+    rtknode.setInterferenceGate(gateRTCM);
+    rtknode.setHostEstimation(hostEstimation, surveyAccuracy, baseMinDuration);
+    rtk_ros::BaseFailover::Config failover;
+    failover.timeout = failoverTimeout;
+    failover.max_crc_rate = failoverMaxCrcRate;
+    failover.revert_delay = failoverRevertDelay;
+    failover.station_id = failoverStationId;
+    rtknode.setStandby(standbyPort, (unsigned)standbyBaud, failover);
+    rtknode.setSharedMemory(shmName);
+    if (!fixedPositionFile.empty()) {
+        rtk_ros::FixedPosition fixedPosition;
+        if (fixedPosition.load(fixedPositionFile)) {
+            rtknode.setFixedPosition(fixedPosition);
+        } else {
+            ROS_ERROR_STREAM("Cannot load the base position from " << fixedPositionFile << ", surveying instead");
+        }
+    }
 
     rtknode.connect();
     rtknode.connect_gps();
@@ -0,0 +1,162 @@
+/**
+ * @file test_mavlink_rtcm.cpp
+ * MavlinkRtcmOutput to a UDP socket on localhost: the GPS_RTCM_DATA packets
+ * received are checked and reassembled into the messages sent.
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <rtk_ros/mavlink_rtcm.hpp>
+
+using namespace rtk_ros;
+
+namespace {
+
+/** UDP socket on a free localhost port */
+class Receiver
+{
+public:
+    Receiver() {
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&address, sizeof(address)) == 0
+                && getsockname(fd, (struct sockaddr *)&address, &length) == 0) {
+            port = ntohs(address.sin_port);
+        }
+    }
+    ~Receiver() {
+        if (fd >= 0) close(fd);
+    }
+
+    std::string uri() const { return "udp://127.0.0.1:" + std::to_string(port); }
+    bool isOpen() const { return port != 0; }
+
+    /** Next packet, empty if none arrives within a second */
+    std::vector<uint8_t> receive() {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) <= 0) return {};
+        std::vector<uint8_t> packet(2048);
+        const ssize_t n = recv(fd, packet.data(), packet.size(), 0);
+        packet.resize(n > 0 ? (size_t)n : 0);
+        return packet;
+    }
+
+private:
+    int fd = -1;
+    uint16_t port = 0;
+};
+
+/** A GPS_RTCM_DATA packet checked against the MAVLink 2 framing */
+struct Fragment {
+    uint8_t flags;
+    std::vector<uint8_t> data;
+};
+
+::testing::AssertionResult decode(const std::vector<uint8_t> &packet, Fragment &fragment)
+{
+    if (packet.size() < mavlink::HEADER_LENGTH + mavlink::CHECKSUM_LENGTH) {
+        return ::testing::AssertionFailure() << "short packet";
+    }
+    const size_t length = packet[1];
+    if (packet[0] != mavlink::STX_V2 || packet.size() != mavlink::HEADER_LENGTH + length + mavlink::CHECKSUM_LENGTH) {
+        return ::testing::AssertionFailure() << "bad framing";
+    }
+    const uint32_t id = packet[7] | (packet[8] << 8) | (packet[9] << 16);
+    if (id != mavlink::MSG_ID_GPS_RTCM_DATA || packet[5] != MavlinkRtcmOutput::DEFAULT_SYSTEM_ID
+            || packet[6] != MavlinkRtcmOutput::DEFAULT_COMPONENT_ID) {
+        return ::testing::AssertionFailure() << "bad message id " << id;
+    }
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 1; i < mavlink::HEADER_LENGTH + length; i++) crc = mavlink::crcAccumulate(packet[i], crc);
+    crc = mavlink::crcAccumulate(mavlink::GPS_RTCM_DATA_CRC_EXTRA, crc);
+    if (packet[mavlink::HEADER_LENGTH + length] != (crc & 0xFF) || packet[mavlink::HEADER_LENGTH + length + 1] != crc >> 8) {
+        return ::testing::AssertionFailure() << "bad checksum";
+    }
+
+    // Restore the trailing zeros MAVLink 2 truncated
+    uint8_t payload[mavlink::GPS_RTCM_DATA_LENGTH] = {};
+    memcpy(payload, packet.data() + mavlink::HEADER_LENGTH, length);
+    if (payload[1] == 0 || payload[1] > mavlink::RTCM_FRAGMENT_LENGTH) {
+        return ::testing::AssertionFailure() << "bad fragment length " << (int)payload[1];
+    }
+    fragment.flags = payload[0];
+    fragment.data.assign(payload + 2, payload + 2 + payload[1]);
+    return ::testing::AssertionSuccess();
+}
+
+} // namespace
+
+TEST(Mavlink, CrcCheckValue)
+{
+    // CRC-16/MCRF4XX
+    uint16_t crc = 0xFFFF;
+    for (const char *c = "123456789"; *c; c++) crc = mavlink::crcAccumulate((uint8_t)*c, crc);
+    EXPECT_EQ(0x6F91, crc);
+}
+
+TEST(MavlinkRtcmOutput, ReassemblesOverUdp)
+{
+    Receiver receiver;
+    ASSERT_TRUE(receiver.isOpen());
+    MavlinkRtcmOutput output;
+    ASSERT_TRUE(output.open(receiver.uri()));
+
+    std::mt19937 rng(5);
+    uint64_t sent = 0, dropped = 0, rtcmBytes = 0;
+    for (size_t len = 20; len <= 1029; len++) {
+        std::vector<uint8_t> message(len);
+        for (uint8_t &b : message) b = rng() % 4 ? (uint8_t)rng() : 0;
+        // Trailing zeros are truncated from the packet, and must come back
+        message.back() = 0;
+
+        if (len > mavlink::RTCM_MAX_MESSAGE_LENGTH) {
+            EXPECT_FALSE(output.send(message.data(), len));
+            EXPECT_FALSE(output.wouldBlock());
+            ++dropped;
+            continue;
+        }
+        ASSERT_TRUE(output.send(message.data(), len)) << "length " << len;
+        const uint8_t sequence = (uint8_t)(sent++ & 0x1F);
+        rtcmBytes += len;
+
+        const size_t fragments = (len + mavlink::RTCM_FRAGMENT_LENGTH - 1) / mavlink::RTCM_FRAGMENT_LENGTH;
+        const bool fragmented = len > mavlink::RTCM_FRAGMENT_LENGTH;
+        std::vector<uint8_t> reassembled;
+        for (size_t i = 0; i < fragments; i++) {
+            Fragment fragment;
+            ASSERT_TRUE(decode(receiver.receive(), fragment)) << "length " << len << " fragment " << i;
+            ASSERT_EQ(mavlink::rtcmFlags(fragmented, (uint8_t)i, sequence), fragment.flags)
+                << "length " << len << " fragment " << i;
+            reassembled.insert(reassembled.end(), fragment.data.begin(), fragment.data.end());
+        }
+        ASSERT_EQ(message, reassembled) << "length " << len;
+    }
+
+    const MavlinkRtcmOutput::Counters &c = output.counters();
+    EXPECT_EQ(sent, c.messages);
+    EXPECT_EQ(dropped, c.too_long);
+    EXPECT_EQ(rtcmBytes, c.rtcm_bytes);
+    EXPECT_EQ(0u, c.send_errors);
+    EXPECT_EQ(0u, c.would_block);
+}
+
+TEST(MavlinkRtcmOutput, RejectsInvalidUri)
+{
+    MavlinkRtcmOutput output;
+    EXPECT_FALSE(output.open("tcp://127.0.0.1:14550"));
+    EXPECT_FALSE(output.open("udp://127.0.0.1"));
+    EXPECT_FALSE(output.open("udp://127.0.0.1:"));
+    EXPECT_FALSE(output.isOpen());
+    EXPECT_FALSE(output.send((const uint8_t *)"x", 1));
+}
@@ -0,0 +1,145 @@
+/**
+ * @file test_receiver_config.cpp
+ * The constexpr configuration blobs and messages against frames built at run
+ * time with ubx::buildFrame, and CFG-RATE / CFG-TMODE3 against frames worked
+ * out from the u-blox protocol specification.
+ */
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+
+#include <rtk_ros/receiver_config.hpp>
+
+using namespace rtk_ros;
+
+namespace {
+
+struct Rate {
+    uint8_t msg_class, msg_id, rate;
+};
+
+/** CFG-MSG frames of rates, back to back */
+std::vector<uint8_t> cfgMsgFrames(std::initializer_list<Rate> rates)
+{
+    std::vector<uint8_t> out;
+    for (const Rate &r : rates) {
+        const uint8_t payload[ubx::CFG_MSG_LENGTH] = {r.msg_class, r.msg_id, r.rate};
+        uint8_t frame[ubx::CFG_MSG_LENGTH + ubx::FRAME_OVERHEAD];
+        const size_t n = ubx::buildFrame(ubx::CLASS_CFG, ubx::ID_CFG_MSG, payload, ubx::CFG_MSG_LENGTH, frame);
+        out.insert(out.end(), frame, frame + n);
+    }
+    return out;
+}
+
+template <size_t N>
+std::vector<uint8_t> bytes(const ubx::ConstexprArray<uint8_t, N> &blob)
+{
+    return std::vector<uint8_t>(blob.data, blob.data + N);
+}
+
+template <size_t N>
+std::vector<uint8_t> frame(const ubx::Message<N> &message)
+{
+    std::vector<uint8_t> out(N + ubx::FRAME_OVERHEAD);
+    EXPECT_EQ(out.size(), ubx::appendFrame(out, 0, message));
+    return out;
+}
+
+} // namespace
+
+TEST(ReceiverConfig, BlobsMatchRuntimeFrames)
+{
+    EXPECT_EQ(cfgMsgFrames({
+            {ubx::CLASS_NAV, ubx::ID_NAV_SAT, 1},
+            {ubx::CLASS_MON, ubx::ID_MON_HW, 1},
+            {ubx::CLASS_MON, ubx::ID_MON_RF, 1},
+            {ubx::CLASS_RTCM3, ubx::ID_RTCM3_1005, 5},
+            {ubx::CLASS_RTCM3, ubx::ID_RTCM3_1077, 1},
+            {ubx::CLASS_RTCM3, ubx::ID_RTCM3_1087, 1},
+            {ubx::CLASS_RTCM3, ubx::ID_RTCM3_1097, 1},
+            {ubx::CLASS_RTCM3, ubx::ID_RTCM3_1127, 1},
+            {ubx::CLASS_RTCM3, ubx::ID_RTCM3_1230, 5}}),
+        bytes(config::BASE_MESSAGES));
+    EXPECT_EQ(cfgMsgFrames({{ubx::CLASS_NAV, ubx::ID_NAV_HPPOSECEF, 1}}), bytes(config::HOST_ESTIMATION_MESSAGES));
+    EXPECT_EQ(cfgMsgFrames({{ubx::CLASS_RXM, ubx::ID_RXM_RAWX, 1}, {ubx::CLASS_RXM, ubx::ID_RXM_SFRBX, 1}}),
+        bytes(config::RAW_MESSAGES));
+    EXPECT_EQ(cfgMsgFrames({{ubx::CLASS_NAV, ubx::ID_NAV_SVIN, 1}}), bytes(config::STANDBY_MESSAGES));
+}
+
+TEST(ReceiverConfig, CfgRate)
+{
+    // 1 Hz, one solution per measurement, GPS time
+    const std::vector<uint8_t> spec = {0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0xE8, 0x03, 0x01, 0x00, 0x01, 0x00, 0x01, 0x39};
+    EXPECT_EQ(spec, frame(ubx::cfgRate(1000)));
+
+    for (uint32_t period = ubx::MIN_MEASUREMENT_PERIOD; period <= UINT16_MAX; period += 7) {
+        uint8_t payload[ubx::CFG_RATE_LENGTH];
+        ubx::writeU2(payload, (uint16_t)period);
+        ubx::writeU2(payload + 2, 1);
+        ubx::writeU2(payload + 4, 1);
+        std::vector<uint8_t> expected(ubx::CFG_RATE_LENGTH + ubx::FRAME_OVERHEAD);
+        ubx::buildFrame(ubx::CLASS_CFG, ubx::ID_CFG_RATE, payload, ubx::CFG_RATE_LENGTH, expected.data());
+        ASSERT_EQ(expected, frame(ubx::cfgRate((uint16_t)period))) << "period " << period;
+    }
+}
+
+TEST(ReceiverConfig, CfgTmode3Fixed)
+{
+    // Fields of the u-blox CFG-TMODE3 layout, worked out by hand:
+    //   version 0, reserved, flags 0x0002 (fixed mode, ECEF)
+    //   X  1234567.8912 m:  123456789 cm  = 0x075BCD15, HP  12 x 0.1 mm = 0x0C
+    //   Y -2345678.9123 m: -234567891 cm  = 0xF204C72D, HP -23 x 0.1 mm = 0xE9
+    //   Z  3456789.1234 m:  345678912 cm  = 0x149AA440, HP  34 x 0.1 mm = 0x22
+    //   reserved, fixedPosAcc 0.5 m = 5000 x 0.1 mm = 0x00001388
+    //   svinMinDur 0, svinAccLimit 0, 8 reserved bytes
+    const std::vector<uint8_t> expected = {
+        0xB5, 0x62, 0x06, 0x71, 0x28, 0x00,
+        0x00, 0x00, 0x02, 0x00,
+        0x15, 0xCD, 0x5B, 0x07, 0x2D, 0xC7, 0x04, 0xF2, 0x40, 0xA4, 0x9A, 0x14,
+        0x0C, 0xE9, 0x22, 0x00,
+        0x88, 0x13, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x13, 0x5A};
+    EXPECT_EQ(expected, frame(ubx::cfgTmode3Fixed(1234567.8912, -2345678.9123, 3456789.1234, 0.5f)));
+}
+
+TEST(ReceiverConfig, CfgTmode3FixedResolution)
+{
+    // The cm and 0.1 mm parts of every axis add up to the position, HP within -99..99
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<double> coordinate(-7e6, 7e6);
+    for (int t = 0; t < 100000; t++) {
+        const double ecef[3] = {coordinate(rng), coordinate(rng), coordinate(rng)};
+        const ubx::Message<ubx::CFG_TMODE3_LENGTH> message = ubx::cfgTmode3Fixed(ecef[0], ecef[1], ecef[2], 1.f);
+        for (int i = 0; i < 3; i++) {
+            const int32_t cm = ubx::readI4(message.payload.data + 4 + 4 * i);
+            const int8_t hp = (int8_t)message.payload[16 + i];
+            ASSERT_LE(abs(hp), 99) << ecef[i];
+            ASSERT_NEAR(ecef[i], cm * 1e-2 + hp * 1e-4, 0.5e-4 + 1e-9) << ecef[i];
+        }
+    }
+}
+
+TEST(ReceiverConfig, CfgTmode3FixedClampsAccuracy)
+{
+    const float invalid[] = {NAN, -1.f, 1e6f, INFINITY};
+    for (float accuracy : invalid) {
+        const ubx::Message<ubx::CFG_TMODE3_LENGTH> message = ubx::cfgTmode3Fixed(1.0, 2.0, 3.0, accuracy);
+        EXPECT_EQ(UINT32_MAX, ubx::readU4(message.payload.data + 20)) << accuracy;
+    }
+    EXPECT_EQ(25000u, ubx::readU4(ubx::cfgTmode3Fixed(1.0, 2.0, 3.0, 2.5f).payload.data + 20));
+}
+
+TEST(ReceiverConfig, CfgTmode3SurveyIn)
+{
+    const ubx::Message<ubx::CFG_TMODE3_LENGTH> message = ubx::cfgTmode3SurveyIn(300, 2.0f);
+    EXPECT_EQ(1u, ubx::readU2(message.payload.data + 2));
+    EXPECT_EQ(300u, ubx::readU4(message.payload.data + 24));
+    EXPECT_EQ(20000u, ubx::readU4(message.payload.data + 28));
+    for (size_t i = 4; i < 24; i++) EXPECT_EQ(0u, message.payload[i]) << "byte " << i;
+}
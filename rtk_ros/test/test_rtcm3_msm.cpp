@@ -0,0 +1,230 @@
+/**
+ * @file test_rtcm3_msm.cpp
+ * MSM encoding and decoding on random messages: MSM7 round trips exactly,
+ * MSM4 within the rounding of its coarser fields, and frame lengths agree
+ * with the fields actually written.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <random>
+#include <vector>
+
+#include <rtk_ros/rtcm3_msm.hpp>
+
+using namespace rtk_ros;
+using namespace rtk_ros::rtcm3;
+
+namespace {
+
+Msm randomMsm(std::mt19937 &rng, unsigned satellites, unsigned signals)
+{
+    Msm m;
+    m.number = (uint16_t)(1077 + 10 * (rng() % 6));
+    m.station_id = rng() & 0xFFF;
+    m.epoch = rng() & 0x3FFFFFFF;
+    m.multiple = rng() & 1;
+    m.iods = rng() & 7;
+    m.clock_steering = rng() & 3;
+    m.external_clock = rng() & 3;
+    m.smoothing = rng() & 1;
+    m.smoothing_interval = rng() & 7;
+    while (popcount64(m.satellite_mask) < satellites) m.satellite_mask |= 1ull << (rng() % 64);
+    while (popcount64(m.signal_mask) < signals) m.signal_mask |= 1u << (rng() % 32);
+    m.num_satellites = (uint8_t)satellites;
+    m.num_signals = (uint8_t)signals;
+    for (unsigned i = 0; i < satellites * signals; i++) {
+        if (rng() % 4) m.cell_mask |= 1ull << i;
+    }
+    m.num_cells = (uint8_t)popcount64(m.cell_mask);
+
+    for (unsigned i = 0; i < satellites; i++) {
+        MsmSatellite &s = m.satellites[i];
+        s.rough_range_ms = (uint8_t)rng();
+        s.info = rng() & 15;
+        s.rough_range_mod = rng() & 1023;
+        s.rough_rate = (int16_t)((int)(rng() % 16383) - 8191);
+    }
+    for (unsigned i = 0; i < m.num_cells; i++) {
+        MsmCell &c = m.cells[i];
+        c.pr_valid = rng() % 10 != 0;
+        c.fine_pr = c.pr_valid ? (int)(rng() % 1048575) - 524287 : 0;
+        c.cp_valid = rng() % 10 != 0;
+        c.fine_cp = c.cp_valid ? (int)(rng() % 16777215) - 8388607 : 0;
+        c.lock_ms = lockTimeMsExtended((uint16_t)(rng() % 705));
+        c.half_cycle = rng() & 1;
+        c.cnr = rng() & 1023;
+        c.rate_valid = rng() % 10 != 0;
+        c.fine_rate = c.rate_valid ? (int16_t)((int)(rng() % 32767) - 16383) : 0;
+    }
+    return m;
+}
+
+/** Random MSM7 with 1-12 satellites and 1-4 signals */
+Msm randomMsm(std::mt19937 &rng)
+{
+    const unsigned signals = 1 + rng() % 4;
+    return randomMsm(rng, 1 + rng() % 12, signals);
+}
+
+/**
+ * Bits of an MSM payload as its fields are laid out (RTCM 10403.3, 3.5.12),
+ * read field by field up to the last one.
+ */
+size_t fieldBits(const uint8_t *frame)
+{
+    BitReader r(frame + HEADER_LENGTH, payloadLength(frame));
+    const uint8_t type = (uint8_t)(r.u(12) % 10);
+    const bool extended = type >= 6;
+    const bool rates = type == 5 || type == 7;
+    r.skip(12 + 30 + 1 + 3 + 7 + 2 + 2 + 1 + 3);
+    const unsigned ns = popcount64(r.u64(64));
+    const unsigned nsig = popcount64(r.u(32));
+    const unsigned nc = popcount64(r.u64(ns * nsig));
+    // DF397, extended info, DF398, DF399
+    for (unsigned i = 0; i < ns; i++) r.skip(8 + (rates ? 4 : 0) + 10 + (rates ? 14 : 0));
+    // DF405/400, DF406/401, DF407/402, DF420, DF408/403, DF404
+    for (unsigned i = 0; i < nc; i++) {
+        r.skip(extended ? 20 + 24 + 10 + 1 + 10 : 15 + 22 + 4 + 1 + 6);
+        if (rates) r.skip(15);
+    }
+    return r.overrun() ? 0 : r.position();
+}
+
+} // namespace
+
+TEST(RtcmMsm, LockTimeIndicatorRoundTrip)
+{
+    for (uint16_t i = 0; i <= 704; i++) EXPECT_EQ(i, lockTimeIndicatorExtended(lockTimeMsExtended(i)));
+    for (uint8_t i = 0; i <= 15; i++) EXPECT_EQ(i, lockTimeIndicator(lockTimeMs(i)));
+}
+
+TEST(RtcmMsm, PayloadBitsMatchEncodedFields)
+{
+    std::mt19937 rng(6);
+    for (int t = 0; t < 2000; t++) {
+        const Msm m = randomMsm(rng);
+        for (uint8_t type = 4; type <= 7; type++) {
+            uint8_t frame[MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD];
+            const size_t n = encodeMsm(m, type, frame);
+            const size_t bits = msmPayloadBits(m, type);
+            ASSERT_EQ((bits + 7) / 8 + FRAME_OVERHEAD, n) << "MSM" << (int)type;
+            ASSERT_EQ(bits, fieldBits(frame)) << "MSM" << (int)type;
+            ASSERT_TRUE(checkCrc(frame));
+        }
+    }
+
+    // 12 satellites on 2 signals, all 24 cells
+    std::mt19937 full(8);
+    Msm m = randomMsm(full, 12, 2);
+    m.cell_mask = (1ull << 24) - 1;
+    m.num_cells = 24;
+    uint8_t frame[MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD];
+    EXPECT_EQ(202u, encodeMsm(m, 4, frame));
+    EXPECT_EQ(325u, encodeMsm(m, 7, frame));
+}
+
+TEST(RtcmMsm, Msm7RoundTripsExactly)
+{
+    std::mt19937 rng(9);
+    for (int t = 0; t < 2000; t++) {
+        const Msm m = randomMsm(rng);
+        uint8_t frame[MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD], again[MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD];
+        const size_t n = encodeMsm(m, 7, frame);
+        ASSERT_GT(n, 0u);
+        Msm decoded;
+        ASSERT_TRUE(decodeMsm(frame, n, decoded));
+        ASSERT_EQ(n, encodeMsm(decoded, 7, again));
+        ASSERT_EQ(std::vector<uint8_t>(frame, frame + n), std::vector<uint8_t>(again, again + n)) << "message " << t;
+    }
+}
+
+TEST(RtcmMsm, Msm4WithinRounding)
+{
+    std::mt19937 rng(10);
+    for (int t = 0; t < 2000; t++) {
+        const Msm m = randomMsm(rng);
+        uint8_t frame[MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD];
+        const size_t n = encodeMsm(m, 4, frame);
+        Msm d;
+        ASSERT_TRUE(decodeMsm(frame, n, d));
+        ASSERT_EQ(m.number - 3, d.number);
+        ASSERT_EQ(m.station_id, d.station_id);
+        ASSERT_EQ(m.epoch, d.epoch);
+        ASSERT_EQ(m.multiple, d.multiple);
+        ASSERT_EQ(m.satellite_mask, d.satellite_mask);
+        ASSERT_EQ(m.signal_mask, d.signal_mask);
+        ASSERT_EQ(m.cell_mask, d.cell_mask);
+        for (unsigned i = 0; i < m.num_satellites; i++) {
+            ASSERT_EQ(m.satellites[i].rough_range_ms, d.satellites[i].rough_range_ms);
+            ASSERT_EQ(m.satellites[i].rough_range_mod, d.satellites[i].rough_range_mod);
+        }
+        for (unsigned i = 0; i < m.num_cells; i++) {
+            const MsmCell &a = m.cells[i], &b = d.cells[i];
+            ASSERT_EQ(a.pr_valid, b.pr_valid);
+            // Within half a DF400 / DF401 step, unless clamped to the field
+            if (a.pr_valid && abs(a.fine_pr) < 524272) {
+                ASSERT_LE(abs(a.fine_pr - b.fine_pr), 16) << a.fine_pr;
+            }
+            ASSERT_EQ(a.cp_valid, b.cp_valid);
+            if (a.cp_valid && abs(a.fine_cp) < 8388600) {
+                ASSERT_LE(abs(a.fine_cp - b.fine_cp), 2) << a.fine_cp;
+            }
+            // A lock time must never be overstated, a receiver would keep an ambiguity it should reset
+            ASSERT_LE(b.lock_ms, a.lock_ms);
+            if (a.lock_ms >= 32 && a.lock_ms < 1048576) {
+                ASSERT_GT(2 * b.lock_ms, a.lock_ms) << a.lock_ms;
+            }
+            ASSERT_EQ(a.half_cycle, b.half_cycle);
+            if (a.cnr > 8 && a.cnr < 1008) {
+                ASSERT_LE(abs((int)a.cnr - (int)b.cnr), 8) << a.cnr;
+            }
+            ASSERT_FALSE(b.rate_valid);
+        }
+    }
+}
+
+TEST(Msm4Downgrade, ConvertsMsm7Only)
+{
+    std::mt19937 rng(11);
+    Msm4Downgrade downgrade;
+    uint8_t frame[MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD], expected[MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD];
+
+    const Msm m = randomMsm(rng);
+    size_t len = encodeMsm(m, 7, frame);
+    const size_t in = len;
+    Msm d;
+    ASSERT_TRUE(decodeMsm(frame, len, d));
+    const size_t n = encodeMsm(d, 4, expected);
+    const uint8_t *out = downgrade.apply(frame, len);
+    ASSERT_EQ(n, len);
+    EXPECT_EQ(std::vector<uint8_t>(expected, expected + n), std::vector<uint8_t>(out, out + len));
+    EXPECT_EQ(1u, downgrade.counters().converted);
+    EXPECT_EQ(in, downgrade.counters().bytes_in);
+    EXPECT_EQ(n, downgrade.counters().bytes_out);
+
+    // MSM4 to MSM6 and other messages pass through as they are
+    for (uint8_t type = 4; type <= 6; type++) {
+        len = encodeMsm(m, type, frame);
+        EXPECT_EQ(frame, downgrade.apply(frame, len));
+        EXPECT_EQ(encodeMsm(m, type, expected), len);
+    }
+    frame[0] = PREAMBLE;
+    frame[1] = 0;
+    frame[2] = 19;
+    frame[3] = 1005 >> 4;
+    frame[4] = (1005 & 0xF) << 4;
+    len = 19 + FRAME_OVERHEAD;
+    EXPECT_EQ(frame, downgrade.apply(frame, len));
+    EXPECT_EQ(19 + FRAME_OVERHEAD, len);
+
+    // A corrupted MSM7 is counted and passed through
+    len = encodeMsm(m, 7, frame);
+    frame[2] = 3;
+    const size_t corrupted = len;
+    EXPECT_EQ(frame, downgrade.apply(frame, len));
+    EXPECT_EQ(corrupted, len);
+    EXPECT_EQ(1u, downgrade.counters().errors);
+    EXPECT_EQ(2u, downgrade.counters().frames);
+}
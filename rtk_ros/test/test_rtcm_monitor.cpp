@@ -0,0 +1,100 @@
+/**
+ * @file test_rtcm_monitor.cpp
+ * RtcmMonitor epoch boundaries, in particular epochs with a constellation
+ * split over several MSM with the multiple message bit set.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <rtk_ros/rtcm_monitor.hpp>
+
+using namespace rtk_ros;
+using namespace rtk_ros::rtcm3;
+
+namespace {
+
+/**
+ * MSM with satellites first..first+count-1 on one signal, all cells present.
+ * @param cnr of every cell [2^-4 dB-Hz]
+ */
+std::vector<uint8_t> msmFrame(uint16_t number, uint32_t epoch, bool multiple, unsigned first, unsigned count,
+        uint16_t cnr, uint32_t lock_ms)
+{
+    Msm m;
+    m.number = number;
+    m.station_id = 7;
+    m.epoch = epoch;
+    m.multiple = multiple;
+    for (unsigned i = first; i < first + count; i++) m.satellite_mask |= 1ull << (63 - i);
+    m.signal_mask = 1u << 30;
+    m.num_satellites = (uint8_t)count;
+    m.num_signals = 1;
+    m.cell_mask = (1ull << count) - 1;
+    m.num_cells = (uint8_t)count;
+    for (unsigned i = 0; i < count; i++) {
+        m.cells[i].pr_valid = m.cells[i].cp_valid = true;
+        m.cells[i].cnr = cnr;
+        m.cells[i].lock_ms = lock_ms;
+    }
+    std::vector<uint8_t> frame(MAX_PAYLOAD_LENGTH + FRAME_OVERHEAD);
+    frame.resize(encodeMsm(m, m.type(), frame.data()));
+    return frame;
+}
+
+bool feed(RtcmMonitor &monitor, const std::vector<uint8_t> &frame)
+{
+    return monitor.onFrame(frame.data(), frame.size(), 0.0);
+}
+
+} // namespace
+
+TEST(RtcmMonitor, SplitMsmAddsUp)
+{
+    RtcmMonitor monitor;
+    const std::vector<uint8_t> gps1 = msmFrame(1074, 1000, true, 0, 4, 40 * 16, 5000);
+    const std::vector<uint8_t> gps2 = msmFrame(1074, 1000, true, 4, 4, 30 * 16, 5000);
+    const std::vector<uint8_t> galileo = msmFrame(1094, 1000, false, 0, 3, 45 * 16, 5000);
+    EXPECT_FALSE(feed(monitor, gps1));
+    EXPECT_FALSE(feed(monitor, gps2));
+    EXPECT_TRUE(feed(monitor, galileo));
+    EXPECT_EQ(1u, monitor.counters().epochs);
+
+    const RtcmEpochSummary &epoch = monitor.summary();
+    EXPECT_EQ(3u, epoch.frames);
+    EXPECT_EQ(gps1.size() + gps2.size() + galileo.size(), epoch.bytes);
+    const RtcmConstellationSummary &gps = epoch.constellations[0];
+    ASSERT_TRUE(gps.present);
+    EXPECT_EQ(8u, gps.num_satellites);
+    EXPECT_EQ(1u, gps.num_signals);
+    EXPECT_EQ(8u, gps.num_cells);
+    EXPECT_FLOAT_EQ(35.f, gps.cno_mean);
+    EXPECT_FLOAT_EQ(30.f, gps.cno_min);
+    EXPECT_EQ(3u, epoch.constellations[2].num_satellites);
+
+    // Lock times went back in both parts of the next epoch
+    EXPECT_FALSE(feed(monitor, msmFrame(1074, 2000, true, 0, 4, 40 * 16, 1000)));
+    EXPECT_TRUE(feed(monitor, msmFrame(1074, 2000, false, 4, 4, 40 * 16, 1000)));
+    EXPECT_EQ(2u, monitor.counters().epochs);
+    EXPECT_EQ(8u, monitor.summary().constellations[0].lock_resets);
+    EXPECT_FALSE(monitor.summary().constellations[2].present);
+}
+
+TEST(RtcmMonitor, RepeatedConstellationEndsEpoch)
+{
+    RtcmMonitor monitor;
+    // The last part of epoch 1000 was lost, epoch 2000 ends it
+    EXPECT_FALSE(feed(monitor, msmFrame(1074, 1000, true, 0, 4, 40 * 16, 5000)));
+    EXPECT_FALSE(feed(monitor, msmFrame(1074, 2000, true, 0, 5, 40 * 16, 5000)));
+    EXPECT_EQ(1u, monitor.counters().epochs);
+    EXPECT_EQ(4u, monitor.summary().constellations[0].num_satellites);
+    EXPECT_EQ(1000u, monitor.summary().epoch_time);
+
+    // Same epoch time after a part without the multiple message bit is a new epoch
+    RtcmMonitor single;
+    EXPECT_TRUE(feed(single, msmFrame(1074, 1000, false, 0, 4, 40 * 16, 5000)));
+    EXPECT_TRUE(feed(single, msmFrame(1074, 1000, false, 0, 4, 40 * 16, 5000)));
+    EXPECT_EQ(2u, single.counters().epochs);
+    EXPECT_EQ(4u, single.summary().constellations[0].num_cells);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file test_stream_demux.cpp
+ * StreamDemux on random mixed UBX / RTCM 3 / NMEA streams with corrupted
+ * frames and stray preamble bytes: the result does not depend on how the
+ * stream is split into reads, and no intact frame is lost.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <rtk_ros/stream_demux.hpp>
+
+using namespace rtk_ros;
+
+namespace {
+
+/** Every frame as a protocol letter followed by its bytes */
+struct Recorder {
+    std::vector<std::string> frames;
+
+    void onUbxMessage(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len) {
+        frames.push_back(std::string("U") + (char)msgClass + (char)msgId + std::string((const char *)payload, len));
+    }
+    void onRtcmFrame(const uint8_t *frame, size_t len) {
+        frames.push_back("R" + std::string((const char *)frame, len));
+    }
+    void onNmeaSentence(const char *sentence, size_t len) {
+        frames.push_back("N" + std::string(sentence, len));
+    }
+};
+
+std::vector<uint8_t> rtcmFrame(std::mt19937 &rng, size_t len)
+{
+    std::vector<uint8_t> f(len + rtcm3::FRAME_OVERHEAD);
+    f[0] = rtcm3::PREAMBLE;
+    f[1] = (uint8_t)(len >> 8);
+    f[2] = (uint8_t)len;
+    for (size_t k = 0; k < len; k++) f[3 + k] = (uint8_t)rng();
+    const uint32_t crc = rtcm3::crc24q(f.data(), len + 3);
+    f[len + 3] = (uint8_t)(crc >> 16);
+    f[len + 4] = (uint8_t)(crc >> 8);
+    f[len + 5] = (uint8_t)crc;
+    return f;
+}
+
+std::string nmeaSentence(std::mt19937 &rng)
+{
+    std::string body = "GPGGA,";
+    for (unsigned k = rng() % 60; k > 0; k--) body += (char)('0' + rng() % 40);
+    uint8_t checksum = 0;
+    for (char c : body) checksum ^= (uint8_t)c;
+    char tail[8];
+    snprintf(tail, sizeof(tail), "*%02X\r\n", checksum);
+    return "$" + body + tail;
+}
+
+struct Stream {
+    std::vector<uint8_t> bytes;
+    std::vector<std::string> intact;    ///< records expected for the frames left intact
+};
+
+Stream randomStream(std::mt19937 &rng)
+{
+    Stream s;
+    std::vector<uint8_t> payload(3000), ubxFrame(3000 + ubx::FRAME_OVERHEAD);
+    for (int f = 0; f < 150; f++) {
+        const unsigned kind = rng() % 4;
+        const bool corrupt = rng() % 8 == 0;
+        std::vector<uint8_t> frame;
+        std::string record;
+        if (kind == 0) {
+            const uint16_t len = (uint16_t)(rng() % (rng() % 10 == 0 ? 3000 : 200));
+            for (uint16_t k = 0; k < len; k++) payload[k] = rng() % 4 ? (uint8_t)rng() : rtcm3::PREAMBLE;
+            const size_t n = ubx::buildFrame(1, 2, payload.data(), len, ubxFrame.data());
+            frame.assign(ubxFrame.begin(), ubxFrame.begin() + n);
+            record = std::string("U\x01\x02") + std::string((const char *)payload.data(), len);
+        } else if (kind == 1) {
+            frame = rtcmFrame(rng, rng() % 1024);
+            record = "R" + std::string(frame.begin(), frame.end());
+        } else if (kind == 2) {
+            const std::string sentence = nmeaSentence(rng);
+            frame.assign(sentence.begin(), sentence.end());
+            record = "N" + sentence;
+        } else {
+            // Junk made mostly of preambles
+            for (unsigned k = rng() % 30; k > 0; k--) {
+                const unsigned r = rng() % 5;
+                frame.push_back(r == 0 ? ubx::SYNC1 : r == 1 ? rtcm3::PREAMBLE : r == 2 ? '$' : (uint8_t)rng());
+            }
+        }
+        if (kind != 3 && corrupt) frame[rng() % frame.size()] ^= 0x10;
+        else if (kind != 3) s.intact.push_back(record);
+        s.bytes.insert(s.bytes.end(), frame.begin(), frame.end());
+    }
+    // Flush whatever a stray preamble near the end started
+    s.bytes.insert(s.bytes.end(), 5000, 0);
+    return s;
+}
+
+bool isSubsequence(const std::vector<std::string> &needle, const std::vector<std::string> &haystack)
+{
+    size_t i = 0;
+    for (const std::string &h : haystack) {
+        if (i < needle.size() && h == needle[i]) i++;
+    }
+    return i == needle.size();
+}
+
+} // namespace
+
+TEST(Rtcm3, Crc24qCheckValue)
+{
+    EXPECT_EQ(0xCDE703u, rtcm3::crc24q((const uint8_t *)"123456789", 9));
+}
+
+TEST(StreamDemux, SplitInvariantAndLossless)
+{
+    std::mt19937 rng(7);
+    for (int t = 0; t < 300; t++) {
+        const Stream s = randomStream(rng);
+
+        StreamDemux whole;
+        Recorder wholeFrames;
+        whole.parse(s.bytes.data(), s.bytes.size(), wholeFrames);
+
+        StreamDemux split;
+        Recorder splitFrames;
+        for (size_t i = 0; i < s.bytes.size();) {
+            size_t chunk = rng() % 3 == 0 ? 1 + rng() % 3 : rng() % 1500;
+            if (chunk > s.bytes.size() - i) chunk = s.bytes.size() - i;
+            split.parse(s.bytes.data() + i, chunk, splitFrames);
+            i += chunk;
+        }
+
+        ASSERT_EQ(wholeFrames.frames, splitFrames.frames) << "stream " << t;
+        ASSERT_TRUE(isSubsequence(s.intact, wholeFrames.frames)) << "stream " << t << " lost an intact frame";
+
+        const StreamDemux::Counters &c = whole.counters();
+        EXPECT_EQ(s.bytes.size(), c.ubx.bytes + c.rtcm.bytes + c.nmea.bytes + c.unknown_bytes + whole.pendingBytes())
+            << "stream " << t;
+    }
+}
@@ -0,0 +1,201 @@
+/**
+ * @file test_ubx_parser.cpp
+ * UbxParser against a byte-at-a-time reference parser on random streams, and
+ * the wide byte_scan.hpp helpers against plain loops.
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include <rtk_ros/byte_scan.hpp>
+#include <rtk_ros/ubx_parser.hpp>
+
+using namespace rtk_ros;
+
+namespace {
+
+/** The parser state machine as it was before whole-frame parsing, byte by byte */
+class ReferenceParser
+{
+public:
+    template <typename Handler>
+    void parse(const uint8_t *data, size_t len, Handler &handler) {
+        for (size_t i = 0; i < len; i++) parseByte(data[i], handler);
+    }
+
+    bool idle() const { return state == Sync1; }
+    uint32_t checksumErrors() const { return checksumErrorCount; }
+    uint32_t oversizedFrames() const { return oversizedCount; }
+
+private:
+    enum State { Sync1, Sync2, Class, Id, Length1, Length2, Payload, ChecksumA, ChecksumB };
+
+    template <typename Handler>
+    void parseByte(uint8_t b, Handler &handler) {
+        switch (state) {
+            case Sync1:
+                if (b == ubx::SYNC1) state = Sync2;
+                break;
+            case Sync2:
+                if (b == ubx::SYNC2) {
+                    ck_a = ck_b = 0;
+                    state = Class;
+                } else if (b != ubx::SYNC1) {
+                    state = Sync1;
+                }
+                break;
+            case Class: msgClass = b; add(b); state = Id; break;
+            case Id: msgId = b; add(b); state = Length1; break;
+            case Length1: length = b; add(b); state = Length2; break;
+            case Length2:
+                length |= (uint16_t)(b << 8);
+                add(b);
+                if (length > ubx::MAX_PAYLOAD_LENGTH) {
+                    ++oversizedCount;
+                    state = Sync1;
+                    break;
+                }
+                index = 0;
+                state = length > 0 ? Payload : ChecksumA;
+                break;
+            case Payload:
+                payload[index++] = b;
+                add(b);
+                if (index >= length) state = ChecksumA;
+                break;
+            case ChecksumA:
+                if (b != ck_a) {
+                    ++checksumErrorCount;
+                    state = Sync1;
+                    break;
+                }
+                state = ChecksumB;
+                break;
+            case ChecksumB:
+                if (b == ck_b) handler.onUbxMessage(msgClass, msgId, payload, length);
+                else ++checksumErrorCount;
+                state = Sync1;
+                break;
+        }
+    }
+
+    void add(uint8_t b) {
+        ck_a += b;
+        ck_b += ck_a;
+    }
+
+    State state = Sync1;
+    uint8_t msgClass = 0, msgId = 0, ck_a = 0, ck_b = 0;
+    uint16_t length = 0, index = 0;
+    uint32_t checksumErrorCount = 0, oversizedCount = 0;
+    uint8_t payload[ubx::MAX_PAYLOAD_LENGTH];
+};
+
+struct Recorder {
+    std::vector<std::vector<uint8_t>> frames;
+
+    void onUbxMessage(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len) {
+        std::vector<uint8_t> frame = {msgClass, msgId};
+        frame.insert(frame.end(), payload, payload + len);
+        frames.push_back(frame);
+    }
+};
+
+/** Frames with corrupted checksums, oversized lengths, truncations and stray sync bytes */
+std::vector<uint8_t> randomStream(std::mt19937 &rng)
+{
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> payload(1100), frame(1100 + ubx::FRAME_OVERHEAD);
+    for (int f = 0; f < 200; f++) {
+        const unsigned kind = rng() % 10;
+        const uint16_t len = (uint16_t)(rng() % (kind == 0 ? 600 : 120));
+        for (uint16_t k = 0; k < len; k++) payload[k] = rng() % 3 ? (uint8_t)rng() : ubx::SYNC1;
+        size_t n = ubx::buildFrame(rng() % 4, rng() % 4, payload.data(), len, frame.data());
+        if (kind == 1) frame[rng() % n] ^= (uint8_t)(1 << (rng() % 8));
+        if (kind == 2) frame[5] = 0xFF;
+        if (kind == 3) n = rng() % n;
+        stream.insert(stream.end(), frame.begin(), frame.begin() + n);
+        for (unsigned j = rng() % 4; j > 0; j--) stream.push_back(rng() % 2 ? ubx::SYNC1 : (uint8_t)rng());
+    }
+    return stream;
+}
+
+} // namespace
+
+TEST(ByteScan, Fletcher8MatchesPlainLoop)
+{
+    std::mt19937 rng(1);
+    for (int t = 0; t < 20000; t++) {
+        std::vector<uint8_t> data(rng() % 300);
+        for (uint8_t &b : data) b = (uint8_t)rng();
+        uint8_t a = (uint8_t)rng(), b = (uint8_t)rng();
+        uint8_t refA = a, refB = b;
+        fletcher8Update(data.data(), data.size(), a, b);
+        ubx::fletcher8(data.data(), data.size(), refA, refB);
+        ASSERT_EQ(refA, a) << "length " << data.size();
+        ASSERT_EQ(refB, b) << "length " << data.size();
+    }
+}
+
+TEST(ByteScan, FindPairMatchesPlainLoop)
+{
+    std::mt19937 rng(2);
+    for (int t = 0; t < 20000; t++) {
+        std::vector<uint8_t> data(rng() % 100);
+        for (uint8_t &b : data) b = rng() % 4 ? ubx::SYNC1 : (rng() % 2 ? ubx::SYNC2 : (uint8_t)rng());
+        size_t expected = data.size();
+        for (size_t i = 0; i + 1 < data.size(); i++) {
+            if (data[i] == ubx::SYNC1 && data[i + 1] == ubx::SYNC2) {
+                expected = i;
+                break;
+            }
+        }
+        ASSERT_EQ(expected, findPair(data.data(), data.size(), ubx::SYNC1, ubx::SYNC2));
+    }
+}
+
+TEST(UbxParser, MatchesReferenceOnRandomSplits)
+{
+    std::mt19937 rng(3);
+    for (int t = 0; t < 300; t++) {
+        const std::vector<uint8_t> stream = randomStream(rng);
+
+        ReferenceParser reference;
+        Recorder expected;
+        reference.parse(stream.data(), stream.size(), expected);
+
+        UbxParser parser;
+        Recorder actual;
+        for (size_t i = 0; i < stream.size();) {
+            size_t chunk = rng() % 3 == 0 ? 1 : rng() % 2000;
+            if (chunk > stream.size() - i) chunk = stream.size() - i;
+            parser.parse(stream.data() + i, chunk, actual);
+            i += chunk;
+        }
+
+        ASSERT_EQ(expected.frames, actual.frames) << "stream " << t;
+        ASSERT_EQ(reference.checksumErrors(), parser.checksumErrors()) << "stream " << t;
+        ASSERT_EQ(reference.oversizedFrames(), parser.oversizedFrames()) << "stream " << t;
+        ASSERT_EQ(reference.idle(), parser.idle()) << "stream " << t;
+    }
+}
+
+TEST(UbxParser, FrameSplitAtEveryByte)
+{
+    std::vector<uint8_t> payload(92);
+    for (size_t i = 0; i < payload.size(); i++) payload[i] = (uint8_t)(i * 7);
+    std::vector<uint8_t> frame(payload.size() + ubx::FRAME_OVERHEAD);
+    ubx::buildFrame(ubx::CLASS_NAV, ubx::ID_NAV_PVT, payload.data(), (uint16_t)payload.size(), frame.data());
+
+    for (size_t split = 0; split <= frame.size(); split++) {
+        UbxParser parser;
+        Recorder recorder;
+        parser.parse(frame.data(), split, recorder);
+        parser.parse(frame.data() + split, frame.size() - split, recorder);
+        ASSERT_EQ(1u, recorder.frames.size()) << "split at " << split;
+        EXPECT_EQ(payload, std::vector<uint8_t>(recorder.frames[0].begin() + 2, recorder.frames[0].end()));
+        EXPECT_TRUE(parser.idle());
+    }
+}